@@ -0,0 +1,461 @@
+/*!
+ * \file hifiles_bench.cpp
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmark of the element operators. Each element type is set up standalone on a block of K
+ * elements for a range of orders, and every kernel is timed on its own.
+ *
+ * usage: hifiles_bench <input file> [-e tri,quad,tet,pri,hex] [-p min_order max_order] [-k n_eles]
+ *                      [-t min_time] [-o out.json]
+ *
+ * The physics (equation, viscous, riemann solver, sparse operators, ...) come from the input file;
+ * the mesh is ignored. Without -k, K is chosen per order so that the block has about 2^18 solution points.
+ * GFLOP/s counts the operator products as dense matrix products, GB/s counts each array read or written once,
+ * DOF-updates/s counts solution points times fields (flux points for the Riemann solvers).
+ *
+ * Before the kernels, the peak FP rate and memory bandwidth of one core are measured and printed as the
+ * roofline_gflops and roofline_bandwidth input options, which place the stages of a run with perf_counters 1
+ * under the roofline.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "../include/global.h"
+#include "../include/eles.h"
+#include "../include/eles_tris.h"
+#include "../include/eles_quads.h"
+#include "../include/eles_tets.h"
+#include "../include/eles_pris.h"
+#include "../include/eles_hexas.h"
+#include "../include/int_inters.h"
+#include "../include/flux.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+using namespace std;
+
+struct bench_result
+{
+  string ele_name, kernel;
+  int ele_type, order, n_eles, n_upts, n_fpts, n_calls;
+  double time_per_call, flops, bytes, dofs;
+};
+
+static const char *ele_names[] = {"tri", "quad", "tet", "pri", "hex"};
+
+// reference vertices of each element type, in HiFiLES node order
+
+static const double tri_verts[] = {0, 0, 1, 0, 0, 1};
+static const double quad_verts[] = {0, 0, 1, 0, 0, 1, 1, 1};
+static const double tet_verts[] = {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1};
+static const double pri_verts[] = {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 0, 1, 1};
+static const double hex_verts[] = {0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1};
+
+// call in_kernel until in_min_time has elapsed and return the mean time per call
+
+template <typename F>
+static double time_kernel(F in_kernel, double in_min_time, int &out_n_calls)
+{
+  in_kernel(); //warm up
+  out_n_calls = 0;
+  int n_rep = 1;
+  double elapsed = 0.;
+  while (elapsed < in_min_time)
+  {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < n_rep; i++)
+      in_kernel();
+    elapsed += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    out_n_calls += n_rep;
+    n_rep *= 2;
+  }
+  return elapsed / out_n_calls;
+}
+
+// peak double precision rate of one core (GFLOP/s): independent multiply-add chains, as vectorized by the compiler
+
+static double measure_peak_gflops(double in_min_time)
+{
+  const int n_chains = 32, n_iter = 1 << 16;
+  double acc[n_chains], x = 0.999999, y = 1.e-7;
+  volatile double sink;
+  int n_calls;
+  for (int i = 0; i < n_chains; i++)
+    acc[i] = 1. + i;
+  double t = time_kernel([&]() {
+    for (int it = 0; it < n_iter; it++)
+      for (int i = 0; i < n_chains; i++)
+        acc[i] = acc[i] * x + y;
+    sink = acc[0];
+  }, in_min_time, n_calls);
+  (void)sink;
+  return 1.e-9 * 2. * n_chains * n_iter / t;
+}
+
+// sustained memory bandwidth of one core (GB/s): STREAM triad on arrays much larger than the last level cache
+
+static double measure_bandwidth(double in_min_time)
+{
+  const int n = 1 << 23;
+  vector<double> a(n, 0.), b(n, 1.), c(n, 2.);
+  int n_calls;
+  double t = time_kernel([&]() {
+    for (int i = 0; i < n; i++)
+      a[i] = b[i] + 3. * c[i];
+  }, in_min_time, n_calls);
+  return 1.e-9 * 24. * n / t;
+}
+
+// set up a block of in_n_eles elements of type in_ele_type, each a jittered copy of the reference element
+
+static eles *setup_block(int in_ele_type, int in_n_eles)
+{
+  eles *block;
+  const double *verts;
+  int n_verts, n_dims = (in_ele_type < TET) ? 2 : 3;
+  int n_faces[] = {3, 4, 4, 5, 6};
+
+  if (in_ele_type == TRI)
+  {
+    block = new eles_tris();
+    verts = tri_verts;
+    n_verts = 3;
+  }
+  else if (in_ele_type == QUAD)
+  {
+    block = new eles_quads();
+    verts = quad_verts;
+    n_verts = 4;
+  }
+  else if (in_ele_type == TET)
+  {
+    block = new eles_tets();
+    verts = tet_verts;
+    n_verts = 4;
+  }
+  else if (in_ele_type == PRISM)
+  {
+    block = new eles_pris();
+    verts = pri_verts;
+    n_verts = 6;
+  }
+  else
+  {
+    block = new eles_hexas();
+    verts = hex_verts;
+    n_verts = 8;
+  }
+
+  block->set_rank(0);
+  block->setup(in_n_eles, n_verts);
+
+  hf_array<double> pos(n_dims);
+  for (int i = 0; i < in_n_eles; i++)
+  {
+    block->set_n_spts(i, n_verts);
+    block->set_ele2global_ele(i, i);
+    for (int j = 0; j < n_verts; j++)
+    {
+      for (int k = 0; k < n_dims; k++)
+        pos(k) = verts[j * n_dims + k] + 0.05 * sin(1.3 * i + 2.1 * j + 0.7 * k) + ((k == 0) ? i : 0);
+      block->set_shape_node(j, i, pos);
+    }
+    for (int j = 0; j < n_faces[in_ele_type]; j++)
+      block->set_bcid(i, j, -1);
+  }
+  block->set_transforms();
+
+  double time;
+  block->set_ics(time);
+  return block;
+}
+
+// time the inviscid Riemann solvers the way int_inters calls them, on in_n_pts interface flux points
+
+static void bench_riemann(int in_n_dims, int in_n_pts, double in_min_time, bench_result in_res, vector<bench_result> &out_results)
+{
+  int n_fields = in_n_dims + 2;
+  double gamma = run_input.gamma;
+  int_inters solver;
+  hf_array<double> u_l_pts(n_fields, in_n_pts), u_r_pts(n_fields, in_n_pts), fn_pts(n_fields, in_n_pts);
+  hf_array<double> u_l(n_fields), u_r(n_fields), f_l(n_fields, in_n_dims), f_r(n_fields, in_n_dims), norm(in_n_dims), fn(n_fields);
+
+  //smooth subsonic states, the right state is perturbed from the left one
+  for (int i = 0; i < in_n_pts; i++)
+  {
+    double vel[3] = {0.3, 0.1, 0.05};
+    for (int s = 0; s < 2; s++)
+    {
+      hf_array<double> &u = s ? u_r_pts : u_l_pts;
+      double rho = 1. + 0.1 * sin(0.1 * i + 0.3 * s), p = 1. / gamma + 0.05 * cos(0.2 * i + 0.5 * s), ke = 0.;
+      u(0, i) = rho;
+      for (int m = 0; m < in_n_dims; m++)
+      {
+        u(m + 1, i) = rho * vel[m] * (1. + 0.1 * s);
+        ke += 0.5 * rho * vel[m] * vel[m] * (1. + 0.1 * s) * (1. + 0.1 * s);
+      }
+      u(n_fields - 1, i) = p / (gamma - 1.) + ke;
+    }
+  }
+  for (int m = 0; m < in_n_dims; m++)
+    norm(m) = 1. / sqrt((double)in_n_dims);
+
+  const char *names[] = {"riemann_rusanov", "riemann_roeM", "riemann_hllc"};
+  for (int type = 0; type < 3; type++)
+  {
+    in_res.kernel = names[type];
+    auto kernel = [&]() {
+      for (int i = 0; i < in_n_pts; i++)
+      {
+        for (int k = 0; k < n_fields; k++)
+        {
+          u_l(k) = u_l_pts(k, i);
+          u_r(k) = u_r_pts(k, i);
+        }
+        if (in_n_dims == 2)
+        {
+          calc_invf_2d(u_l, f_l);
+          calc_invf_2d(u_r, f_r);
+        }
+        else
+        {
+          calc_invf_3d(u_l, f_l);
+          calc_invf_3d(u_r, f_r);
+        }
+        if (type == 0)
+          solver.rusanov_flux(u_l, u_r, f_l, f_r, norm, fn, in_n_dims, n_fields, gamma);
+        else if (type == 1)
+          solver.roeM_flux(u_l, u_r, f_l, f_r, norm, fn, in_n_dims, n_fields, gamma);
+        else
+          solver.hllc_flux(u_l, u_r, f_l, f_r, norm, fn, in_n_dims, n_fields, gamma);
+        for (int k = 0; k < n_fields; k++)
+          fn_pts(k, i) = fn(k);
+      }
+    };
+    in_res.time_per_call = time_kernel(kernel, in_min_time, in_res.n_calls);
+    in_res.flops = 0.;
+    in_res.bytes = 8. * (3 * n_fields + in_n_dims) * in_n_pts;
+    in_res.dofs = (double)n_fields * in_n_pts;
+    out_results.push_back(in_res);
+  }
+}
+
+// time each operator of one element type at the current run_input.order
+
+static void bench_ele_type(int in_ele_type, int in_n_eles, double in_min_time, vector<bench_result> &out_results)
+{
+  int n_sol_pts_target = 1 << 18;
+  eles *probe_block = setup_block(in_ele_type, 1);
+  int K = in_n_eles ? in_n_eles : max(1, n_sol_pts_target / probe_block->get_n_upts_per_ele());
+  delete probe_block;
+
+  eles *block = setup_block(in_ele_type, K);
+  double u = block->get_n_upts_per_ele(), f = block->get_n_fpts_per_ele();
+  double F = block->get_n_fields(), d = block->get_n_dims();
+
+  bench_result res;
+  res.ele_name = ele_names[in_ele_type];
+  res.ele_type = in_ele_type;
+  res.order = run_input.order;
+  res.n_eles = K;
+  res.n_upts = (int)u;
+  res.n_fpts = (int)f;
+
+  struct kernel_model
+  {
+    const char *name;
+    double flops, words; //per element, words of 8 bytes moved
+    void (eles::*kernel)(void);
+    bool viscous_only;
+  } models[] = {
+      {"extrapolate_solution", 2. * f * u * F, u * F + f * F, &eles::extrapolate_solution, false},
+      {"evaluate_invFlux", 0., u * F + u * d * d + u * F * d, &eles::evaluate_invFlux, false},
+      {"extrapolate_totalFlux", 2. * f * u * F * d, u * F * d + f * F, &eles::extrapolate_totalFlux, false},
+      {"calculate_divergence", 2. * u * u * F * d, u * F * d + u * F, &eles::calculate_divergence, false},
+      {"calculate_corrected_divergence", 2. * u * f * F, f * F + 2. * u * F, &eles::calculate_corrected_divergence, false},
+      {"calculate_gradient", 2. * u * u * F * d, u * F + u * F * d, &eles::calculate_gradient, true},
+      {"correct_gradient", 4. * u * f * F * d, f * F + 2. * u * F * d + f * F * d, &eles::correct_gradient, true},
+  };
+
+  block->extrapolate_solution(); //every kernel reads valid data
+  block->evaluate_invFlux();
+  for (auto &m : models)
+  {
+    if (m.viscous_only && !run_input.viscous)
+      continue;
+    res.kernel = m.name;
+    res.time_per_call = time_kernel([&]() { (block->*m.kernel)(); }, in_min_time, res.n_calls);
+    res.flops = m.flops * K;
+    res.bytes = 8. * m.words * K;
+    res.dofs = u * F * K;
+    out_results.push_back(res);
+  }
+
+  if (run_input.equation == 0)
+    bench_riemann((int)d, (int)(f * K / 2), in_min_time, res, out_results);
+
+  delete block;
+}
+
+// whether the internal cubature tables, used for the volume and interface quadrature, reach in_order
+
+static bool order_supported(int in_ele_type, int in_order)
+{
+  if (in_ele_type == TRI || in_ele_type == PRISM)
+    return in_order <= 7;
+  if (in_ele_type == TET)
+    return in_order <= 6;
+  return true;
+}
+
+// write all the results so far as JSON
+
+static void write_json(const string &in_file_name, const char *in_input_file, double in_min_time, double in_peak_gflops,
+                       double in_peak_bandwidth, vector<bench_result> &in_results)
+{
+  char line[512];
+  ofstream json(in_file_name.c_str());
+  if (!json)
+    FatalError("Unable to open the benchmark output file");
+#if defined _MKL_BLAS
+  const char *blas = "MKL";
+#elif defined _STANDARD_BLAS
+  const char *blas = "CBLAS";
+#elif defined _ACCELERATE_BLAS
+  const char *blas = "ACCELERATE";
+#else
+  const char *blas = "NO";
+#endif
+  int sparse[] = {run_input.sparse_tri, run_input.sparse_quad, run_input.sparse_tet, run_input.sparse_pri, run_input.sparse_hexa};
+  json << "{\n  \"input\": \"" << in_input_file << "\",\n  \"blas\": \"" << blas << "\",\n  \"min_time\": " << in_min_time << ",\n";
+  json << "  \"roofline\": {\"gflops\": " << in_peak_gflops << ", \"gbytes_per_s\": " << in_peak_bandwidth << "},\n  \"results\": [";
+  for (size_t r = 0; r < in_results.size(); r++)
+  {
+    bench_result &b = in_results[r];
+    snprintf(line, sizeof(line), "%s\n    {\"ele_type\": \"%s\", \"order\": %d, \"sparse\": %d, \"n_eles\": %d, \"n_upts\": %d, \"n_fpts\": %d, ",
+             r ? "," : "", b.ele_name.c_str(), b.order, sparse[b.ele_type], b.n_eles, b.n_upts, b.n_fpts);
+    json << line;
+    snprintf(line, sizeof(line), "\"kernel\": \"%s\", \"calls\": %d, \"time_per_call\": %.6e, \"gflops\": %.4f, \"gbytes_per_s\": %.4f, \"dof_updates_per_s\": %.6e}",
+             b.kernel.c_str(), b.n_calls, b.time_per_call, 1.e-9 * b.flops / b.time_per_call, 1.e-9 * b.bytes / b.time_per_call, b.dofs / b.time_per_call);
+    json << line;
+  }
+  json << "\n  ]\n}" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+  int rank = 0;
+  int min_order = 1, max_order = 8, n_eles = 0;
+  double min_time = 0.2;
+  string out_file = "hifiles_bench.json", ele_list = "tri,quad,tet,pri,hex";
+  vector<bench_result> results;
+
+#ifdef _MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+
+  if (argc < 2)
+  {
+    if (rank == 0)
+      cout << "usage: hifiles_bench <input file> [-e tri,quad,tet,pri,hex] [-p min_order max_order] [-k n_eles] [-t min_time] [-o out.json]" << endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return 1;
+  }
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-e") && i + 1 < argc)
+      ele_list = argv[++i];
+    else if (!strcmp(argv[i], "-p") && i + 2 < argc)
+    {
+      min_order = atoi(argv[++i]);
+      max_order = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+      n_eles = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      min_time = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      out_file = argv[++i];
+    else
+      FatalError("Unknown hifiles_bench option");
+  }
+
+  run_input.setup(argv[1], rank);
+
+  if (rank == 0) //the other ranks only keep MPI happy
+  {
+    char line[256];
+    double peak_gflops = measure_peak_gflops(min_time), peak_bandwidth = measure_bandwidth(min_time);
+    cout << "Roofline of one core, for the input file of a run with perf_counters 1:" << endl;
+    cout << "roofline_gflops " << peak_gflops << endl;
+    cout << "roofline_bandwidth " << peak_bandwidth << endl << endl;
+
+    snprintf(line, sizeof(line), "%-5s %5s %8s %-31s %12s %10s %10s %12s", "type", "order", "n_eles", "kernel", "us/call", "GFLOP/s", "GB/s", "MDOF/s");
+    cout << line << endl;
+
+    for (int t = TRI; t <= HEX; t++)
+    {
+      if (("," + ele_list + ",").find("," + string(ele_names[t]) + ",") == string::npos)
+        continue;
+      for (int p = min_order; p <= max_order; p++)
+      {
+        if (!order_supported(t, p))
+        {
+          cout << "skipping " << ele_names[t] << " order " << p << ", beyond the cubature tables" << endl;
+          continue;
+        }
+        run_input.order = p;
+        size_t first = results.size();
+        bench_ele_type(t, n_eles, min_time, results);
+        for (size_t r = first; r < results.size(); r++)
+        {
+          bench_result &b = results[r];
+          snprintf(line, sizeof(line), "%-5s %5d %8d %-31s %12.2f %10.3f %10.3f %12.2f", b.ele_name.c_str(), b.order, b.n_eles, b.kernel.c_str(),
+                   1.e6 * b.time_per_call, 1.e-9 * b.flops / b.time_per_call, 1.e-9 * b.bytes / b.time_per_call, 1.e-6 * b.dofs / b.time_per_call);
+          cout << line << endl;
+        }
+        write_json(out_file, argv[1], min_time, peak_gflops, peak_bandwidth, results); //keep what is done if a later case fails
+      }
+    }
+    cout << "Results written to " << out_file << endl;
+  }
+
+#ifdef _MPI
+  MPI_Finalize();
+#endif
+  return 0;
+}
@@ -0,0 +1,77 @@
+/*!
+ * \file embed_tables.cpp
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Build time tool converting a binary table of doubles in data/ into a header with a constexpr array,
+// usage: embed_tables <input.bin> <output.h> <array name>
+
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  if (argc != 4)
+  {
+    fprintf(stderr, "usage: embed_tables <input.bin> <output.h> <array name>\n");
+    return 1;
+  }
+
+  FILE *in = fopen(argv[1], "rb");
+  if (in == NULL)
+  {
+    fprintf(stderr, "embed_tables: unable to open %s\n", argv[1]);
+    return 1;
+  }
+  vector<double> table;
+  double val;
+  while (fread(&val, sizeof(double), 1, in) == 1)
+    table.push_back(val);
+  bool partial = !feof(in) || ftell(in) != (long)(table.size() * sizeof(double));
+  fclose(in);
+  if (partial || table.empty())
+  {
+    fprintf(stderr, "embed_tables: %s is not a table of doubles\n", argv[1]);
+    return 1;
+  }
+
+  FILE *out = fopen(argv[2], "w");
+  if (out == NULL)
+  {
+    fprintf(stderr, "embed_tables: unable to write %s\n", argv[2]);
+    return 1;
+  }
+  // 17 significant digits reproduce every double exactly
+  fprintf(out, "// generated from %s by embed_tables, do not edit\n\n#pragma once\n\n", argv[1]);
+  fprintf(out, "constexpr int %s_size = %d;\n\n", argv[3], (int)table.size());
+  fprintf(out, "constexpr double %s[%d] = {\n", argv[3], (int)table.size());
+  for (size_t i = 0; i < table.size(); i++)
+    fprintf(out, "  %.17g,\n", table[i]);
+  fprintf(out, "};\n");
+  if (fclose(out))
+  {
+    fprintf(stderr, "embed_tables: unable to write %s\n", argv[2]);
+    return 1;
+  }
+  return 0;
+}
@@ -58,7 +58,7 @@ public:
 
   // default destructor
 
-  ~eles();
+  virtual ~eles();
 
   // #### methods ####
 
@@ -73,15 +73,18 @@ public:
 
   /*! read data from restart file */
   void read_restart_data_ascii(ifstream& restart_file);
+
+  /*! read data of the local elements from the restart files at the positions given by the restart index (file, byte offset) */
+  void read_restart_data_ascii(vector<string>& in_file_names, hf_array<long long>& in_index);
 #ifdef _HDF5
   void read_restart_data_hdf5(hid_t &restart_file);
 #endif
 
-  /*! write data to restart file */
+  /*! write data to restart file, out_index gets the global number and byte offset of each element */
 #ifdef _HDF5
   void write_restart_data_hdf5(hid_t &in_dataset_id);
 #else
-  void write_restart_data_ascii(ofstream &restart_file);
+  void write_restart_data_ascii(ofstream &restart_file, vector<long long> &out_index);
 #endif
 
   /*! calculate the discontinuous solution at the flux points */
@@ -93,10 +96,16 @@ public:
   /*! calculate transformed discontinuous inviscid flux at solution points */
   void evaluate_invFlux(void);
   void evaluate_invFlux_over_int(void);
+
+  /*! calculate transformed inviscid flux at solution points, over-integrate only in elements flagged by sensor */
+  void evaluate_invFlux_over_int_selective(void);
   
   /*! calculate divergence of transformed discontinuous flux at solution points */
   void calculate_divergence(void);
 
+  /*! add volume flux differencing of the split-form inviscid flux to the divergence (tensor product elements only) */
+  void calc_split_form_divergence(void);
+
   /*! calculate normal transformed discontinuous flux at flux points */
   void extrapolate_totalFlux(void);
 
@@ -139,6 +148,9 @@ public:
   /*! get number of solution points per element */
   int get_n_upts_per_ele(void);
 
+  /*! get number of flux points per element */
+  int get_n_fpts_per_ele(void);
+
   /*! get number of shape points per element */
   int get_n_spts_per_ele(int in_ele);
 
@@ -172,6 +184,9 @@ public:
   /*!  set global element number */
   void set_ele2global_ele(int in_ele, int in_global_ele);
 
+  /*!  get global element number */
+  int get_ele2global_ele(int in_ele);
+
   /*! get a pointer to the transformed discontinuous solution at a flux point */
   double* get_disu_fpts_ptr(int in_inter_local_fpt, int in_ele_local_inter, int in_field, int in_ele);
 
@@ -234,8 +249,8 @@ public:
   /*! set opp_p */
   void set_opp_p(void);
 
-  /*! set opp_probe */
-  void set_opp_probe(hf_array<double>& in_loc);
+  /*! set opp_probe and the elements holding the probes of this type */
+  void set_opp_probe(vector<int>& in_eles, hf_array<double>& in_loc);
 
   /*! set opp_inters_cubpts */
   void set_opp_inters_cubpts(void);
@@ -253,8 +268,14 @@ public:
 
   hf_array<int> get_connectivity_plot();
 
-  /*! calculate solution at the probe points */
-  void calc_disu_probepoints(int in_ele, hf_array<double>& out_disu_probepoints);
+  /*! copy the fields read by the output writers into the output staging buffers */
+  void snapshot_output(bool in_plot);
+
+  /*! point the output readers back to the live solution once the snapshot is written */
+  void release_output(void);
+
+  /*! calculate solution at all probe points of this type */
+  void calc_disu_probepoints(hf_array<double>& out_disu_probepoints);
 
   /*! calculate solution at the plot points */
   void calc_disu_ppts(int in_ele, hf_array<double>& out_disu_ppts);
@@ -437,7 +458,15 @@ public:
 //Shock capturing/de-aliasing functions
 //---------------------------------------
 
-  void shock_capture(void);
+  /*! filter the solution in elements flagged by sensor, update the sensor if in_detect */
+  void shock_capture(bool in_detect);
+
+  /*! store the static metrics once for every element over which they are constant */
+  void compress_affine_transforms(void);
+
+  /*! index of the point at which the static metrics of solution/flux point in_pt of in_ele are stored */
+  int geo_upt(int in_pt, int in_ele) { return geo_start_upts(in_ele) + geo_stride(in_ele) * in_pt; }
+  int geo_fpt(int in_pt, int in_ele) { return geo_start_fpts(in_ele) + geo_stride(in_ele) * in_pt; }
 
   /*! element local timestep */
   hf_array<double> dt_local;
@@ -448,6 +477,15 @@ protected:
   /*! methods to detect the shock*/
   virtual void shock_det_persson()=0;
 
+  /*! convert sensor field to squared modal coefficients for all elements */
+  void calc_modal_energy_sensor(void);
+
+  /*! read the solution of one element from an ascii restart file */
+  void read_restart_ele_ascii(ifstream& restart_file, int in_ele, hf_array<double>& disu_upts_rest);
+
+  /*! set element reference lengths if required by the timestep type */
+  void set_h_ref(void);
+
   // #### members ####
 
   /*! viscous flag */
@@ -638,6 +676,10 @@ protected:
 	/*! number of storage levels for time-integration scheme */
 	int n_adv_levels;
 
+  /*! static metrics of each element start at point geo_start_upts/geo_start_fpts of detjac, JGinv and Jacobian_fpts,
+   *  geo_stride is 0 for an affine element whose metrics are stored at a single point, 1 otherwise */
+  hf_array<int> geo_start_upts, geo_start_fpts, geo_stride;
+
   /*! determinant of Jacobian (transformation matrix) at solution points
    *  (J = |G|) */
 	hf_array<double> detjac_upts;
@@ -884,7 +926,8 @@ protected:
 
   /*! operator to go from discontinuous solution at the solution points to discontinuous solution at the plot points */
   hf_array<double> opp_p;
-  hf_array<double> opp_probe;
+  hf_array<double> opp_probe; //(n_upts_per_ele,n_probes), one column of interpolation weights per probe
+  vector<int> probe_eles; //element holding each probe
   hf_array< hf_array<double> > opp_inters_cubpts;
   hf_array<double> opp_volume_cubpts;
 
@@ -913,8 +956,26 @@ protected:
   hf_array<double> exp_filter;
   hf_array<double> concentration_array;
   hf_array<double> sensor;
+  hf_array<double> modal_energy_sensor;
+  int n_shock_eles;
+  hf_array<int> shock_list;
+  hf_array<double> disu_shock_batch, filt_disu_shock_batch;
   hf_array<double> over_int_filter, opp_over_int_cubpts;
   hf_array<double> JGinv_over_int_cubpts;
   hf_array<double> temp_u_over_int_cubpts, temp_tdisf_over_int_cubpts;
   hf_array<double> loc_over_int_cubpts, weight_over_int_cubpts;
+  int n_over_int_batch;
+  hf_array<int> over_int_list;
+  hf_array<double> disu_over_int_batch, u_over_int_batch;
+  hf_array<double> tdisf_over_int_batch, tdisf_upts_over_int_batch;
+
+  /*! 1D differentiation matrix at solution points, used by split-form flux (tensor product elements only) */
+  hf_array<double> d_1d_upts;
+
+  /*! flag: output writers read the staging buffers below instead of the live solution, set from the snapshot
+   *  until the background thread has written it */
+  int out_snap;
+
+  /*! output staging buffers, filled by snapshot_output */
+  hf_array<double> disu_upts_out, grad_disu_upts_out, disu_average_upts_out, sensor_out;
 };
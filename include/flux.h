@@ -31,6 +31,9 @@ void calc_invf_2d(hf_array<double>& in_u, hf_array<double>& out_f);
 /*! calculate inviscid flux in 3D */
 void calc_invf_3d(hf_array<double>& in_u, hf_array<double>& out_f);
 
+/*! calculate symmetric two-point split-form inviscid flux along in_norm */
+void calc_split_invf(hf_array<double>& in_u_l, hf_array<double>& in_u_r, hf_array<double>& in_norm, hf_array<double>& out_f);
+
 /*! calculate viscous flux in 2D */
 void calc_visf_2d(hf_array<double>& in_u, hf_array<double>& in_grad_u, hf_array<double>& out_f);
 
@@ -0,0 +1,95 @@
+/*!
+ * \file fwh.h
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <vector>
+#include <string>
+#include "hf_array.h"
+#include "solution.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+/*!
+ * Permeable surface Ffowcs Williams-Hawkings integration (Farassat formulation 1A, stationary
+ * surface in a quiescent medium). Each surface sample adds its contribution to the observer
+ * pressure at the arrival time tau+r/c0; observer samples that no later surface sample can reach
+ * are summed over all ranks and appended to <fwh_surface>_fwh.dat.
+ */
+class fwh
+{
+public:
+    fwh();
+    ~fwh();
+
+    /*! read the observers and set the surface to observer geometry */
+#ifdef _MPI
+    void setup(struct solution *in_sol, MPI_Comm in_comm);
+#else
+    void setup(struct solution *in_sol);
+#endif
+
+    /*! add the contribution of the surface sample stored in disu_surf at time in_time */
+    void accumulate(double in_time);
+
+    /*! move the observer samples completed so far out of the accumulation, on the thread accumulating */
+    void collect(void);
+
+    /*! sum the collected observer samples over the ranks and write them (collective on comm) */
+    void write(void);
+
+    int active;
+    vector<int> probe2fwh; //local probe index to local FW-H surface point, -1 if not on the surface
+    hf_array<double> disu_surf; //(n_surf,n_dims+2) conservative variables at the surface points
+
+private:
+    struct solution *FlowSol;
+#ifdef _MPI
+    MPI_Comm comm;
+#endif
+    int n_dims, n_surf, n_obs;
+    double rho0, p0, c0; //ambient state
+    double dt_obs; //observer sample interval
+    double t0; //time of the first surface sample
+    double t_last; //time of the last surface sample
+    double r_min; //global minimum surface to observer distance
+    string fname;
+
+    hf_array<double> pos_obs; //(n_dims,n_obs) observer positions
+    hf_array<double> r_inv; //(n_surf,n_obs) inverse distance
+    hf_array<double> r_hat; //(n_dims,n_surf,n_obs) unit vector from surface point to observer
+    hf_array<double> t_delay; //(n_surf,n_obs) propagation time r/c0
+
+    //previous surface sample
+    int n_sample;
+    hf_array<double> un_prev; //(n_surf) U_n
+    hf_array<double> l_prev; //(n_dims,n_surf) L_i
+
+    //observer pressure from bin0 on, one array per observer
+    long bin0;
+    vector<vector<double> > p_obs;
+
+    //observer samples collected for the next write, from bin bin_out on
+    long n_out, bin_out;
+    hf_array<double> p_out; //(n_out,n_obs)
+};
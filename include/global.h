@@ -41,6 +41,7 @@ extern const double pi;
 #define MAX_F_PER_C 6
 #define MAX_E_PER_C 12
 #define MAX_V_PER_C 27
+#define MAX_ELE_BATCH 256 //max number of elements gathered into one batched dgemm
 
 
 /** enumeration for cell type */
@@ -69,6 +70,3 @@ enum BCFLAG {
   SLIP_WALL_DUAL= 11,
   AD_WALL       = 12
 };
-
-/*! environment variable specifying location of HiFiLES repository */
-extern const char* HIFILES_DIR;
\ No newline at end of file
@@ -33,6 +33,10 @@
 #include <algorithm>
 #include "error.h"
 
+#ifdef _MEM_TRACK
+#include "mem_tracker.h"
+#endif
+
 #ifdef _GPU
 #include "cuda.h"
 #include "cuda_runtime_api.h"
@@ -50,9 +54,13 @@ public:
 
   hf_array();
 
-  // constructor 1
+  // constructor 1, with _MEM_TRACK the caller's line tags the allocation
 
+#ifdef _MEM_TRACK
+  hf_array(int in_dim_0, int in_dim_1=1, int in_dim_2=1, int in_dim_3=1, const char *in_file=__builtin_FILE(), int in_line=__builtin_LINE());
+#else
   hf_array(int in_dim_0, int in_dim_1=1, int in_dim_2=1, int in_dim_3=1);
+#endif
 
   // copy constructor
 
@@ -74,7 +82,11 @@ public:
 
   // setup
 
+#ifdef _MEM_TRACK
+  void setup(int in_dim_0, int in_dim_1=1, int in_dim_2=1, int in_dim_3=1, const char *in_file=__builtin_FILE(), int in_line=__builtin_LINE());
+#else
   void setup(int in_dim_0, int in_dim_1=1, int in_dim_2=1, int in_dim_3=1);
+#endif
 
   // access/set 1d
 
@@ -163,6 +175,13 @@ protected:
   T* cpu_data;
   int cpu_flag;
 
+#ifdef _MEM_TRACK
+  int mem_tag; //tag of the cpu data in memory_tracker(), -1 when not counted
+
+  void track_alloc(void);
+  void track_free(void);
+#endif
+
 #ifdef _GPU
   T *gpu_data;
   int gpu_flag;
@@ -175,6 +194,37 @@ protected:
 
 using namespace std;
 
+#ifdef _MEM_TRACK
+template <typename T>
+struct is_hf_array { static const bool value = false; };
+
+template <typename T>
+struct is_hf_array<hf_array<T> > { static const bool value = true; };
+
+// count the cpu data; the arrays of an hf_array of hf_arrays belong to the owner of the outer array
+
+template <typename T>
+void hf_array<T>::track_alloc(void)
+{
+  if (mem_tag < 0)
+    return;
+  size_t n = (size_t)dim_0 * dim_1 * dim_2 * dim_3;
+  memory_tracker().add(mem_tag, n * sizeof(T));
+  if (is_hf_array<T>::value)
+    memory_tracker().add_nested(cpu_data, n * sizeof(T), this);
+}
+
+template <typename T>
+void hf_array<T>::track_free(void)
+{
+  if (mem_tag < 0 || !cpu_flag)
+    return;
+  memory_tracker().remove(mem_tag, (long long)dim_0 * dim_1 * dim_2 * dim_3 * sizeof(T));
+  if (is_hf_array<T>::value)
+    memory_tracker().remove_owner(cpu_data);
+}
+#endif
+
 // #### constructors ####
 
 // default constructor
@@ -193,12 +243,19 @@ hf_array<T>::hf_array()
 #ifdef _GPU
   gpu_flag = 0;
 #endif
+#ifdef _MEM_TRACK
+  mem_tag = -1;
+#endif
 }
 
 // constructor 1
 
 template <typename T>
+#ifdef _MEM_TRACK
+hf_array<T>::hf_array(int in_dim_0, int in_dim_1, int in_dim_2, int in_dim_3, const char *in_file, int in_line)
+#else
 hf_array<T>::hf_array(int in_dim_0, int in_dim_1, int in_dim_2, int in_dim_3)
+#endif
 {
   dim_0=in_dim_0;
   dim_1=in_dim_1;
@@ -213,6 +270,10 @@ hf_array<T>::hf_array(int in_dim_0, int in_dim_1, int in_dim_2, int in_dim_3)
 #ifdef _GPU
   gpu_flag = 0;
 #endif
+#ifdef _MEM_TRACK
+  mem_tag = memory_tracker().get_tag(this, in_file, in_line);
+  track_alloc();
+#endif
 }
 
 // copy constructor
@@ -235,6 +296,10 @@ hf_array<T>::hf_array(const hf_array<T>& in_array)
 #ifdef _GPU
   gpu_flag = 0;
 #endif
+#ifdef _MEM_TRACK
+  mem_tag = in_array.mem_tag; //a copy counts under the line that sized the original
+  track_alloc();
+#endif
 }
 
 // assignment
@@ -249,6 +314,9 @@ hf_array<T>& hf_array<T>::operator=(const hf_array<T>& in_array)
     }
   else
     {
+#ifdef _MEM_TRACK
+      track_free();
+#endif
       delete[] cpu_data;
 
       dim_0=in_array.dim_0;
@@ -264,6 +332,10 @@ hf_array<T>& hf_array<T>::operator=(const hf_array<T>& in_array)
       cpu_flag=1;
 #ifdef _GPU
       gpu_flag = 0;
+#endif
+#ifdef _MEM_TRACK
+      mem_tag = in_array.mem_tag;
+      track_alloc();
 #endif
       return (*this);
     }
@@ -274,6 +346,9 @@ hf_array<T>& hf_array<T>::operator=(const hf_array<T>& in_array)
 template <typename T>
 hf_array<T>::~hf_array()
 {
+#ifdef _MEM_TRACK
+  track_free();
+#endif
   delete[] cpu_data;
 }
 
@@ -282,8 +357,15 @@ hf_array<T>::~hf_array()
 // setup
 
 template <typename T>
+#ifdef _MEM_TRACK
+void hf_array<T>::setup(int in_dim_0, int in_dim_1, int in_dim_2, int in_dim_3, const char *in_file, int in_line)
+#else
 void hf_array<T>::setup(int in_dim_0, int in_dim_1, int in_dim_2, int in_dim_3)
+#endif
 {
+#ifdef _MEM_TRACK
+  track_free();
+#endif
   delete[] cpu_data;
 
   dim_0=in_dim_0;
@@ -298,6 +380,10 @@ void hf_array<T>::setup(int in_dim_0, int in_dim_1, int in_dim_2, int in_dim_3)
 #ifdef _GPU
   gpu_flag = 0;
 #endif
+#ifdef _MEM_TRACK
+  mem_tag = memory_tracker().get_tag(this, in_file, in_line);
+  track_alloc();
+#endif
 }
 
 template <typename T>
@@ -505,6 +591,9 @@ void hf_array<T>::mv_cpu_gpu(void)
   cudaMalloc((void**) &gpu_data,dim_0*dim_1*dim_2*dim_3*sizeof(T));
   cudaMemcpy(gpu_data,cpu_data,dim_0*dim_1*dim_2*dim_3*sizeof(T),cudaMemcpyHostToDevice);
 
+#ifdef _MEM_TRACK
+  track_free();
+#endif
   delete[] cpu_data;
   cpu_data = new T[1];
 
@@ -522,8 +611,14 @@ void hf_array<T>::mv_gpu_cpu(void)
 {
 
   check_cuda_error("mv_gpu_cpu before",__FILE__, __LINE__);
+#ifdef _MEM_TRACK
+  track_free();
+#endif
   delete[] cpu_data;
   cpu_data = new T[dim_0*dim_1*dim_2*dim_3];
+#ifdef _MEM_TRACK
+  track_alloc();
+#endif
 
   cudaMemcpy(cpu_data,gpu_data,dim_0*dim_1*dim_2*dim_3*sizeof(T),cudaMemcpyDeviceToHost);
   cudaFree(gpu_data);
@@ -551,6 +646,9 @@ void hf_array<T>::cp_gpu_cpu(void)
     {
       cpu_data = new T[dim_0*dim_1*dim_2*dim_3];
       cpu_flag=1;
+#ifdef _MEM_TRACK
+      track_alloc();
+#endif
     }
 
   check_cuda_error("cp_gpu_cpu before",__FILE__, __LINE__);
@@ -586,6 +684,9 @@ void hf_array<T>::rm_cpu(void)
 {
 
   check_cuda_error("rm_cpu before",__FILE__, __LINE__);
+#ifdef _MEM_TRACK
+  track_free();
+#endif
   delete[] cpu_data;
   cpu_data = new T[1];
 
@@ -31,6 +31,16 @@
 #include "hf_array.h"
 #include "bc.h"
 
+/** enumeration for the source of the mesh. The mesh_format option takes MESH_FILE or MESH_BOX,
+ *  mesh_reader resolves MESH_FILE to the format of mesh_file */
+enum MESH_FORMAT
+{
+    MESH_FILE = 0,
+    MESH_BOX = 1,
+    MESH_GAMBIT = 2,
+    MESH_GMSH = 3
+};
+
 class input
 {
 public:
@@ -112,22 +122,35 @@ public:
     int restart_flag;
     int restart_iter;
     int n_restart_files;
+    int convert_restart;
 
     /*--- mesh parameters ---*/
-    int mesh_format;
+    int mesh_format; //MESH_FILE or MESH_BOX
     string mesh_file;
+    hf_array<int> box_n, box_periodic;
+    hf_array<double> box_min, box_max;
+    string box_ele_type;
+    double box_perturb;
+    int box_seed;
 
     /* --- Shock Capturing/dealiasing options --- */
     int over_int, over_int_order;
-    int shock_cap, shock_det, shock_det_field;
+    double over_int_s0;
+    int split_form;
+    int shock_cap, shock_det, shock_det_field, shock_det_freq;
     double s0;
     double expf_fac;
     int expf_order,expf_cutoff;
+
     
     /*--- moniter and output ---*/
     int p_res;
     int write_type;
+    int vtu_format;
+    int restart_compression, plot_compression, plot_precision;
     int plot_freq;
+    int async_output;
+    double walltime, walltime_margin;
     int n_diagnostic_fields;
     hf_array<string> diagnostic_fields;
     int n_average_fields;
@@ -136,6 +159,13 @@ public:
     hf_array<string> integral_quantities;
     double spinup_time;
     int monitor_res_freq;
+    int timer_report;
+    int trace_start, trace_end, trace_buffer;
+    int perf_counters;
+    string perf_fp_event;
+    double roofline_gflops, roofline_bandwidth;
+    int memory_report;
+    int comm_profile;
     int calc_force;
     int monitor_cp_freq;
     double area_ref;
@@ -0,0 +1,92 @@
+/*!
+ * \file mem_tracker.h
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+/*!
+ * Accounts the CPU memory of the hf_arrays when built with _MEM_TRACK (cmake -DUSE_MEM_TRACK=ON).
+ * Each allocation is tagged with the source line that sized the array, the object owning the array
+ * (registered with add_owner, e.g. the element types) and its element type. The bytes per tag are kept
+ * current and copied at every new high-water mark, so the breakdown at the peak can be printed later.
+ * All methods take a lock, the output thread allocates arrays while the solver runs.
+ */
+class mem_tracker
+{
+public:
+  mem_tracker() : total(0), peak_total(0) {}
+
+  /*! tag of an array at in_array sized at in_file:in_line */
+  int get_tag(const void *in_array, const char *in_file, int in_line);
+
+  /*! count or release one array of in_bytes under in_tag */
+  void add(int in_tag, long long in_bytes);
+  void remove(int in_tag, long long in_bytes);
+
+  /*! the arrays allocated within [in_owner, in_owner+in_size) are attributed to in_name and in_ele_type */
+  void add_owner(const void *in_owner, size_t in_size, const char *in_name, int in_ele_type);
+  void remove_owner(const void *in_owner);
+
+  /*! the arrays allocated within [in_data, in_data+in_size) belong to the owner of in_array, for hf_arrays of hf_arrays */
+  void add_nested(const void *in_data, size_t in_size, const void *in_array);
+
+  /*!
+   * print the breakdown by array of the rank using the most memory, its totals per element type and the
+   * min/avg/max across ranks (collective). in_peak=true reports the high-water mark instead of the current usage.
+   */
+  void report(bool in_peak, const char *in_label, std::ostream &out);
+
+private:
+  struct tag_info
+  {
+    const char *file, *owner;
+    int line, ele_type;
+  };
+
+  struct owner_info
+  {
+    const char *begin;
+    size_t size;
+    const char *name;
+    int ele_type;
+  };
+
+  std::mutex tracker_mutex;
+  std::vector<tag_info> tags;
+  std::map<std::tuple<const char *, int, const char *, int>, int> tag_index;
+  std::vector<owner_info> owners;
+
+  /*! bytes and live arrays per tag, now and at the high-water mark */
+  std::vector<long long> bytes, n_arrays, peak_bytes, peak_n_arrays;
+  long long total, peak_total;
+
+  /*! innermost registered object holding in_ptr, -1 if none */
+  int find_owner(const void *in_ptr);
+};
+
+/*! the tracker of this process, never destroyed so arrays freed at exit can still be released */
+mem_tracker &memory_tracker(void);
@@ -24,6 +24,8 @@
 #pragma once
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <vector>
 
 #include "global.h"
 #include "mesh.h"
@@ -47,12 +49,42 @@ public:
   void read_boundary(void);
 
 private:
+  //block of elements in the gmsh element section
+  struct gmsh_block
+  {
+    size_t pos;      //byte offset of the first element
+    int type;        //gmsh element type, -1 if given on each line
+    int phys;        //physical group id, -1 if given on each line
+    long long n;     //number of elements
+    long long first; //global index of the first fluid element
+  };
+
   string fname;       //mesh file name
-  ifstream mesh_file; //input file stream
-  int mesh_format;
+  const char *map_ptr; //memory mapped mesh file
+  size_t map_size;
+  int mesh_format; //MESH_GAMBIT, MESH_GMSH or MESH_BOX
   mesh *mesh_ptr; //pointer to mesh object
 
+  //gmsh file information
+  int gmsh_version;                //major version, 2 or 4
+  bool gmsh_binary;                //binary file
+  int fluid_id;                    //physical group id of FLUID
+  map<string, size_t> section_pos; //byte offset after each $Section tag
+  map<int, int> entity_phys[4];    //physical group id of each gmsh 4 entity, by entity dimension
+  vector<gmsh_block> fluid_blocks; //fluid elements, split into blocks at most ele_block_size long in ascii files
+  vector<gmsh_block> bdy_blocks;   //element blocks belonging to the other physical groups, runs of boundary lines in gmsh 2.2
+
+  //generated box information
+  int box_type;          //0: hex/quad; 1: prism/tri; 2: tet; 3: mixed
+  int box_n[3];          //number of cubes in each direction
+  int box_cells_per_row; //number of cells in a row of cubes along x
+  double box_min[3], box_max[3];
+  int box_periodic[3];
+  int box_bc[6];         //boundary group of each side of the box, xmin, xmax, ymin, ...
+
   /* -------------------methods----------------------------*/
+  //map the mesh file into memory
+  void map_file(void);
   //read header and store it in mesh object pointed by mesh_ptr
   void read_header(void);
   //mesh format specific header readers
@@ -67,5 +99,40 @@ private:
   //mesh format specific boundary condition reader
   void read_boundary_gambit();
   void read_boundary_gmsh();
+  //box generator counterparts of the readers
+  void read_header_box(void);
+  void partial_read_connectivity_box(int kstart, int in_num_cells);
+  void read_vertices_box(void);
+  void read_boundary_box(void);
+
+  //gmsh helpers
+  //find the sections of the file and read the file format on rank 0, broadcast them
+  void index_sections_gmsh(void);
+  //the scan of the sections done by rank 0
+  void scan_sections_gmsh(void);
+  //pointer to the data of a section
+  const char *section_gmsh(string in_name);
+  //read the physical groups of the gmsh 4 entities
+  void read_entities_gmsh(void);
+  //split the element section into blocks and count the fluid elements on rank 0, broadcast the blocks
+  void index_elements_gmsh(void);
+  //the scan of the element section done by rank 0
+  void scan_elements_gmsh(void);
+  //read integer/size/double in the ascii or binary encoding of the file
+  int get_int_gmsh(const char *&p);
+  long long get_size_gmsh(const char *&p);
+  double get_double_gmsh(const char *&p);
+  //move to the beginning of the next line in ascii files
+  void next_line_gmsh(const char *&p);
+  //store a cell given its gmsh type and 1 based vertex list
+  void set_cell_gmsh(int in_cell, int in_elmtype, long long *in_nodes);
+  //mark the face of the local cell made up of the local vertices in in_vlist as boundary in_bc
+  void set_bdy_face(hf_array<int> &in_vlist, int in_bc);
+
+  //box helpers
+  //cube index, cell within the cube and cell type of a global cell of the box
+  void get_cell_box(int in_icg, int *out_ijk, int &out_sub, int &out_ctype);
+  //lattice indices of a global vertex of the box
+  void get_vert_box(int in_ivg, int *out_ijk);
 
 };
\ No newline at end of file
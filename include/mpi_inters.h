@@ -25,8 +25,10 @@
 
 #pragma once
 
+#include <chrono>
 #include "inters.h"
 #include "solution.h"
+#include "timer.h"
 
 class mpi_inters: public inters
 {
@@ -73,6 +75,15 @@ public:
   /*! move all from cpu to gpu */
   void mv_all_cpu_gpu(void);
 
+  /*! complete one exchange; while profiling, time each neighbor's message and the compute before the wait */
+  void wait_exchange(int in_exchange, hf_array<MPI_Request> &in_requests, hf_array<MPI_Request> &out_requests);
+
+  /*! while profiling, record the neighbor messages of the exchanges in flight that arrived by now */
+  void poll_exchanges(void);
+
+  /*! test the outstanding receives of one exchange and record the ones that completed */
+  void test_arrivals(int in_exchange, hf_array<MPI_Request> &in_requests);
+
 protected:
 
   // #### members ####
@@ -102,4 +113,10 @@ protected:
 
   hf_array<MPI_Status> mpi_instatus;
   hf_array<MPI_Status> mpi_outstatus;
+
+  // Communication profile
+  hf_array<int> request_proc; //neighbor of each request
+  hf_array<int> done_index;
+  std::chrono::steady_clock::time_point post_time[N_COMM_EXCHANGES];
+  int n_pending[N_COMM_EXCHANGES]; //receives of each exchange not yet seen completing
 };
@@ -24,8 +24,14 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "global.h"
 #include "solution.h"
+#include "fwh.h"
 
 #ifdef _CGNS
 #ifdef _MPI
@@ -62,17 +68,58 @@ class output
 
     //driver methods
 
+    /*! write the plot, probe and restart files due at this step, from the background thread if async_output is set */
+    void write_outputs(int in_file_num, bool in_plot, bool in_probe, bool in_restart);
+
+    /*! block until the background thread has finished writing the pending snapshot */
+    void wait_outputs(void);
+
+    /*! finish pending writes and stop the background thread */
+    void close_outputs(void);
+
+    /*! write an output file in the format selected by write_type */
+    void write_plot(int in_file_num);
+
     /*! write an output file in Tecplot ASCII format */
     void write_tec(int in_file_num);
 
     /*! write an output file in VTK ASCII format */
     void write_vtu(int in_file_num);
 
+    /*! write the local .vtu file in VTK binary appended format */
+    void write_vtu_appended(char *in_vtu_s);
+
+    /*! names of the scalar plot fields */
+    void get_plot_field_names(vector<string> &out_names);
+
+    /*! interpolate the solution of all local elements of one type to the plot points */
+    void calc_plot_data(int in_ele_type, bool in_mesh, vector<string> &out_names, vector<float> &out_sol, vector<float> &out_vel, vector<float> &out_pos, vector<int> &out_con);
+
 #ifdef _CGNS
     /*! write an output file in CGNS format */
     void write_CGNS(int in_file_num);
 #endif
 
+#ifdef _HDF5
+    /*! set typewise global element offsets for the HDF5/XDMF plot output */
+    void setup_xdmf(void);
+
+    /*! append one time step of plot data to the HDF5 plot file and rewrite the XDMF descriptor */
+    void write_xdmf(int in_file_num);
+#endif
+
+    /*! set the typewise probe interpolation operators and the probe sample buffer */
+    void setup_probe(void);
+
+    /*! interpolate the solution to the local probes and store the sample at in_time in the buffer being filled */
+    void sample_probe(double in_time);
+
+    /*! hand the filled probe buffer and the completed FW-H samples to the writers */
+    void hand_probe(void);
+
+    /*! write the probe samples handed off */
+    void write_probe(void);
+
     /*! write an probe data file */
 
 #ifdef _HDF5
@@ -86,6 +133,9 @@ class output
     void write_restart_hdf5(int in_file_num);
 #else
     void write_restart_ascii(int in_file_num);
+
+    /*! write the index of the element positions in the ascii restart files */
+    void write_restart_index(char *in_file_name, vector<long long> &in_index);
 #endif
 
     /*! monitor convergence of residual */
@@ -105,8 +155,17 @@ class output
     /*! compute error */
     void compute_error(int in_file_num);
 
-    /*! calculate residual */
-    void CalcNormResidual(void);
+    /*! calculate residual, and the run metrics of the steps since the previous call in the same reduction */
+    void CalcNormResidual(int in_file_num);
+
+    /*!
+     * complete the reduction of the forces, integral quantities, residual and target orders packed in run_reduction,
+     * compute the norms and print the target orders
+     */
+    void CompleteMonitoring(void);
+
+    /*! start the interval of the run metrics, after the stage timers are reset */
+    void reset_metrics(int in_file_num);
 
     /*! check if the solution is bounded !*/
     void check_stability(void);
@@ -122,9 +181,58 @@ class output
 #endif
 
   protected:
+    /*! background thread loop, writes each posted snapshot */
+    void io_loop(void);
+
+    /*! write the files requested by the posted snapshot */
+    void write_job(void);
+
     //data members
 
     struct solution *FlowSol; //the solution structure
+    double out_time; //solution time of the data being written
+
+    //run metrics, reported in the history file
+    std::chrono::steady_clock::time_point metrics_time; //start of the interval
+    int metrics_file_num;
+    double metrics_wait, metrics_io; //halo and reduction wait and output seconds of this rank at the start of the interval
+    long long metrics_residuals; //residual evaluations at the start of the interval
+    double wall_per_step, dof_updates_per_s; //of the interval, on rank 0
+    double step_time_min, step_time_max, step_imbalance; //busy (not waiting for halos or output) seconds per step across ranks
+    double io_time; //max seconds the solver spent on output in the interval
+
+    //offsets of the monitored quantities in run_reduction, -1 when none is pending
+    int force_offset, intq_offset, res_offset;
+    int res_n_fields, res_n_steps;
+    long long res_n_residuals; //residual evaluations of this rank in the interval
+
+    //background output thread
+    int async;
+    std::thread io_thread;
+    std::mutex io_mutex;
+    std::condition_variable io_cond;
+    bool io_busy, io_stop;
+    int job_file_num;
+    bool job_plot, job_probe, job_restart;
+#ifdef _MPI
+    MPI_Comm out_comm; //communicator used by the writers
+#endif
+    //probe sample buffer
+    vector<vector<int> > probe_type_list; //typewise list of local probes
+    //probe sample buffers, the solver samples into one while the other is written
+    hf_array<double> probe_buf[2]; //(probe_buffer,n_probe,n_probe_fields) dimensional probe fields
+    hf_array<double> probe_buf_time[2]; //time of each buffered sample
+    int n_probe_buf[2]; //number of buffered samples
+    int probe_fill, probe_out; //buffer being sampled into, buffer handed to the writers
+    fwh acoustic; //in-situ FW-H integration on a probe surface
+#ifdef _HDF5
+    string xdmf_h5_name; //HDF5 plot file of this run
+    hf_array<int> xdmf_ele_start, xdmf_n_eles_glob; //typewise global index of the first local element, global number of elements
+    hf_array<int> xdmf_n_ppts, xdmf_n_peles, xdmf_n_verts; //typewise number of plot points, plot elements and vertices per element
+    vector<int> xdmf_steps; //file numbers written to the plot file
+    vector<double> xdmf_times;
+    vector<string> xdmf_fields; //names of the scalar fields
+#endif
 #ifdef _CGNS
     int cell_dim, phy_dim;
     cgsize_t glob_npnodes; //total number of plot nodes globally
@@ -45,6 +45,7 @@ public:
     //basic inputs
     hf_array<string> probe_fields;
     int probe_freq;
+    int probe_buffer;//number of samples held in memory between writes
     int n_probe_fields;
     string probe_source_file;//probe source filename
 
@@ -70,12 +71,21 @@ public:
     vector<double> surf_normal; //column major n_dims*n_surf
     vector<double> surf_area;
 
+    //FW-H surface(local)
+    string fwh_surface;//name of the surface probe set used as FW-H integration surface
+    string fwh_observer_file;//file of observer coordinates
+    vector<int> fwh_probe;//local probe index of each local FW-H surface point
+    hf_array<double> fwh_pos;//position of each local FW-H surface point
+    hf_array<double> fwh_normal;//normal of each local FW-H surface point
+    vector<double> fwh_area;//area of each local FW-H surface point
+
 
     //entrance
     void setup(char *fileNameC,struct solution* FlowSol, int rank);
 private:
     void read_probe_input(int rank);
     void set_probe_connectivity(struct solution* FlowSol,int rank);
+    void set_fwh_surface(int rank);
 #ifdef _HDF5
     void create_probe_hdf5(int rank);
 #else
@@ -0,0 +1,79 @@
+/*!
+ * \file reduction.h
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <vector>
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+/** enumeration for the ways a packed value is combined across ranks */
+enum REDUCTION_OP
+{
+  RO_SUM = 0,
+  RO_MAX,
+  RO_MIN
+};
+
+/*!
+ * Packs the scalars reduced across ranks at a step (time step, residuals, forces, integral quantities, run metrics)
+ * into one buffer, reduced by a single non-blocking MPI_Iallreduce with an operation combining each value by its own
+ * REDUCTION_OP. Values are added between two reductions, the reduction is posted once and its results read after
+ * the wait, so the latency is hidden behind the work in between. One reduction is in flight at a time.
+ */
+class reduction_aggregator
+{
+public:
+  reduction_aggregator();
+
+  /*! append in_n values combined with in_op, returns the offset of the first one in the results */
+  int add(const double *in_vals, int in_n, int in_op);
+
+  /*! start the reduction of the values added since the previous one (collective), no-op if none were added */
+  void post(void);
+
+  /*! complete the posted reduction, no-op if none is in flight */
+  void wait(void);
+
+  bool is_posted(void) const { return posted; }
+
+  /*! results from in_offset, valid after the wait until the next value is added */
+  const double *get(int in_offset) const { return &results[in_offset]; }
+
+private:
+  bool posted;
+  std::vector<double> values, results;
+  std::vector<char> ops;
+
+  /*! results of the previous reduction are dropped at the first add of the next one */
+  bool done;
+
+#ifdef _MPI
+  MPI_Comm comm;
+  MPI_Op op;
+  MPI_Datatype type;
+  MPI_Request request;
+#endif
+};
+
+extern reduction_aggregator run_reduction;
@@ -52,6 +52,7 @@ struct solution {
   
   //restart/initialization parameter
   int num_cells_global;//defined in mesh reading
+  long long num_upts_global;//defined in Initializing Elements, total number of solution points
   int ini_iter;//defined in InitSolution
 
   //element parameters
@@ -73,13 +73,19 @@ void InitSolution(struct solution* FlowSol);
 
 /*! reading a restart file */
 void read_restart_ascii(int in_file_num, int in_n_files, struct solution* FlowSol);
+
+/*! reading the elements of this processor from ascii restart files using the restart index */
+void read_restart_ascii_index(int in_file_num, int in_n_files, ifstream& index_file, struct solution* FlowSol);
 #ifdef _HDF5
 void read_restart_hdf5(int in_file_num, struct solution* FlowSol);
 #endif
 
-//calculate global time step size
+//calculate global time step size, the minimum over the processors is packed in run_reduction
 void calc_time_step(struct solution* FlowSol);
 
+//complete run_reduction and set the time step of the step
+void complete_time_step(struct solution* FlowSol);
+
 
 
 
@@ -0,0 +1,332 @@
+/*!
+ * \file timer.h
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** enumeration for the timed stages of the solver */
+enum TIMER
+{
+  /*--- residual ---*/
+  T_CALC_RESIDUAL = 0,
+  T_SGS_TERMS,
+  T_EXTRAPOLATE_SOLUTION,
+  T_SEND_SOLUTION,
+  T_CALC_GRADIENT,
+  T_INV_FLUX,
+  T_BODY_FORCE,
+  T_INT_INV_FLUX,
+  T_BDY_INV_FLUX,
+  T_RECEIVE_SOLUTION,
+  T_MPI_INV_FLUX,
+  T_CORRECT_GRADIENT,
+  T_SEND_GRADIENT,
+  T_VISC_FLUX,
+  T_SGS_FLUX,
+  T_SEND_SGSF,
+  T_TOTAL_FLUX,
+  T_DIVERGENCE,
+  T_INT_VISC_FLUX,
+  T_BDY_VISC_FLUX,
+  T_RECEIVE_GRADIENT,
+  T_RECEIVE_SGSF,
+  T_MPI_WAIT,
+  T_MPI_VISC_FLUX,
+  T_CORRECTED_DIVERGENCE,
+  T_SOURCE_SA,
+  /*--- time integration ---*/
+  T_CALC_TIME_STEP,
+  T_REDUCTION_WAIT,
+  T_ADVANCE_SOLUTION,
+  T_SHOCK_CAPTURE,
+  /*--- monitoring and output ---*/
+  T_TIME_AVERAGE,
+  T_CALC_FORCES,
+  T_INTEGRAL_QUANTITIES,
+  T_NORM_RESIDUAL,
+  T_HISTORY_OUTPUT,
+  T_WRITE_OUTPUTS,
+  T_WRITE_PLOT,
+  T_WRITE_PROBE,
+  T_WRITE_RESTART,
+  N_TIMERS
+};
+
+/*! number of columns of the registry, one per element type and one for the stages not tied to an element type */
+#define N_TIMER_TYPES 7
+
+/** enumeration for the hardware counters collected per stage */
+enum PERF_COUNTER
+{
+  PC_CYCLES = 0,
+  PC_INSTRUCTIONS,
+  PC_LLC_MISSES,
+  PC_FP_OPS, //double precision operations, a packed or fused instruction counts each operation
+  N_PERF_COUNTERS
+};
+
+/** enumeration for the halo exchanges of the mpi interfaces */
+enum COMM_EXCHANGE
+{
+  CE_SOLUTION = 0,
+  CE_GRADIENT,
+  CE_SGSF,
+  N_COMM_EXCHANGES
+};
+
+/*!
+ * Accumulates the wall time and the number of calls of each stage, per element type.
+ * The counters are atomic so the output thread can time its writers while the solver runs.
+ */
+class timer_registry
+{
+public:
+  timer_registry();
+
+  /*! zero the counters and restart the wall clock the reports are relative to */
+  void reset(void);
+
+  /*! add one call of in_ns nanoseconds to a stage, in_ele_type=-1 for the stages not tied to an element type */
+  void add(int in_timer, int in_ele_type, long long in_ns)
+  {
+    int col = (in_ele_type < 0) ? N_TIMER_TYPES - 1 : in_ele_type;
+    time_ns[in_timer][col].fetch_add(in_ns, std::memory_order_relaxed);
+    n_calls[in_timer][col].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /*!
+   * print the time of each stage on this rank and its min/avg/max across ranks (collective).
+   * in_total=false reports the interval since the previous interval report.
+   */
+  void report(bool in_total, std::ostream &out);
+
+  /*! seconds and calls of a stage on this rank since the reset, all element types together */
+  double get_seconds(int in_timer);
+  long long get_calls(int in_timer);
+
+  /*! add the hardware counts of one call to a stage */
+  void add_counts(int in_timer, int in_ele_type, const long long *in_counts)
+  {
+    int col = (in_ele_type < 0) ? N_TIMER_TYPES - 1 : in_ele_type;
+    for (int i = 0; i < N_PERF_COUNTERS; i++)
+      counts[in_timer][col][i].fetch_add(in_counts[i], std::memory_order_relaxed);
+  }
+
+  /*!
+   * print the IPC, FP rate, memory bandwidth and arithmetic intensity of each stage since the reset (collective).
+   * Given the peak FP rate (GFLOP/s) and bandwidth (GB/s) of a core, also where each stage sits under the roofline.
+   */
+  void report_counters(double in_peak_gflops, double in_peak_bandwidth, std::ostream &out);
+
+private:
+  std::atomic<long long> time_ns[N_TIMERS][N_TIMER_TYPES];
+  std::atomic<long long> n_calls[N_TIMERS][N_TIMER_TYPES];
+  std::atomic<long long> counts[N_TIMERS][N_TIMER_TYPES][N_PERF_COUNTERS];
+
+  /*! counters at the previous interval report */
+  long long last_time_ns[N_TIMERS][N_TIMER_TYPES];
+  long long last_n_calls[N_TIMERS][N_TIMER_TYPES];
+
+  std::chrono::steady_clock::time_point start_time, last_time;
+};
+
+/*! one timed scope of the trace */
+struct trace_event
+{
+  long long begin_ns, dur_ns; //relative to the trace origin
+  short timer, ele_type;
+};
+
+/*!
+ * Records the timed scopes as a Chrome trace (chrome://tracing, Perfetto) timeline with one track per rank and thread.
+ * Each thread appends to its own preallocated buffer, registered once under a lock, so recording takes no lock.
+ * The cost is bounded by recording only while active and dropping the events beyond the buffer capacity.
+ */
+class trace_recorder
+{
+public:
+  trace_recorder() : active(false), capacity(0) {}
+
+  /*! set the events per thread and synchronize the time origin of all ranks (collective) */
+  void setup(long long in_capacity);
+
+  void set_active(bool in_active) { active.store(in_active, std::memory_order_release); }
+
+  bool is_active(void) const { return active.load(std::memory_order_acquire); }
+
+  /*! name the track of the calling thread, and allocate its buffer once set up */
+  void name_thread(const char *in_name);
+
+  void record(int in_timer, int in_ele_type, std::chrono::steady_clock::time_point in_begin, std::chrono::steady_clock::time_point in_end);
+
+  /*! write the events of all ranks to one trace file (collective) */
+  void write(const char *in_file_name);
+
+private:
+  struct thread_buffer
+  {
+    std::string name;
+    std::vector<trace_event> events;
+    size_t n_events;
+    long long n_dropped;
+  };
+
+  thread_buffer *get_buffer(void);
+
+  std::atomic<bool> active;
+  size_t capacity;
+  std::mutex buffers_mutex;
+  std::vector<std::unique_ptr<thread_buffer> > buffers;
+  std::chrono::steady_clock::time_point origin;
+};
+
+/*!
+ * Reads the hardware counters of the calling thread through the Linux perf_event_open interface, so no vendor
+ * tool or library is needed. Each thread opens its own event groups at its first read. Counters the processor,
+ * the kernel (perf_event_paranoid) or the build do not provide are reported as not available.
+ */
+class perf_counters
+{
+public:
+  perf_counters() : active(false), available(0), n_fp_events(0) {}
+
+  /*!
+   * enable the counters. in_fp_event is "auto" to pick the FP operation events from the CPU vendor,
+   * or a raw event code (e.g. 0x...) counting double precision operations
+   */
+  void setup(const std::string &in_fp_event);
+
+  bool is_active(void) const { return active.load(std::memory_order_acquire); }
+
+  /*! counts of the calling thread so far, scaled when the kernel multiplexes the counters */
+  void read(long long *out_counts);
+
+  /*! bit i is set when counter i could be opened by every thread that read the counters */
+  int get_available(void) const { return available.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> active;
+  std::atomic<int> available;
+
+  /*! raw FP events and the number of operations each event counts */
+  int n_fp_events;
+  unsigned long long fp_events[4];
+  int fp_weights[4];
+
+  void open_thread(void);
+};
+
+/*!
+ * Profiles the halo exchanges of the mpi interfaces: bytes and messages sent to each neighbor, time from posting
+ * a receive to its completion, and per exchange the compute time between posting and waiting and the time
+ * blocked waiting. Receives are tested at the end of every solver stage overlapping the exchange, so a completion
+ * is seen at most one stage late. Only the solver thread exchanges halos, so the counters are plain.
+ */
+class comm_profiler
+{
+public:
+  comm_profiler() : active(false), nproc(0) {}
+
+  /*! zero the counters for in_nproc ranks and start profiling */
+  void setup(int in_nproc);
+
+  bool is_active(void) const { return active; }
+
+  /*! one message of in_bytes posted to rank in_proc */
+  void add_message(int in_exchange, int in_proc, long long in_bytes)
+  {
+    n_messages[in_exchange][in_proc]++;
+    bytes[in_exchange][in_proc] += in_bytes;
+  }
+
+  /*! the message from rank in_proc completed in_seconds after it was posted */
+  void add_completion(int in_exchange, int in_proc, double in_seconds) { completion[in_exchange][in_proc] += in_seconds; }
+
+  /*! one wait, after in_compute seconds between posting and waiting, blocked for in_wait seconds */
+  void add_wait(int in_exchange, double in_compute, double in_wait)
+  {
+    n_waits[in_exchange]++;
+    compute_time[in_exchange] += in_compute;
+    wait_time[in_exchange] += in_wait;
+  }
+
+  /*! print the neighbor matrix of every rank and the load imbalance summary (collective) */
+  void report(std::ostream &out);
+
+private:
+  bool active;
+  int nproc;
+  std::vector<long long> n_messages[N_COMM_EXCHANGES], bytes[N_COMM_EXCHANGES];
+  std::vector<double> completion[N_COMM_EXCHANGES];
+  long long n_waits[N_COMM_EXCHANGES];
+  double compute_time[N_COMM_EXCHANGES], wait_time[N_COMM_EXCHANGES];
+};
+
+/*! times the enclosing scope and adds it to run_timers, and to run_trace while tracing */
+class scoped_timer
+{
+public:
+  scoped_timer(int in_timer, int in_ele_type = -1);
+
+  ~scoped_timer();
+
+private:
+  int timer, ele_type;
+  bool counting;
+  long long start_counts[N_PERF_COUNTERS];
+  std::chrono::steady_clock::time_point start;
+};
+
+extern timer_registry run_timers;
+extern trace_recorder run_trace;
+extern perf_counters run_perf;
+extern comm_profiler run_comm;
+
+inline scoped_timer::scoped_timer(int in_timer, int in_ele_type)
+    : timer(in_timer), ele_type(in_ele_type), counting(run_perf.is_active())
+{
+  if (counting)
+    run_perf.read(start_counts);
+  start = std::chrono::steady_clock::now();
+}
+
+inline scoped_timer::~scoped_timer()
+{
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  run_timers.add(timer, ele_type, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+  if (counting)
+  {
+    long long end_counts[N_PERF_COUNTERS];
+    run_perf.read(end_counts);
+    for (int i = 0; i < N_PERF_COUNTERS; i++)
+      end_counts[i] -= start_counts[i];
+    run_timers.add_counts(timer, ele_type, end_counts);
+  }
+  if (run_trace.is_active())
+    run_trace.record(timer, ele_type, start, end);
+}
@@ -23,6 +23,8 @@
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <csignal>
 
 #include "../include/global.h"
 #include "../include/geometry.h"
@@ -30,6 +32,9 @@
 #include "../include/output.h"
 #include "../include/solution.h"
 #include "../include/mesh.h"
+#include "../include/timer.h"
+#include "../include/mem_tracker.h"
+#include "../include/reduction.h"
 
 #ifdef _GPU
 #include "util.h"
@@ -37,21 +42,50 @@
 
 using namespace std;
 
+/*! Checkpoint request raised by a signal: 1 write a restart file (SIGUSR1), 2 write a restart file and stop (SIGTERM) */
+static volatile sig_atomic_t signal_ckpt = 0;
+
+static void catch_signal(int in_sig)
+{
+  if (in_sig == SIGTERM)
+    signal_ckpt = 2;
+  else if (signal_ckpt == 0)
+    signal_ckpt = 1;
+}
+
+/*! Write the history of iteration in_file_num once CompleteMonitoring has read its monitored quantities. */
+static void write_monitor(struct solution &FlowSol, output &run_output, int in_file_num, clock_t in_init_time, ofstream &write_hist)
+{
+  run_output.HistoryOutput(in_file_num, in_init_time, &write_hist);
+
+  if (FlowSol.rank == 0)
+    cout << endl;
+
+  /*! Print the stage timers of the steps since the previous report. */
+
+  if (run_input.timer_report == 2)
+    run_timers.report(false, cout);
+}
+
 int main(int argc, char *argv[]) {
 
   int rank = 0;
   int i, j;                           /*!< Loop iterators */
   int i_steps = 0;                    /*!< Iteration index */
   int RKSteps;                        /*!< Number of RK steps */
-  clock_t init_time, final_time;      /*!< To control the time */
+  clock_t init_time;                  /*!< To control the time */
   struct solution FlowSol;            /*!< Main structure with the flow solution and geometry */        
   ofstream write_hist;                /*!< Output files (forces, statistics, and history) */
   mesh* mesh_data=new mesh();         /*!< Store mesh information*/
+  int ckpt_local, ckpt = 0;            /*!< Checkpoint request of this rank and the one agreed by all ranks */
+  int monitor_iter = -1;              /*!< Iteration whose monitored quantities are being reduced, -1 if none */
+  chrono::steady_clock::time_point wall_start = chrono::steady_clock::now();
 
   /*! Initialize MPI. */
 
 #ifdef _MPI
-  MPI_Init(&argc, &argv);
+  int thread_level;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &thread_level);//multiple threads needed by asynchronous output
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 #endif
 
@@ -107,6 +141,18 @@ int main(int argc, char *argv[]) {
   GeoPreprocess(&FlowSol, *mesh_data);
   delete mesh_data;
 
+  /*! Print the memory of the arrays set up by the preprocessing. */
+
+  if (run_input.memory_report)
+  {
+#ifdef _MEM_TRACK
+    memory_tracker().report(false, "after preprocessing", cout);
+#else
+    if (rank == 0)
+      cout << "Warning: memory_report needs a build with USE_MEM_TRACK=ON" << endl;
+#endif
+  }
+
   /*! initialize object to output result/restart files */   
 
   output run_output(&FlowSol); 
@@ -115,10 +161,25 @@ int main(int argc, char *argv[]) {
 
   InitSolution(&FlowSol);
 
+  /*! Write the ascii restart files that were read as a HDF5 restart file and stop. */
+
+  if (run_input.restart_flag == 1 && run_input.convert_restart)
+  {
+    run_output.write_outputs(FlowSol.ini_iter, false, false, true);
+    run_output.close_outputs();
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return 0;
+  }
+
   /*! Read the probe file if needed and store the information in run_probe. */
 
   if (run_input.probe)
-    run_probe.setup(argv[1], &FlowSol, rank); 
+  {
+    run_probe.setup(argv[1], &FlowSol, rank);
+    run_output.setup_probe();
+  }
 
   /////////////////////////////////////////////////
   /// Pre-processing
@@ -156,16 +217,7 @@ int main(int argc, char *argv[]) {
 
   /*! Dump initial Paraview, tecplot or CGNS files. */
 
-  if (run_input.write_type == 0)
-    run_output.write_vtu(FlowSol.ini_iter + i_steps);
-  else if (run_input.write_type == 1)
-    run_output.write_tec(FlowSol.ini_iter + i_steps);
-#ifdef _CGNS
-  else if (run_input.write_type == 2)
-    run_output.write_CGNS(FlowSol.ini_iter + i_steps);
-#endif
-  else
-    FatalError("ERROR: Trying to write unrecognized file format ... ");
+  run_output.write_outputs(FlowSol.ini_iter + i_steps, true, false, false);
 
   if (FlowSol.rank == 0) cout << endl;
 
@@ -175,31 +227,83 @@ int main(int argc, char *argv[]) {
 
   init_time = clock();
 
+  /*! Catch the signals sent by batch schedulers before a job is killed. */
+
+  signal(SIGTERM, catch_signal);
+  signal(SIGUSR1, catch_signal);
+#ifdef _MPI
+  int ckpt_send = 0, ckpt_recv = 0;
+  MPI_Request ckpt_req = MPI_REQUEST_NULL;
+  MPI_Comm ckpt_comm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &ckpt_comm);
+#endif
+  chrono::steady_clock::time_point loop_start = chrono::steady_clock::now();
+  run_timers.reset();
+  run_output.reset_metrics(FlowSol.ini_iter);
+  if (run_input.trace_end >= run_input.trace_start)
+  {
+    run_trace.setup(run_input.trace_buffer);
+    run_trace.name_thread("solver");
+  }
+  if (run_input.perf_counters)
+    run_perf.setup(run_input.perf_fp_event);
+#ifdef _MPI
+  if (run_input.comm_profile)
+    run_comm.setup(FlowSol.nproc);
+#endif
+
   /*! Main solver loop (outer loop). */
 
   while (i_steps < run_input.n_steps)
   {
+    run_trace.set_active(FlowSol.ini_iter + i_steps + 1 >= run_input.trace_start &&
+                         FlowSol.ini_iter + i_steps + 1 <= run_input.trace_end);
 
     //compute time step if using automatic time step
 
     calc_time_step(&FlowSol);
 
+    /*! One reduction for the time step and the quantities monitored at the end of the previous step,
+        completed once the first stage residual is computed. */
+
+    run_reduction.post();
+
     for (i = 0; i < RKSteps; i++)
     {
       /*! Spatial integration. */
 
       CalcResidual(FlowSol.ini_iter + i_steps, i, &FlowSol);
 
+      if (i == 0)
+      {
+        complete_time_step(&FlowSol);
+        run_output.CompleteMonitoring();
+        if (monitor_iter >= 0)
+        {
+          write_monitor(FlowSol, run_output, monitor_iter, init_time, write_hist);
+          monitor_iter = -1;
+        }
+      }
+
       /*! Time integration using a RK scheme */
 
       for (j = 0; j < FlowSol.n_ele_types; j++)
+      {
+        scoped_timer timer(T_ADVANCE_SOLUTION, FlowSol.mesh_eles(j)->get_ele_type());
         FlowSol.mesh_eles(j)->AdvanceSolution(i, run_input.adv_type);
+      }
     
         /*! Shock capturing */
 
       if (run_input.shock_cap)
+      {
+        bool detect = (run_input.shock_det_freq == 0) || (i == 0 && i_steps % run_input.shock_det_freq == 0);
         for (j = 0; j < FlowSol.n_ele_types; j++)
-          FlowSol.mesh_eles(j)->shock_capture();
+        {
+          scoped_timer timer(T_SHOCK_CAPTURE, FlowSol.mesh_eles(j)->get_ele_type());
+          FlowSol.mesh_eles(j)->shock_capture(detect);
+        }
+      }
     }
 
     /*! Update total time, and increase the iteration index. */
@@ -245,72 +349,131 @@ int main(int argc, char *argv[]) {
 
       /*! Compute the norm of the residual. */
 
-      run_output.CalcNormResidual();
+      run_output.CalcNormResidual(FlowSol.ini_iter + i_steps);
 
-      /*! Output the history file. */
+      /*! The sums over the processors are reduced with the time step of the next step, the history is written then. */
 
-      run_output.HistoryOutput(FlowSol.ini_iter + i_steps, init_time, &write_hist);
-
-      if (FlowSol.rank == 0)
-        cout << endl;
+      monitor_iter = FlowSol.ini_iter + i_steps;
     }
-    /*! Dump Paraview, Tecplot or CGNS files. */
+    /*! Dump Paraview, Tecplot or CGNS, probe and restart files. */
 
-    if (i_steps % run_input.plot_freq == 0)
-    {
-      if (run_input.write_type == 0)
-        run_output.write_vtu(FlowSol.ini_iter + i_steps);
-      else if (run_input.write_type == 1)
-        run_output.write_tec(FlowSol.ini_iter + i_steps);
-#ifdef _CGNS
-      else if (run_input.write_type == 2)
-        run_output.write_CGNS(FlowSol.ini_iter + i_steps);
-#endif
-      else
-        FatalError("ERROR: Trying to write unrecognized file format ... ");
-    }
+    run_output.write_outputs(FlowSol.ini_iter + i_steps,
+                             i_steps % run_input.plot_freq == 0,
+                             run_input.probe != 0 && i_steps % run_probe.probe_freq == 0,
+                             i_steps % run_input.restart_dump_freq == 0);
 
-    /*! Write probe file. */
+    /*! Checkpoint on request. The requests raised during a step are combined by a non-blocking
+        reduction that completes during the next step, so all ranks act at the same step. */
 
-        if(run_input.probe!=0)
-        {
-            if((i_steps%run_probe.probe_freq==0))
-#ifdef _HDF5
-              run_output.write_probe_hdf5();
+    ckpt_local = signal_ckpt;
+    if (ckpt_local == 1)
+      signal_ckpt = 0;
+    if (run_input.walltime > 0. && rank == 0)
+    {
+      double wall_elapsed = chrono::duration<double>(chrono::steady_clock::now() - wall_start).count();
+      double step_time = chrono::duration<double>(chrono::steady_clock::now() - loop_start).count() / i_steps;
+      long long n_restarts = run_timers.get_calls(T_WRITE_RESTART);
+      double restart_time = n_restarts ? run_timers.get_seconds(T_WRITE_RESTART) / n_restarts : 0.;
+      //stop while there is time left for the step the request takes to be agreed, the restart file and the margin
+      if (wall_elapsed + 2. * step_time + restart_time + run_input.walltime_margin > run_input.walltime)
+        ckpt_local = 2;
+    }
+#ifdef _MPI
+    ckpt = 0;
+    if (ckpt_req != MPI_REQUEST_NULL)
+    {
+      MPI_Wait(&ckpt_req, MPI_STATUS_IGNORE);
+      ckpt = ckpt_recv;
+    }
+    ckpt_send = ckpt_local;
+    MPI_Iallreduce(&ckpt_send, &ckpt_recv, 1, MPI_INT, MPI_MAX, ckpt_comm, &ckpt_req);
 #else
-              run_output.write_probe_ascii();
+    ckpt = ckpt_local;
 #endif
-        }
 
-    /*! Dump restart file. */
+    if (ckpt)
+    {
+      if (rank == 0)
+        cout << "Checkpoint requested, restart from step " << FlowSol.ini_iter + i_steps << endl;
+      if (i_steps % run_input.restart_dump_freq != 0)
+        run_output.write_outputs(FlowSol.ini_iter + i_steps, false, false, true);
+      if (ckpt == 2)
+        break;
+    }
+  }
+
+  /*! Reduce the quantities monitored at the last step and write its history. */
 
-        if (i_steps % run_input.restart_dump_freq == 0)
-        {
-#ifdef _HDF5
-          run_output.write_restart_hdf5(FlowSol.ini_iter + i_steps);
-#else
-          run_output.write_restart_ascii(FlowSol.ini_iter + i_steps);
+  run_reduction.post();
+  run_output.CompleteMonitoring();
+  if (monitor_iter >= 0)
+    write_monitor(FlowSol, run_output, monitor_iter, init_time, write_hist);
+
+#ifdef _MPI
+  if (ckpt_req != MPI_REQUEST_NULL)
+    MPI_Wait(&ckpt_req, MPI_STATUS_IGNORE);
+  MPI_Comm_free(&ckpt_comm);
 #endif
-        }
-  }
 
   /////////////////////////////////////////////////
   /// End simulation
   /////////////////////////////////////////////////
 
+  /*! Wait for the background output to finish. */
+
+  run_output.close_outputs();
+
+  /*! Write the timeline of the traced steps. */
+
+  run_trace.set_active(false);
+  if (run_input.trace_end >= run_input.trace_start)
+    run_trace.write((run_input.data_file_name + "_trace.json").c_str());
+
   /*! Calculate Error */
   if (run_input.test_case)
     run_output.compute_error(FlowSol.ini_iter + i_steps);
     
+  /*! Print the stage timers of the whole run. */
+
+  if (run_input.timer_report)
+  {
+    if (rank == 0)
+      cout << endl;
+    run_timers.report(true, cout);
+    if (run_input.perf_counters)
+    {
+      if (rank == 0)
+        cout << endl;
+      run_timers.report_counters(run_input.roofline_gflops, run_input.roofline_bandwidth, cout);
+    }
+  }
+
+#ifdef _MPI
+  if (run_input.comm_profile)
+  {
+    if (rank == 0)
+      cout << endl;
+    run_comm.report(cout);
+  }
+#endif
+
+#ifdef _MEM_TRACK
+  if (run_input.memory_report)
+  {
+    if (rank == 0)
+      cout << endl;
+    memory_tracker().report(true, "over the run", cout);
+  }
+#endif
+
   /*! Close convergence history file. */
 
   if (rank == 0) {
     write_hist.close();
 
-  /*! Compute execution time. */
+  /*! Compute execution (wall) time of the solver loop. */
 
-  final_time = clock()-init_time;
-  printf("Execution time= %f s\n", (double) final_time/((double) CLOCKS_PER_SEC));
+  printf("Execution time= %f s\n", chrono::duration<double>(chrono::steady_clock::now() - loop_start).count());
     }
   /*! Finalize MPI. */
 
@@ -28,6 +28,8 @@
 
 #include "../include/global.h"
 #include "../include/cubature_1d.h"
+#include "JacobiGQ_table.h"
+#include "JacobiGL_table.h"
 
 using namespace std;
 
@@ -47,44 +49,33 @@ cubature_1d::cubature_1d()
 
 cubature_1d::cubature_1d(int in_rule, int in_order) // set by order of quadrature rule, n_pts=order+1,accuracy=2*n_pts-1
 {
-  if (HIFILES_DIR == NULL)
-    FatalError("environment variable HIFILES_HOME is undefined");
-
   order = in_order;
   n_pts = order + 1;
   locs.setup(n_pts);
   weights.setup(n_pts);
-  string filename;
-  filename = HIFILES_DIR;
-  ifstream datfile;
+  const double *table;
 
-//set file name
+//set table
   if (in_rule == 0) //Gauss
-    filename += "/data/JacobiGQ.bin";
+    table = JacobiGQ_table;
   else if (in_rule == 1) //Gauss Lobatto
-    filename += "/data/JacobiGL.bin";
+    table = JacobiGL_table;
   else
     FatalError("cubature rule not implemented.");
 
   if (order <= 15 && order >= 0)
   {
-    //open file
-    datfile.open(filename.c_str(), ios_base::binary);
-  if (!datfile)
-    FatalError("Unable to open cubature file");
-
     //skip lines
     int skip = (1+order)*order;
-    datfile.seekg(sizeof(double) * skip, ios_base::beg);
-    //read file
-    datfile.read((char *)locs.get_ptr_cpu(), sizeof(double) * n_pts);
-    datfile.read((char *)weights.get_ptr_cpu(), sizeof(double) * n_pts);
-    //close file
-    datfile.close();
+    //copy locations and weights
+    for (int i = 0; i < n_pts; i++)
+    {
+      locs(i) = table[skip + i];
+      weights(i) = table[skip + n_pts + i];
+    }
   }
   else
   {
-    datfile.close();
     FatalError("cubature order not implemented.");
   }
 }
@@ -28,6 +28,8 @@
 
 #include "../include/global.h"
 #include "../include/cubature_tet.h"
+#include "tet_inter_table.h"
+#include "tet_alpha_table.h"
 
 using namespace std;
 
@@ -47,16 +49,11 @@ cubature_tet::cubature_tet()
 
 cubature_tet::cubature_tet(int in_rule, int in_order) // set by order
 {
-  if (HIFILES_DIR == NULL)
-    FatalError("environment variable HIFILES_HOME is undefined");
-
   order = in_order;
   n_pts = (order + 1) * (order + 2) * (order + 3) / 6;
   locs.setup(n_pts, 3);
   weights.setup(n_pts);
-  string filename;
-  filename = HIFILES_DIR;
-  ifstream datfile;
+  const double *table;
   int upper_order_lim, lower_order_lim;
 
   //set rule-dependent variables
@@ -65,47 +62,32 @@ cubature_tet::cubature_tet(int in_rule, int in_order) // set by order
     lower_order_lim = 0;
     upper_order_lim = 6;
     if_weight = 1;
-    filename += "/data/tet_inter.bin";
+    table = tet_inter_table;
   }
   else if (in_rule == 1) //alpha
   {
     lower_order_lim = 1;
     upper_order_lim = 15;
     if_weight = 0;
-    filename += "/data/tet_alpha.bin";
+    table = tet_alpha_table;
   }
   else
   FatalError("Cubature rule not implemented");
 
   if (order <= upper_order_lim && order >= lower_order_lim)
   {
-    hf_array<double> temp_loc_0(n_pts);
-    hf_array<double> temp_loc_1(n_pts);
-    hf_array<double> temp_loc_2(n_pts);
-
-    //open file
-    datfile.open(filename.c_str(), ifstream::binary);
-    if (!datfile)
-      FatalError("Unable to open cubature file");
     //skip lines
     int skip = 0;
     for (int i = lower_order_lim; i < order; i++)
       skip += (3+if_weight) * (i + 1) * (i + 2) * (i + 3) / 6;
-    datfile.seekg(sizeof(double) * skip, ios_base::beg);
-    // read file
-    datfile.read((char *)temp_loc_0.get_ptr_cpu(), sizeof(double) * n_pts);
-    datfile.read((char *)temp_loc_1.get_ptr_cpu(), sizeof(double) * n_pts);
-    datfile.read((char *)temp_loc_2.get_ptr_cpu(), sizeof(double) * n_pts);
-    if (if_weight)
-      datfile.read((char *)weights.get_ptr_cpu(), sizeof(double) * n_pts);
-    //close file
-    datfile.close();
-    //assign values to locs
+    //copy locations and weights, stored as r, s, t and weight blocks of n_pts
     for (int i = 0; i < n_pts; i++)
     {
-      locs(i, 0) = temp_loc_0(i);
-      locs(i, 1) = temp_loc_1(i);
-      locs(i, 2) = temp_loc_2(i);
+      locs(i, 0) = table[skip + i];
+      locs(i, 1) = table[skip + n_pts + i];
+      locs(i, 2) = table[skip + 2 * n_pts + i];
+      if (if_weight)
+        weights(i) = table[skip + 3 * n_pts + i];
     }
   }
   else
@@ -28,6 +28,8 @@
 
 #include "../include/global.h"
 #include "../include/cubature_tri.h"
+#include "tri_inter_table.h"
+#include "tri_alpha_table.h"
 
 using namespace std;
 
@@ -47,16 +49,11 @@ cubature_tri::cubature_tri()
 
 cubature_tri::cubature_tri(int in_rule, int in_order) // set by order
 {
-  if (HIFILES_DIR == NULL)
-    FatalError("environment variable HIFILES_HOME is undefined");
-
   order = in_order;
   n_pts = (order + 1) * (order + 2) / 2;
   locs.setup(n_pts,2);
   weights.setup(n_pts);
-  string filename;
-  filename = HIFILES_DIR;
-  ifstream datfile;
+  const double *table;
   int upper_order_lim, lower_order_lim;
 
   //set rule-dependent variables
@@ -65,44 +62,31 @@ cubature_tri::cubature_tri(int in_rule, int in_order) // set by order
     lower_order_lim = 0;
     upper_order_lim = 7;
     if_weight = 1;
-    filename += "/data/tri_inter.bin";
+    table = tri_inter_table;
   }
   else if (in_rule == 1) //alpha
   {
     lower_order_lim = 1;
     upper_order_lim = 15;
     if_weight = 0;
-    filename += "/data/tri_alpha.bin";
+    table = tri_alpha_table;
   }
   else
   FatalError("Cubature rule not implemented");
 
   if (order <= upper_order_lim && order >= lower_order_lim)
   {
-    hf_array<double> temp_loc_0(n_pts);
-    hf_array<double> temp_loc_1(n_pts);
-
-    //open file
-    datfile.open(filename.c_str(), ifstream::binary);
-    if (!datfile)
-      FatalError("Unable to open cubature file");
     //skip lines
     int skip = 0;
     for (int i = lower_order_lim; i < order; i++)
       skip += (2+if_weight) * (i + 1) * (i + 2) / 2;
-    datfile.seekg(sizeof(double) * skip, ios_base::beg);
-    // read file
-    datfile.read((char *)temp_loc_0.get_ptr_cpu(), sizeof(double) * n_pts);
-    datfile.read((char *)temp_loc_1.get_ptr_cpu(), sizeof(double) * n_pts);
-    if (if_weight)
-      datfile.read((char *)weights.get_ptr_cpu(), sizeof(double) * n_pts);
-    //close file
-    datfile.close();
-    //assign values to locs
+    //copy locations and weights, stored as r, s and weight blocks of n_pts
     for (int i = 0; i < n_pts; i++)
     {
-      locs(i, 0) = temp_loc_0(i);
-      locs(i, 1) = temp_loc_1(i);
+      locs(i, 0) = table[skip + i];
+      locs(i, 1) = table[skip + n_pts + i];
+      if (if_weight)
+        weights(i) = table[skip + 2 * n_pts + i];
     }
   }
   else
@@ -25,6 +25,7 @@
 #include <iomanip>
 #include <cmath>
 #include <numeric>
+#include <algorithm>
 
 #include "../include/global.h"
 #include "../include/eles.h"
@@ -49,7 +50,12 @@ eles::eles()
 
 // default destructor
 
-eles::~eles() {}
+eles::~eles()
+{
+#ifdef _MEM_TRACK
+  memory_tracker().remove_owner(this);
+#endif
+}
 
 // #### methods ####
 
@@ -60,6 +66,7 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
 
     n_eles=in_n_eles;
     max_n_spts_per_ele = in_max_n_spts_per_ele;
+    out_snap = 0;
 
     if (n_eles!=0)
     {
@@ -78,10 +85,6 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
         // Initialize the element specific static members
         (*this).setup_ele_type_specific();
 
-        //initialize probes
-        if(run_input.probe)
-            opp_probe.setup(n_upts_per_ele);
-
         if(run_input.adv_type==0)//Euler
         {
             n_adv_levels=1;
@@ -212,10 +215,32 @@ void eles::setup(int in_n_eles, int in_max_n_spts_per_ele)
             grad_disu_fpts.initialize_to_zero();
         }
 
-        if(run_input.shock_cap)
+        if(run_input.shock_cap || run_input.over_int == 2)
         {
             sensor.setup(n_eles);
             sensor.initialize_to_zero();
+            modal_energy_sensor.setup(n_upts_per_ele, n_eles);
+        }
+
+        // gathered storage for filtering flagged elements
+        if(run_input.shock_cap)
+        {
+            n_shock_eles = 0;
+            shock_list.setup(n_eles);
+            disu_shock_batch.setup(n_upts_per_ele, n_fields, min(n_eles, MAX_ELE_BATCH));
+            filt_disu_shock_batch.setup(n_upts_per_ele, n_fields, min(n_eles, MAX_ELE_BATCH));
+        }
+
+        // gathered storage for selective over-integration, elements are processed in batches
+        if(run_input.over_int == 2)
+        {
+            int n_cubpts = loc_over_int_cubpts.get_dim(1);
+            n_over_int_batch = min(n_eles, MAX_ELE_BATCH);
+            over_int_list.setup(n_eles);
+            disu_over_int_batch.setup(n_upts_per_ele, n_fields, n_over_int_batch);
+            u_over_int_batch.setup(n_cubpts, n_fields, n_over_int_batch);
+            tdisf_over_int_batch.setup(n_cubpts, n_fields, n_dims, n_over_int_batch);
+            tdisf_upts_over_int_batch.setup(n_upts_per_ele, n_fields, n_dims, n_over_int_batch);
         }
 
         // Set connectivity hf_array. Needed for output.
@@ -702,22 +727,7 @@ void eles::read_restart_data_ascii(ifstream& restart_file)
 
         if (index!=-1) // Ele belongs to processor
         {
-            for (int j=0; j<n_upts_per_ele_rest; j++)
-                for (int k=0; k<n_fields; k++)
-                    restart_file >> disu_upts_rest(j,k);
-
-            // Now compute transformed solution at solution points using opp_r
-            for (int m=0; m<n_fields; m++)
-            {
-                for (int j=0; j<n_upts_per_ele; j++)
-                {
-                    double value = 0.;
-                    for (int k=0; k<n_upts_per_ele_rest; k++)
-                        value += opp_r(j,k)*disu_upts_rest(k,m);
-
-                    disu_upts(0)(j,index,m) = value;
-                }
-            }
+            read_restart_ele_ascii(restart_file,index,disu_upts_rest);
         }
         else // Skip the data (doesn't belong to current processor)
         {
@@ -728,7 +738,75 @@ void eles::read_restart_data_ascii(ifstream& restart_file)
         }
     }
 
-    // If required, calculate element reference lengths
+    set_h_ref();
+}
+
+void eles::read_restart_data_ascii(vector<string>& in_file_names, hf_array<long long>& in_index)
+{
+    ifstream restart_file;
+    int ele;
+    long long cur_file=-1;
+    hf_array<double> disu_upts_rest;
+    disu_upts_rest.setup(n_upts_per_ele_rest,n_fields);
+
+    // elements are visited in file order so that every file is opened once and read forward
+    vector<int> order(n_eles);
+    for (int i=0; i<n_eles; i++)
+        order[i]=i;
+    sort(order.begin(),order.end(),[&in_index](int a, int b)
+    { return in_index(0,a)<in_index(0,b) || (in_index(0,a)==in_index(0,b) && in_index(1,a)<in_index(1,b)); });
+
+    for (int i=0; i<n_eles; i++)
+    {
+        int index=order[i];
+        if (in_index(0,index)<0)
+            FatalError("Element missing from the restart index");
+        if (in_index(0,index)!=cur_file)
+        {
+            restart_file.close();
+            cur_file=in_index(0,index);
+            restart_file.open(in_file_names[cur_file].c_str());
+            if (!restart_file)
+                FatalError("Could not open restart file ");
+        }
+        restart_file.clear();
+        restart_file.seekg(in_index(1,index));
+        restart_file >> ele;
+        if (ele!=ele2global_ele(index))
+            FatalError("Restart index does not match the restart files");
+        read_restart_ele_ascii(restart_file,index,disu_upts_rest);
+    }
+    restart_file.close();
+
+    set_h_ref();
+}
+
+// read one element of the restart file and interpolate it to the solution points
+
+void eles::read_restart_ele_ascii(ifstream& restart_file, int in_ele, hf_array<double>& disu_upts_rest)
+{
+    for (int j=0; j<n_upts_per_ele_rest; j++)
+        for (int k=0; k<n_fields; k++)
+            restart_file >> disu_upts_rest(j,k);
+
+    // Now compute transformed solution at solution points using opp_r
+    for (int m=0; m<n_fields; m++)
+    {
+        for (int j=0; j<n_upts_per_ele; j++)
+        {
+            double value = 0.;
+            for (int k=0; k<n_upts_per_ele_rest; k++)
+                value += opp_r(j,k)*disu_upts_rest(k,m);
+
+            disu_upts(0)(j,in_ele,m) = value;
+        }
+    }
+}
+
+// If required, calculate element reference lengths
+
+void eles::set_h_ref(void)
+{
     if (run_input.dt_type > 0)
     {
         // Allocate hf_array
@@ -842,7 +920,7 @@ void eles::read_restart_data_hdf5(hid_t &restart_file)
 #endif
 
 #ifndef _HDF5
-void eles::write_restart_data_ascii(ofstream& restart_file)
+void eles::write_restart_data_ascii(ofstream& restart_file, vector<long long> &out_index)
 {
     restart_file << "n_eles" << endl;
     restart_file << n_eles << endl;
@@ -855,12 +933,14 @@ void eles::write_restart_data_ascii(ofstream& restart_file)
 
     for (int i=0; i<n_eles; i++)
     {
+        out_index.push_back(ele2global_ele(i));
+        out_index.push_back(restart_file.tellp());
         restart_file << ele2global_ele(i) << endl;
         for (int j=0; j<n_upts_per_ele; j++)
         {
             for (int k=0; k<n_fields; k++)
             {
-                restart_file << disu_upts(0)(j,i,k) << " ";
+                restart_file << (out_snap ? disu_upts_out(j,i,k) : disu_upts(0)(j,i,k)) << " ";
             }
             restart_file << endl;
         }
@@ -907,7 +987,7 @@ void eles::write_restart_data_hdf5(hid_t &in_dataset_id)
             if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_OR, offset, NULL, count, NULL) < 0)
                 FatalError("Failed to find this element");
         }
-        H5Dwrite(in_dataset_id, H5T_NATIVE_DOUBLE, memspace_id, dataspace_id, plist_id, disu_upts(0).get_ptr_cpu());
+        H5Dwrite(in_dataset_id, H5T_NATIVE_DOUBLE, memspace_id, dataspace_id, plist_id, out_snap ? disu_upts_out.get_ptr_cpu() : disu_upts(0).get_ptr_cpu());
         //close objects
         H5Sclose(memspace_id);
         H5Sclose(dataspace_id);
@@ -1099,9 +1179,9 @@ void eles::AdvanceSolution(int in_step, int adv_type)
                     for(inp=0; inp<n_upts_per_ele; inp++)
                     {
                         if (run_input.dt_type == 2)//local time step
-                            disu_upts(0)(inp, ic, i) -= dt_local(ic) * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) - src_upts(inp, ic, i));
+                            disu_upts(0)(inp, ic, i) -= dt_local(ic) * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) - src_upts(inp, ic, i));
                         else//global time step
-                            disu_upts(0)(inp, ic, i) -= run_input.dt * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) - src_upts(inp, ic, i));
+                            disu_upts(0)(inp, ic, i) -= run_input.dt * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) - src_upts(inp, ic, i));
                     }
                 }
             }
@@ -1136,9 +1216,9 @@ void eles::AdvanceSolution(int in_step, int adv_type)
                         for (inp = 0; inp < n_upts_per_ele; inp++)
                         {
                             if (run_input.dt_type == 2)//local time step
-                                disu_upts(0)(inp, ic, i) -= dt_local(ic) / 3.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) - src_upts(inp, ic, i));
+                                disu_upts(0)(inp, ic, i) -= dt_local(ic) / 3.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) - src_upts(inp, ic, i));
                             else//global time step
-                                disu_upts(0)(inp, ic, i) -= run_input.dt / 3.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) - src_upts(inp, ic, i));
+                                disu_upts(0)(inp, ic, i) -= run_input.dt / 3.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) - src_upts(inp, ic, i));
                         }
                     }
                 }
@@ -1152,7 +1232,7 @@ void eles::AdvanceSolution(int in_step, int adv_type)
                     {
                         for (inp = 0; inp < n_upts_per_ele; inp++)
                         {
-                            rhs = -div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) + src_upts(inp, ic, i); //function
+                            rhs = -div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) + src_upts(inp, ic, i); //function
                             if (run_input.dt_type == 2)//local time step
                                 disu_upts(0)(inp, ic, i) = 3.0 / 4.0 * disu_upts(0)(inp, ic, i) + 1.0 / 4.0 * disu_upts(1)(inp, ic, i) + dt_local(ic) / 4.0 * rhs;
                             else//global time step
@@ -1186,9 +1266,9 @@ void eles::AdvanceSolution(int in_step, int adv_type)
                         for (inp = 0; inp < n_upts_per_ele; inp++)
                         {
                             if (run_input.dt_type == 2)//local time step
-                                disu_upts(0)(inp, ic, i) -= dt_local(ic) / 2.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) - src_upts(inp, ic, i));
+                                disu_upts(0)(inp, ic, i) -= dt_local(ic) / 2.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) - src_upts(inp, ic, i));
                             else//global time step
-                                disu_upts(0)(inp, ic, i) -= run_input.dt / 2.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) - src_upts(inp, ic, i));
+                                disu_upts(0)(inp, ic, i) -= run_input.dt / 2.0 * (div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) - src_upts(inp, ic, i));
                         }
                     }
                 }
@@ -1202,7 +1282,7 @@ void eles::AdvanceSolution(int in_step, int adv_type)
                     {
                         for (inp = 0; inp < n_upts_per_ele; inp++)
                         {
-                            rhs = -div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) + src_upts(inp, ic, i); //function
+                            rhs = -div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) + src_upts(inp, ic, i); //function
                             if (run_input.dt_type == 2)//local time step
                                 disu_upts(0)(inp, ic, i) = 1.0 / 3.0 * disu_upts(0)(inp, ic, i) + 2.0 / 3.0 * disu_upts(1)(inp, ic, i) + dt_local(ic) / 6.0 * rhs;
                             else//global time step
@@ -1236,7 +1316,7 @@ void eles::AdvanceSolution(int in_step, int adv_type)
                 {
                     for (inp=0; inp<n_upts_per_ele; inp++)
                     {
-                        rhs = -div_tconf_upts(0)(inp, ic, i) / detjac_upts(inp, ic) + src_upts(inp, ic, i); //function
+                        rhs = -div_tconf_upts(0)(inp, ic, i) / detjac_upts(geo_upt(inp, ic)) + src_upts(inp, ic, i); //function
                         if (run_input.dt_type == 2)
                             disu_upts(1)(inp, ic, i) = run_input.RK_a(in_step) * disu_upts(1)(inp, ic, i) + dt_local(ic) * rhs; //new delta x
                         else
@@ -1449,7 +1529,7 @@ void eles::evaluate_invFlux(void)
                 // Transform from static physical space to computational space
 
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, n_fields, n_dims, n_dims, 1.0, temp_f.get_ptr_cpu(), n_fields, JGinv_upts.get_ptr_cpu(0, 0, j, i), n_dims, 0.0, temp_tdisf_upts.get_ptr_cpu(), n_fields);
+                cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, n_fields, n_dims, n_dims, 1.0, temp_f.get_ptr_cpu(), n_fields, JGinv_upts.get_ptr_cpu(0, 0, geo_upt(j, i)), n_dims, 0.0, temp_tdisf_upts.get_ptr_cpu(), n_fields);
                 for (k = 0; k < n_fields; k++)
                     for (l = 0; l < n_dims; l++)
                         tdisf_upts(j, i, k, l) = temp_tdisf_upts(k, l);
@@ -1461,7 +1541,7 @@ void eles::evaluate_invFlux(void)
                         tdisf_upts(j,i,k,l)=0.;
                         for(m=0; m<n_dims; m++)
                         {
-                            tdisf_upts(j,i,k,l) += JGinv_upts(l,m,j,i)*temp_f(k,m);//JGinv_upts(j,i,l,m)*temp_f(k,m);
+                            tdisf_upts(j,i,k,l) += JGinv_upts(l, m, geo_upt(j, i))*temp_f(k,m);//JGinv_upts(j,i,l,m)*temp_f(k,m);
                         }
                     }
                 }
@@ -1544,6 +1624,89 @@ void eles::evaluate_invFlux_over_int(void)
     }
 }
 
+void eles::evaluate_invFlux_over_int_selective(void)
+{
+    if (n_eles != 0)
+    {
+        int i, j, k, l, m, b;
+        int n_cubpts = loc_over_int_cubpts.get_dim(1);
+        int n_flag, n_b;
+
+        //collocated flux in all elements
+        evaluate_invFlux();
+
+        //update sensor if not updated by shock capturing
+        if (!run_input.shock_cap)
+            shock_det_persson();
+
+        //compact the list of flagged elements
+        n_flag = 0;
+        for (i = 0; i < n_eles; i++)
+            if (sensor(i) >= run_input.over_int_s0)
+                over_int_list(n_flag++) = i;
+
+        for (int start = 0; start < n_flag; start += n_over_int_batch)
+        {
+            n_b = min(n_over_int_batch, n_flag - start);
+
+            //gather solution of flagged elements
+            for (b = 0; b < n_b; b++)
+                for (k = 0; k < n_fields; k++)
+                    for (j = 0; j < n_upts_per_ele; j++)
+                        disu_over_int_batch(j, k, b) = disu_upts(0)(j, over_int_list(start + b), k);
+
+            //interpolate the solution to over_int_cubpts
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_cubpts, n_fields * n_b, n_upts_per_ele, 1.0, opp_over_int_cubpts.get_ptr_cpu(), n_cubpts, disu_over_int_batch.get_ptr_cpu(), n_upts_per_ele, 0.0, u_over_int_batch.get_ptr_cpu(), n_cubpts);
+#else
+            dgemm(n_cubpts, n_fields * n_b, n_upts_per_ele, 1.0, 0.0, opp_over_int_cubpts.get_ptr_cpu(), disu_over_int_batch.get_ptr_cpu(), u_over_int_batch.get_ptr_cpu());
+#endif
+
+            for (b = 0; b < n_b; b++)
+            {
+                i = over_int_list(start + b);
+                for (j = 0; j < n_cubpts; j++) //loop over over_int_cubpts
+                {
+                    for (k = 0; k < n_fields; k++)
+                        temp_u(k) = u_over_int_batch(j, k, b);
+
+                    if (n_dims == 2)
+                        calc_invf_2d(temp_u, temp_f);
+                    else if (n_dims == 3)
+                        calc_invf_3d(temp_u, temp_f);
+                    else
+                        FatalError("Invalid number of dimensions!");
+
+                    // Transform from static physical space to computational space
+                    for (k = 0; k < n_fields; k++)
+                    {
+                        for (l = 0; l < n_dims; l++)
+                        {
+                            tdisf_over_int_batch(j, k, l, b) = 0.;
+                            for (m = 0; m < n_dims; m++)
+                                tdisf_over_int_batch(j, k, l, b) += JGinv_over_int_cubpts(l, m, j, i) * temp_f(k, m);
+                        }
+                    }
+                }
+            }
+
+            //apply over integration filter, project transformd inviscid flux from over_int_cubpts back to upts
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_upts_per_ele, n_fields * n_dims * n_b, n_cubpts, 1.0, over_int_filter.get_ptr_cpu(), n_upts_per_ele, tdisf_over_int_batch.get_ptr_cpu(), n_cubpts, 0.0, tdisf_upts_over_int_batch.get_ptr_cpu(), n_upts_per_ele);
+#else
+            dgemm(n_upts_per_ele, n_fields * n_dims * n_b, n_cubpts, 1.0, 0.0, over_int_filter.get_ptr_cpu(), tdisf_over_int_batch.get_ptr_cpu(), tdisf_upts_over_int_batch.get_ptr_cpu());
+#endif
+
+            //scatter flux back to flagged elements
+            for (b = 0; b < n_b; b++)
+                for (l = 0; l < n_dims; l++)
+                    for (k = 0; k < n_fields; k++)
+                        for (j = 0; j < n_upts_per_ele; j++)
+                            tdisf_upts(j, over_int_list(start + b), k, l) = tdisf_upts_over_int_batch(j, k, l, b);
+        }
+    }
+}
+
 // calculate the normal transformed discontinuous flux at the flux points
 
 void eles::extrapolate_totalFlux()
@@ -1698,6 +1861,9 @@ void eles::calculate_divergence(void)
             cout << "ERROR: Unknown storage for opp_2 ... " << endl;
         }
 
+        if (run_input.split_form)
+            calc_split_form_divergence();
+
 #endif
 
 
@@ -1732,6 +1898,67 @@ void eles::calculate_divergence(void)
      */
 }
 
+// add volume flux differencing of the split-form inviscid flux to the divergence
+// the pointwise inviscid flux already differentiated by opp_2 is replaced by 2*sum_j(D_ij*F#(u_i,u_j)),
+// where F# is the two-point flux along the averaged metric terms of point i and j on the same line
+
+void eles::calc_split_form_divergence(void)
+{
+    int n_1d = order + 1;
+    int i, k, l, m, a, b, stride, upt_i, upt_j;
+    hf_array<double> u_i(n_fields), u_j(n_fields), metric(n_dims), f_sharp(n_fields);
+    hf_array<double> f_upts(n_upts_per_ele, n_fields); //pointwise contravariant flux along the line direction
+
+    for (i = 0; i < n_eles; i++)
+    {
+        for (l = 0, stride = 1; l < n_dims; l++, stride *= n_1d)
+        {
+            //pointwise contravariant inviscid flux
+            for (upt_i = 0; upt_i < n_upts_per_ele; upt_i++)
+            {
+                for (k = 0; k < n_fields; k++)
+                    u_i(k) = disu_upts(0)(upt_i, i, k);
+                for (m = 0; m < n_dims; m++)
+                    metric(m) = JGinv_upts(l, m, geo_upt(upt_i, i));
+                calc_split_invf(u_i, u_i, metric, f_sharp);
+                for (k = 0; k < n_fields; k++)
+                    f_upts(upt_i, k) = f_sharp(k);
+            }
+
+            //loop over points of each line along direction l
+            for (upt_i = 0; upt_i < n_upts_per_ele; upt_i++)
+            {
+                a = (upt_i / stride) % n_1d;
+
+                for (k = 0; k < n_fields; k++)
+                {
+                    u_i(k) = disu_upts(0)(upt_i, i, k);
+                    //remove the pointwise flux derivative and add diagonal term
+                    for (b = 0; b < n_1d; b++)
+                        div_tconf_upts(0)(upt_i, i, k) -= d_1d_upts(a, b) * f_upts(upt_i + (b - a) * stride, k);
+                    div_tconf_upts(0)(upt_i, i, k) += 2.0 * d_1d_upts(a, a) * f_upts(upt_i, k);
+                }
+
+                //off-diagonal terms, F# is symmetric
+                for (b = a + 1; b < n_1d; b++)
+                {
+                    upt_j = upt_i + (b - a) * stride;
+                    for (k = 0; k < n_fields; k++)
+                        u_j(k) = disu_upts(0)(upt_j, i, k);
+                    for (m = 0; m < n_dims; m++)
+                        metric(m) = 0.5 * (JGinv_upts(l, m, geo_upt(upt_i, i)) + JGinv_upts(l, m, geo_upt(upt_j, i)));
+                    calc_split_invf(u_i, u_j, metric, f_sharp);
+                    for (k = 0; k < n_fields; k++)
+                    {
+                        div_tconf_upts(0)(upt_i, i, k) += 2.0 * d_1d_upts(a, b) * f_sharp(k);
+                        div_tconf_upts(0)(upt_j, i, k) += 2.0 * d_1d_upts(b, a) * f_sharp(k);
+                    }
+                }
+            }
+        }
+    }
+}
+
 
 // calculate divergence of the transformed continuous flux at the solution points
 
@@ -1962,7 +2189,7 @@ void eles::correct_gradient(void)
             //for solution points
             for (int j = 0; j < n_upts_per_ele; j++)
             {
-                inv_detjac = 1.0 / detjac_upts(j, i);
+                inv_detjac = 1.0 / detjac_upts(geo_upt(j, i));
 
                 //copy transformed gradients from array
                 for (int k = 0; k < n_fields; k++)
@@ -1970,12 +2197,12 @@ void eles::correct_gradient(void)
                         temp_tcgradient(d, k) = grad_disu_upts(j, i, k, d);
 
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, n_dims, n_fields, n_dims, inv_detjac, JGinv_upts.get_ptr_cpu(0, 0, j, i), n_dims, temp_tcgradient.get_ptr_cpu(), n_dims, 0.0, temp_cgradient.get_ptr_cpu(), n_dims);
+                cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, n_dims, n_fields, n_dims, inv_detjac, JGinv_upts.get_ptr_cpu(0, 0, geo_upt(j, i)), n_dims, temp_tcgradient.get_ptr_cpu(), n_dims, 0.0, temp_cgradient.get_ptr_cpu(), n_dims);
 #else
                 hf_array<double> temp_JGinv(n_dims, n_dims);//transposed JGinv
                 for (int k = 0; k < n_dims; k++)
                     for (int d = 0; d < n_dims; d++)
-                        temp_JGinv(k, d) = JGinv_upts(d, k, j, i);
+                        temp_JGinv(k, d) = JGinv_upts(d, k, geo_upt(j, i));
                 dgemm(n_dims, n_fields, n_dims, inv_detjac, 0.0, temp_JGinv.get_ptr_cpu(), temp_tcgradient.get_ptr_cpu(), temp_cgradient.get_ptr_cpu());
 #endif
                 //copy physical gradient back to array
@@ -1987,7 +2214,7 @@ void eles::correct_gradient(void)
             //for flux points
             for (int j = 0; j < n_fpts_per_ele; j++)
             {
-                inv_detjac = 1.0 / detjac_fpts(j, i);
+                inv_detjac = 1.0 / detjac_fpts(geo_fpt(j, i));
 
                 //copy transformed gradients from array
                 for (int k = 0; k < n_fields; k++)
@@ -1995,12 +2222,12 @@ void eles::correct_gradient(void)
                         temp_tcgradient(d, k) = grad_disu_fpts(j, i, k, d);
 
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, n_dims, n_fields, n_dims, inv_detjac, JGinv_fpts.get_ptr_cpu(0, 0, j, i), n_dims, temp_tcgradient.get_ptr_cpu(), n_dims, 0.0, temp_cgradient.get_ptr_cpu(), n_dims);
+                cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, n_dims, n_fields, n_dims, inv_detjac, JGinv_fpts.get_ptr_cpu(0, 0, geo_fpt(j, i)), n_dims, temp_tcgradient.get_ptr_cpu(), n_dims, 0.0, temp_cgradient.get_ptr_cpu(), n_dims);
 #else
                 hf_array<double> temp_JGinv(n_dims, n_dims);//transposed JGinv
                 for (int k = 0; k < n_dims; k++)
                     for (int d = 0; d < n_dims; d++)
-                        temp_JGinv(k, d) = JGinv_fpts(d, k, j, i);
+                        temp_JGinv(k, d) = JGinv_fpts(d, k, geo_fpt(j, i));
                 dgemm(n_dims, n_fields, n_dims, inv_detjac, 0.0, temp_JGinv.get_ptr_cpu(), temp_tcgradient.get_ptr_cpu(), temp_cgradient.get_ptr_cpu());
 #endif
                 //copy physical gradient back to array
@@ -2299,7 +2526,7 @@ void eles::evaluate_viscFlux(void)
             // Calculate viscous flux
             for(j=0; j<n_upts_per_ele; j++)
             {
-                detjac = detjac_upts(j,i);
+                detjac = detjac_upts(geo_upt(j, i));
 
                 // solution in static-physical domain
                 for(k=0; k<n_fields; k++)
@@ -2341,7 +2568,7 @@ void eles::evaluate_viscFlux(void)
 
                     // Transform SGS flux back to computational domain F=|J|J^-1*f
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, n_fields, n_dims, n_dims, 1.0, temp_sgsf.get_ptr_cpu(), n_fields, JGinv_upts.get_ptr_cpu(0, 0, j, i), n_dims, 0.0, temp_tdisf_upts.get_ptr_cpu(), n_fields);
+                    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, n_fields, n_dims, n_dims, 1.0, temp_sgsf.get_ptr_cpu(), n_fields, JGinv_upts.get_ptr_cpu(0, 0, geo_upt(j, i)), n_dims, 0.0, temp_tdisf_upts.get_ptr_cpu(), n_fields);
                     for (k = 0; k < n_fields; k++)
                         for (l = 0; l < n_dims; l++)
                             sgsf_upts(j, i, k, l) = temp_tdisf_upts(k, l);
@@ -2353,7 +2580,7 @@ void eles::evaluate_viscFlux(void)
                             sgsf_upts(j,i,k,l) = 0.0;
                             for(m=0; m<n_dims; m++)
                             {
-                                sgsf_upts(j,i,k,l)+=JGinv_upts(l,m,j,i)*temp_sgsf(k,m);
+                                sgsf_upts(j,i,k,l)+=JGinv_upts(l, m, geo_upt(j, i))*temp_sgsf(k,m);
                             }
                         }
                     }
@@ -2362,7 +2589,7 @@ void eles::evaluate_viscFlux(void)
 
 // Transform viscous flux to reference domain, F_tot+=det(J)J^-1*f
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, n_fields, n_dims, n_dims, 1.0, temp_f.get_ptr_cpu(), n_fields, JGinv_upts.get_ptr_cpu(0, 0, j, i), n_dims, 0.0, temp_tdisf_upts.get_ptr_cpu(), n_fields);
+                cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, n_fields, n_dims, n_dims, 1.0, temp_f.get_ptr_cpu(), n_fields, JGinv_upts.get_ptr_cpu(0, 0, geo_upt(j, i)), n_dims, 0.0, temp_tdisf_upts.get_ptr_cpu(), n_fields);
                 for (k = 0; k < n_fields; k++)
                     for (l = 0; l < n_dims; l++)
                         tdisf_upts(j, i, k, l) += temp_tdisf_upts(k, l);
@@ -2373,7 +2600,7 @@ void eles::evaluate_viscFlux(void)
                     {
                         for (m = 0; m < n_dims; m++)
                         {
-                            tdisf_upts(j, i, k, l) += JGinv_upts(l, m, j, i) * temp_f(k, m);
+                            tdisf_upts(j, i, k, l) += JGinv_upts(l, m, geo_upt(j, i)) * temp_f(k, m);
                         }
                     }
                 }
@@ -2871,7 +3098,7 @@ void eles::extrapolate_sgsFlux(void)
             //at flux points
             for (int j = 0; j < n_fpts_per_ele; j++)
             {
-                inv_detjac = 1.0 / detjac_fpts(j, i);
+                inv_detjac = 1.0 / detjac_fpts(geo_fpt(j, i));
                 //copy data from ref domain
                 for (int k = 0; k < n_fields; k++)
                     for (int d = 0; d < n_dims; d++)
@@ -2879,9 +3106,9 @@ void eles::extrapolate_sgsFlux(void)
 
 //f=|J|^-1*JF
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_dims, n_fields, n_dims, inv_detjac, Jacobian_fpts.get_ptr_cpu(0,0,j,i), n_dims, temp_tsgsf.get_ptr_cpu(), n_dims, 0.0, temp_psgsf.get_ptr_cpu(), n_dims);
+                        cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_dims, n_fields, n_dims, inv_detjac, Jacobian_fpts.get_ptr_cpu(0,0,geo_fpt(j,i)), n_dims, temp_tsgsf.get_ptr_cpu(), n_dims, 0.0, temp_psgsf.get_ptr_cpu(), n_dims);
 #else
-                        dgemm(n_dims, n_fields, n_dims, inv_detjac, 0.0, Jacobian_fpts.get_ptr_cpu(0,0,j,i), temp_tsgsf.get_ptr_cpu(), temp_psgsf.get_ptr_cpu());
+                        dgemm(n_dims, n_fields, n_dims, inv_detjac, 0.0, Jacobian_fpts.get_ptr_cpu(0,0,geo_fpt(j,i)), temp_tsgsf.get_ptr_cpu(), temp_psgsf.get_ptr_cpu());
 #endif
                         //copy physical sgs flux back to array
                         for (int k = 0; k < n_fields; k++)
@@ -2915,48 +3142,83 @@ void eles::extrapolate_sgsFlux(void)
 
 // sense shock and filter (for concentration method) - only on GPUs
 
-void eles::shock_capture(void)
+void eles::shock_capture(bool in_detect)
 {
     if (n_eles!=0)
     {
-        //shock detection
-        if(run_input.shock_det==0)//persson
-            shock_det_persson();
-       else
-            FatalError("Shock detector not implemented.");
+        int i, j, k, b, n_b;
+
+        //shock detection, compact the list of flagged elements
+        if (in_detect)
+        {
+            if(run_input.shock_det==0)//persson
+                shock_det_persson();
+            else
+                FatalError("Shock detector not implemented.");
+
+            n_shock_eles = 0;
+            for (i = 0; i < n_eles; i++)
+                if (sensor(i) >= run_input.s0)
+                    shock_list(n_shock_eles++) = i;
+        }
 
         //shock capturing
         if (run_input.shock_cap == 1) //exponential filter
         {
-            hf_array<double> temp_sol(n_upts_per_ele, n_fields);
-            hf_array<double> filt_sol(n_upts_per_ele, n_fields);
-            filt_sol.initialize_to_zero();
-            int i, j, k;
-            for (i = 0; i < n_eles; i++)
+            for (int start = 0; start < n_shock_eles; start += disu_shock_batch.get_dim(2))
             {
-                if (sensor(i) >= run_input.s0)
-                {
-                    //copy solution to filt_sol
-                    for (j = 0; j < n_upts_per_ele; j++)
-                        for (k = 0; k < n_fields; k++)
-                            temp_sol(j, k) = disu_upts(0)(j, i, k);
+                n_b = min(disu_shock_batch.get_dim(2), n_shock_eles - start);
+
+                //gather solution of flagged elements
+                for (b = 0; b < n_b; b++)
+                    for (k = 0; k < n_fields; k++)
+                        for (j = 0; j < n_upts_per_ele; j++)
+                            disu_shock_batch(j, k, b) = disu_upts(0)(j, shock_list(start + b), k);
 
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-                    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_upts_per_ele, n_fields, n_upts_per_ele, 1.0, exp_filter.get_ptr_cpu(), n_upts_per_ele, temp_sol.get_ptr_cpu(), n_upts_per_ele, 0.0, filt_sol.get_ptr_cpu(), n_upts_per_ele);
+                cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_upts_per_ele, n_fields * n_b, n_upts_per_ele, 1.0, exp_filter.get_ptr_cpu(), n_upts_per_ele, disu_shock_batch.get_ptr_cpu(), n_upts_per_ele, 0.0, filt_disu_shock_batch.get_ptr_cpu(), n_upts_per_ele);
 #else
-                    dgemm(n_upts_per_ele, n_fields, n_upts_per_ele, 1.0, 0.0, exp_filter.get_ptr_cpu(), temp_sol.get_ptr_cpu(), filt_sol.get_ptr_cpu());
+                dgemm(n_upts_per_ele, n_fields * n_b, n_upts_per_ele, 1.0, 0.0, exp_filter.get_ptr_cpu(), disu_shock_batch.get_ptr_cpu(), filt_disu_shock_batch.get_ptr_cpu());
 #endif
-                    //copy filted solution back to disu_upts
-                    for (j = 0; j < n_upts_per_ele; j++)
-                        for (k = 0; k < n_fields; k++)
-                            disu_upts(0)(j, i, k) = filt_sol(j, k);
-                }
+                //scatter filtered solution back to disu_upts
+                for (b = 0; b < n_b; b++)
+                    for (k = 0; k < n_fields; k++)
+                        for (j = 0; j < n_upts_per_ele; j++)
+                            disu_upts(0)(j, shock_list(start + b), k) = filt_disu_shock_batch(j, k, b);
             }
         }
         else
             FatalError("Shock capturing method not implemented yet");
     }
 }
+
+// convert sensor field to squared modal coefficients for all elements with one dgemm
+
+void eles::calc_modal_energy_sensor(void)
+{
+    int field;
+
+    if (run_input.shock_det_field == 0) //density
+        field = 0;
+    else if (run_input.shock_det_field == 1) //total energy
+        field = n_dims + 1;
+    else
+        FatalError("Unsupported shock capturing field.");
+
+#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, n_upts_per_ele, n_eles, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, 0, field), n_upts_per_ele, 0.0, modal_energy_sensor.get_ptr_cpu(), n_upts_per_ele);
+#else
+    dgemm(n_upts_per_ele, n_eles, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, 0, field), modal_energy_sensor.get_ptr_cpu());
+#endif
+
+    //perform inplace \hat{u}^2
+#ifdef _MKL_BLAS
+    vdSqr(n_upts_per_ele * n_eles, modal_energy_sensor.get_ptr_cpu(), modal_energy_sensor.get_ptr_cpu());
+#else
+    transform(modal_energy_sensor.get_ptr_cpu(), modal_energy_sensor.get_ptr_cpu() + n_upts_per_ele * n_eles, modal_energy_sensor.get_ptr_cpu(), [](double x) { return x * x; });
+#endif
+}
+
 // get the type of element
 
 int eles::get_ele_type(void)
@@ -3010,6 +3272,13 @@ int eles::get_n_upts_per_ele(void)
     return n_upts_per_ele;
 }
 
+// get number of flux points per element
+
+int eles::get_n_fpts_per_ele(void)
+{
+    return n_fpts_per_ele;
+}
+
 // get number of shape points per element
 
 int eles::get_n_spts_per_ele(int in_ele)
@@ -3068,6 +3337,11 @@ void eles::set_ele2global_ele(int in_ele, int in_global_ele)
     ele2global_ele(in_ele) = in_global_ele;
 }
 
+int eles::get_ele2global_ele(int in_ele)
+{
+    return ele2global_ele(in_ele);
+}
+
 
 // set opp_0 (transformed discontinuous solution at solution points to transformed discontinuous solution at flux points)
 
@@ -3622,14 +3896,20 @@ void eles::set_opp_p(void)
 
 // set opp_probe (solution at solution points to solution at probe points)
 
-void eles::set_opp_probe(hf_array<double>& in_loc)
+void eles::set_opp_probe(vector<int>& in_eles, hf_array<double>& in_loc)
 {
-    int i;
-    for(i=0; i<n_upts_per_ele; i++)
+    int n_probes=in_eles.size();
+    hf_array<double> loc(n_dims);
+
+    probe_eles=in_eles;
+    opp_probe.setup(n_upts_per_ele,n_probes);
+    for(int j=0; j<n_probes; j++)
     {
-        opp_probe(i)=eval_nodal_basis(i,in_loc);
+        for(int k=0; k<n_dims; k++)
+            loc(k)=in_loc(k,j);
+        for(int i=0; i<n_upts_per_ele; i++)
+            opp_probe(i,j)=eval_nodal_basis(i,loc);
     }
-
 }
 
 void eles::set_opp_inters_cubpts(void)
@@ -3732,24 +4012,65 @@ void eles::calc_pos_ppts(int in_ele, hf_array<double>& out_pos_ppts)
         }
     }
 }
-// calculate solution at the probe points
-void eles::calc_disu_probepoints(int in_ele, hf_array<double>& out_disu_probepoints)
+// copy in_src into the staging buffer out_dest, sized at the first snapshot and reused afterwards
+static void copy_staging(hf_array<double>& out_dest, hf_array<double>& in_src)
+{
+    if (out_dest.get_dim(0)!=in_src.get_dim(0) || out_dest.get_dim(1)!=in_src.get_dim(1) ||
+        out_dest.get_dim(2)!=in_src.get_dim(2) || out_dest.get_dim(3)!=in_src.get_dim(3))
+        out_dest.setup(in_src.get_dim(0),in_src.get_dim(1),in_src.get_dim(2),in_src.get_dim(3));
+    size_t n=(size_t)in_src.get_dim(0)*in_src.get_dim(1)*in_src.get_dim(2)*in_src.get_dim(3);
+    copy(in_src.get_ptr_cpu(),in_src.get_ptr_cpu()+n,out_dest.get_ptr_cpu());
+}
+
+// copy the fields read by the output writers, the solver may keep advancing the live arrays afterwards
+void eles::snapshot_output(bool in_plot)
 {
     if (n_eles!=0)
     {
-        hf_array<double> disu_upts_probe(n_upts_per_ele,n_fields);
+        copy_staging(disu_upts_out,disu_upts(0));
 
-        for(int i=0; i<n_fields; i++)
-            for(int j=0; j<n_upts_per_ele; j++)
-                    disu_upts_probe(j,i)=disu_upts(0)(j,in_ele,i);
+        if (in_plot)
+        {
+            if (run_input.n_diagnostic_fields)
+            {
+                if (viscous)
+                    copy_staging(grad_disu_upts_out,grad_disu_upts);
+                if (run_input.shock_cap || run_input.over_int == 2)
+                    copy_staging(sensor_out,sensor);
+            }
+            if (n_average_fields)
+                copy_staging(disu_average_upts_out,disu_average_upts);
+        }
 
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
+        out_snap=1;
+    }
+}
 
-        cblas_dgemm(CblasColMajor,CblasNoTrans,CblasNoTrans,1,n_fields,n_upts_per_ele,1.0,opp_probe.get_ptr_cpu(),1,disu_upts_probe.get_ptr_cpu(),n_upts_per_ele,0.0,out_disu_probepoints.get_ptr_cpu(),1);
-#else
-        dgemm(1,n_fields,n_upts_per_ele,1.0,0.0,opp_probe.get_ptr_cpu(),disu_upts_probe.get_ptr_cpu(),out_disu_probepoints.get_ptr_cpu());
-#endif
+// the writers are done with the snapshot, every reader gets the live solution again
+void eles::release_output(void)
+{
+    out_snap=0;
+}
 
+// calculate solution at the probe points, sampled by the solver from the live solution
+// the weights are fixed, so all probes of this type are sampled in one pass over the gathered element solutions
+void eles::calc_disu_probepoints(hf_array<double>& out_disu_probepoints)
+{
+    if (n_eles!=0)
+    {
+        int n_probes=probe_eles.size();
+        hf_array<double>& disu_src = disu_upts(0);
+
+        for(int i=0; i<n_fields; i++)
+            for(int j=0; j<n_probes; j++)
+            {
+                double *w=opp_probe.get_ptr_cpu(0,j);
+                double *u=disu_src.get_ptr_cpu(0,probe_eles[j],i);
+                double sum=0.;
+                for(int k=0; k<n_upts_per_ele; k++)
+                    sum+=w[k]*u[k];
+                out_disu_probepoints(j,i)=sum;
+            }
     }
 }
 
@@ -3762,10 +4083,11 @@ void eles::calc_disu_ppts(int in_ele, hf_array<double>& out_disu_ppts)
         int i,j,k;
 
         hf_array<double> disu_upts_plot(n_upts_per_ele,n_fields);
+        hf_array<double>& disu_src = out_snap ? disu_upts_out : disu_upts(0);
 
         for(i=0; i<n_fields; i++)
             for(j=0; j<n_upts_per_ele; j++)
-                    disu_upts_plot(j,i)=disu_upts(0)(j,in_ele,i);
+                    disu_upts_plot(j,i)=disu_src(j,in_ele,i);
 
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
 
@@ -3786,6 +4108,7 @@ void eles::calc_grad_disu_ppts(int in_ele, hf_array<double>& out_grad_disu_ppts)
         int i,j,k,l;
 
         hf_array<double> grad_disu_upts_temp(n_upts_per_ele,n_fields,n_dims);
+        hf_array<double>& grad_disu_src = out_snap ? grad_disu_upts_out : grad_disu_upts;
 
         for(i=0; i<n_fields; i++)
         {
@@ -3793,7 +4116,7 @@ void eles::calc_grad_disu_ppts(int in_ele, hf_array<double>& out_grad_disu_ppts)
             {
                 for(k=0; k<n_dims; k++)
                 {
-                    grad_disu_upts_temp(j,i,k)=grad_disu_upts(j,in_ele,i,k);
+                    grad_disu_upts_temp(j,i,k)=grad_disu_src(j,in_ele,i,k);
                 }
             }
         }
@@ -3825,12 +4148,13 @@ void eles::calc_time_average_ppts(int in_ele, hf_array<double>& out_disu_average
         int i,j,k;
 
         hf_array<double> disu_average_upts_plot(n_upts_per_ele,n_average_fields);
+        hf_array<double>& disu_average_src = out_snap ? disu_average_upts_out : disu_average_upts;
 
         for(i=0; i<n_average_fields; i++)
         {
             for(j=0; j<n_upts_per_ele; j++)
             {
-                disu_average_upts_plot(j,i)=disu_average_upts(j,in_ele,i);
+                disu_average_upts_plot(j,i)=disu_average_src(j,in_ele,i);
             }
         }
 
@@ -3849,8 +4173,10 @@ void eles::calc_sensor_ppts(int in_ele, hf_array<double>& out_sensor_ppts)
 {
     if (n_eles!=0)
     {
+        hf_array<double>& sensor_src = out_snap ? sensor_out : sensor;
+
         for(int i=0; i<n_ppts_per_ele; i++)
-            out_sensor_ppts(i) = sensor(in_ele);
+            out_sensor_ppts(i) = sensor_src(in_ele);
     }
 }
 
@@ -3982,7 +4308,7 @@ void eles::calc_diagnostic_fields_ppts(int in_ele, hf_array<double>& in_disu_ppt
             // Artificial Viscosity diagnostics
             else if (run_input.diagnostic_fields(k)=="sensor")
             {
-                if (run_input.shock_cap)
+                if (run_input.shock_cap || run_input.over_int == 2)
                     diagfield_upt = in_sensor_ppts(j);
                 else
                     FatalError("Sensor unavailable");
@@ -4016,8 +4342,22 @@ void eles::set_transforms(void)
 {
     if (n_eles != 0)
     {
+        // metrics at every point of every element until the affine ones are compressed
+        geo_start_upts.setup(n_eles);
+        geo_start_fpts.setup(n_eles);
+        geo_stride.setup(n_eles);
+        for (int i = 0; i < n_eles; i++)
+        {
+            geo_start_upts(i) = i * n_upts_per_ele;
+            geo_start_fpts(i) = i * n_fpts_per_ele;
+            geo_stride(i) = 1;
+        }
+
         set_transforms_upts();
         set_transforms_fpts();
+#ifndef _GPU
+        compress_affine_transforms();
+#endif
 
         // Set metrics at interface cubpts
         if (run_input.calc_force != 0 || run_input.forcing != 0) //only calculated when need to calculate surface/body force
@@ -4032,6 +4372,107 @@ void eles::set_transforms(void)
     } // if n_eles!=0
 }
 
+// keep only the first point of the static metrics of every element over which they are constant, the metrics are
+// packed element by element and indexed through geo_upt/geo_fpt
+
+void eles::compress_affine_transforms(void)
+{
+    int i,j,k,l;
+    double tol=1e-12;
+    double scale;
+    int n_affine=0, n_geo_upts=0, n_geo_fpts=0;
+
+    hf_array<double> temp_detjac_upts, temp_detjac_fpts, temp_JGinv_upts, temp_JGinv_fpts, temp_Jacobian_fpts;
+
+    // an element is affine if detjac and JGinv are the same at every point, then so is the Jacobian
+    for(i=0; i<n_eles; i++)
+    {
+        bool affine=true;
+        scale=0.;
+        for(k=0; k<n_dims; k++)
+            for(l=0; l<n_dims; l++)
+                scale=max(scale,fabs(JGinv_upts(k,l,0,i)));
+
+        for(j=0; j<n_upts_per_ele && affine; j++)
+        {
+            if (fabs(detjac_upts(j,i)-detjac_upts(0,i))>tol*fabs(detjac_upts(0,i)))
+                affine=false;
+            for(k=0; k<n_dims; k++)
+                for(l=0; l<n_dims; l++)
+                    if (fabs(JGinv_upts(k,l,j,i)-JGinv_upts(k,l,0,i))>tol*scale)
+                        affine=false;
+        }
+
+        for(j=0; j<n_fpts_per_ele && affine; j++)
+        {
+            if (fabs(detjac_fpts(j,i)-detjac_upts(0,i))>tol*fabs(detjac_upts(0,i)))
+                affine=false;
+            for(k=0; k<n_dims; k++)
+                for(l=0; l<n_dims; l++)
+                    if (fabs(JGinv_fpts(k,l,j,i)-JGinv_upts(k,l,0,i))>tol*scale)
+                        affine=false;
+        }
+
+        geo_start_upts(i)=n_geo_upts;
+        geo_start_fpts(i)=n_geo_fpts;
+        geo_stride(i)=affine ? 0 : 1;
+        n_geo_upts+=affine ? 1 : n_upts_per_ele;
+        n_geo_fpts+=affine ? 1 : n_fpts_per_ele;
+        if (affine)
+            n_affine++;
+    }
+
+    if (n_affine==0)
+    {
+        for(i=0; i<n_eles; i++)
+        {
+            geo_start_upts(i)=i*n_upts_per_ele;
+            geo_start_fpts(i)=i*n_fpts_per_ele;
+        }
+        return;
+    }
+
+    temp_detjac_upts.setup(n_geo_upts);
+    temp_detjac_fpts.setup(n_geo_fpts);
+    temp_JGinv_upts.setup(n_dims,n_dims,n_geo_upts);
+    temp_JGinv_fpts.setup(n_dims,n_dims,n_geo_fpts);
+    temp_Jacobian_fpts.setup(n_dims,n_dims,n_geo_fpts);
+
+    for(i=0; i<n_eles; i++)
+    {
+        int n_upts_geo=geo_stride(i) ? n_upts_per_ele : 1;
+        int n_fpts_geo=geo_stride(i) ? n_fpts_per_ele : 1;
+
+        for(j=0; j<n_upts_geo; j++)
+        {
+            temp_detjac_upts(geo_upt(j,i))=detjac_upts(j,i);
+            for(k=0; k<n_dims; k++)
+                for(l=0; l<n_dims; l++)
+                    temp_JGinv_upts(k,l,geo_upt(j,i))=JGinv_upts(k,l,j,i);
+        }
+
+        for(j=0; j<n_fpts_geo; j++)
+        {
+            temp_detjac_fpts(geo_fpt(j,i))=detjac_fpts(j,i);
+            for(k=0; k<n_dims; k++)
+                for(l=0; l<n_dims; l++)
+                {
+                    temp_JGinv_fpts(k,l,geo_fpt(j,i))=JGinv_fpts(k,l,j,i);
+                    temp_Jacobian_fpts(k,l,geo_fpt(j,i))=Jacobian_fpts(k,l,j,i);
+                }
+        }
+    }
+
+    detjac_upts=temp_detjac_upts;
+    detjac_fpts=temp_detjac_fpts;
+    JGinv_upts=temp_JGinv_upts;
+    JGinv_fpts=temp_JGinv_fpts;
+    Jacobian_fpts=temp_Jacobian_fpts;
+
+    if (rank==0)
+        cout << n_affine << " of " << n_eles << " elements of type " << ele_type << " are affine, storing one set of metrics for each" << endl;
+}
+
 void eles::set_transforms_upts(void)
 {
         int i,j,k;
@@ -4653,7 +5094,7 @@ double* eles::get_detjac_fpts_ptr(int in_inter_local_fpt, int in_ele_local_inter
 #ifdef _GPU
     return detjac_fpts.get_ptr_gpu(fpt,in_ele);
 #else
-    return detjac_fpts.get_ptr_cpu(fpt,in_ele);
+    return detjac_fpts.get_ptr_cpu(geo_fpt(fpt, in_ele));
 #endif
 }
 
@@ -4979,15 +5420,15 @@ double eles::compute_res_upts(int in_norm_type, int in_field)
         {
             if (in_norm_type == 0)
             {
-                sum = max(sum, abs(div_tconf_upts(0)(j, i, in_field)/detjac_upts(j, i)-src_upts(j,i,in_field)));
+                sum = max(sum, abs(div_tconf_upts(0)(j, i, in_field)/detjac_upts(geo_upt(j, i))-src_upts(j,i,in_field)));
             }
             if (in_norm_type == 1)
             {
-                sum += abs(div_tconf_upts(0)(j, i, in_field)/detjac_upts(j, i)-src_upts(j,i,in_field));
+                sum += abs(div_tconf_upts(0)(j, i, in_field)/detjac_upts(geo_upt(j, i))-src_upts(j,i,in_field));
             }
             else if (in_norm_type == 2)
             {
-                sum += (div_tconf_upts(0)(j, i, in_field)/detjac_upts(j,i)-src_upts(j,i,in_field))*(div_tconf_upts(0)(j, i, in_field)/detjac_upts(j, i)-src_upts(j,i,in_field));
+                sum += (div_tconf_upts(0)(j, i, in_field)/detjac_upts(geo_upt(j, i))-src_upts(j,i,in_field))*(div_tconf_upts(0)(j, i, in_field)/detjac_upts(geo_upt(j, i))-src_upts(j,i,in_field));
             }
         }
     }
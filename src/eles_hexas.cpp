@@ -39,7 +39,10 @@ using namespace std;
 
 eles_hexas::eles_hexas()
 {
-
+  ele_type=4;
+#ifdef _MEM_TRACK
+  memory_tracker().add_owner(this, sizeof(*this), "eles_hexas", ele_type);
+#endif
 }
 
 void eles_hexas::setup_ele_type_specific()
@@ -68,6 +71,17 @@ void eles_hexas::setup_ele_type_specific()
   set_loc_1d_upts();
   set_loc_upts();
   set_vandermonde1D();
+
+  //1D differentiation matrix for split-form flux
+  if (run_input.split_form)
+  {
+    if (upts_type != 1)
+      FatalError("Split form flux requires Gauss-Lobatto solution points");
+    d_1d_upts.setup(order + 1, order + 1);
+    for (int i = 0; i < order + 1; i++)
+      for (int j = 0; j < order + 1; j++)
+        d_1d_upts(i, j) = eval_d_lagrange(loc_1d_upts(i), j, loc_1d_upts);
+  }
   set_vandermonde3D();
 
   //set shock capturing arrays
@@ -89,7 +103,11 @@ void eles_hexas::setup_ele_type_specific()
 
   //de-aliasing by over-integration
   if (run_input.over_int)
+  {
     set_over_int();
+    if (run_input.over_int == 2 && !run_input.shock_cap) //persson sensor for selective over-integration
+      calc_norm_basis();
+  }
 
   n_ppts_per_ele=p_res*p_res*p_res;
   n_peles_per_ele=(p_res-1)*(p_res-1)*(p_res-1);
@@ -1006,54 +1024,29 @@ void eles_hexas::calc_norm_basis(void)
 //detect shock use persson's method
 void eles_hexas::shock_det_persson(void)
 {
-  hf_array<double> temp_modal(n_upts_per_ele); //store modal value
   int x, y, z;
+  double *temp_modal;
+
+  //step 1. convert to modal value and perform \hat{u}^2 for all elements
+  calc_modal_energy_sensor();
 
   for (int ic = 0; ic < n_eles; ic++)
   {
-    if (run_input.shock_det_field == 0) //density
-    {
-//step 1. convert to modal value
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-      cblas_dgemv(CblasColMajor, CblasNoTrans, n_upts_per_ele, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, ic, 0), 1, 0.0, temp_modal.get_ptr_cpu(), 1);
-#else
-      dgemm(n_upts_per_ele, 1, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, ic, 0), temp_modal.get_ptr_cpu());
-#endif
-    }
-    else if (run_input.shock_det_field == 1) //total energy
-    {
-//step 1. convert to modal value
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-      cblas_dgemv(CblasColMajor, CblasNoTrans, n_upts_per_ele, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, ic, n_dims+1), 1, 0.0, temp_modal.get_ptr_cpu(), 1);
-#else
-      dgemm(n_upts_per_ele, 1, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, ic, n_dims+1), temp_modal.get_ptr_cpu());
-#endif
-    }
-    else
-    {
-      FatalError("Unsupported shock capturing field.")
-    }
-
-    //step 2. perform inplace \hat{u}^2 store in temp_modal
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    vdSqr(n_upts_per_ele, temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu());
-#else
-    transform(temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu(n_upts_per_ele), temp_modal.get_ptr_cpu(), [](double x) { return x * x; });
-#endif
+    temp_modal = modal_energy_sensor.get_ptr_cpu(0, ic);
 
-    //step 3. use Parseval's theorem to calculate (u-u_n,u-u_n)
+    //step 2. use Parseval's theorem to calculate (u-u_n,u-u_n)
     sensor(ic) = 0;
     for (int j = 0; j < n_upts_per_ele; j++)
     {
       get_legendre_basis_3D_index(j, order, x, y, z);
       if (x == order || y == order || z == order)
-        sensor(ic) += temp_modal(j) * norm_basis_persson(j);
+        sensor(ic) += temp_modal[j] * norm_basis_persson(j);
     }
-    //step 4. use Parseval's theorem to calculate (u,u),  and calculate ((u-u_n,u-u_n)/(u,u))
+    //step 3. use Parseval's theorem to calculate (u,u),  and calculate ((u-u_n,u-u_n)/(u,u))
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    sensor(ic) /= cblas_ddot(n_upts_per_ele, norm_basis_persson.get_ptr_cpu(), 1, temp_modal.get_ptr_cpu(), 1);
+    sensor(ic) /= cblas_ddot(n_upts_per_ele, norm_basis_persson.get_ptr_cpu(), 1, temp_modal, 1);
 #else
-    sensor(ic) /= inner_product(norm_basis_persson.get_ptr_cpu(), norm_basis_persson.get_ptr_cpu(n_upts_per_ele), temp_modal.get_ptr_cpu(), 0.);
+    sensor(ic) /= inner_product(norm_basis_persson.get_ptr_cpu(), norm_basis_persson.get_ptr_cpu(n_upts_per_ele), temp_modal, 0.);
 #endif
   }
 }
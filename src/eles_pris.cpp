@@ -40,6 +40,10 @@ using namespace std;
 
 eles_pris::eles_pris()
 {
+  ele_type=3;
+#ifdef _MEM_TRACK
+  memory_tracker().add_owner(this, sizeof(*this), "eles_pris", ele_type);
+#endif
 }
 
 // #### methods ####
@@ -73,6 +77,9 @@ void eles_pris::setup_ele_type_specific()
   set_vandermonde_tri();
   set_vandermonde3D();
 
+  if (run_input.split_form)
+    FatalError("Split form flux only supported for quads and hexas");
+
   //set shock capturing arrays
   if(run_input.shock_cap)
   {
@@ -99,7 +106,11 @@ void eles_pris::setup_ele_type_specific()
 
   //de-aliasing by over-integration
   if (run_input.over_int)
+  {
     set_over_int();
+    if (run_input.over_int == 2 && !run_input.shock_cap) //persson sensor for selective over-integration
+      calc_norm_basis();
+  }
 
   n_fpts_per_inter.setup(5);
 
@@ -677,55 +688,30 @@ void eles_pris::calc_norm_basis(void)
 //detect shock use persson's method
 void eles_pris::shock_det_persson(void)
 {
-  hf_array<double> temp_modal(n_upts_per_ele); //store modal value
   int x, y, z;
+  double *temp_modal;
+
+  //step 1. convert to modal value and perform \hat{u}^2 for all elements
+  calc_modal_energy_sensor();
 
   for (int ic = 0; ic < n_eles; ic++)
   {
-    if (run_input.shock_det_field == 0) //density
-    {
-//step 1. convert to modal value
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-      cblas_dgemv(CblasColMajor, CblasNoTrans, n_upts_per_ele, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, ic, 0), 1, 0.0, temp_modal.get_ptr_cpu(), 1);
-#else
-      dgemm(n_upts_per_ele, 1, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, ic, 0), temp_modal.get_ptr_cpu());
-#endif
-    }
-    else if (run_input.shock_det_field == 1) //total energy
-    {
-//step 1. convert to modal value
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-      cblas_dgemv(CblasColMajor, CblasNoTrans, n_upts_per_ele, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, ic, n_dims+1), 1, 0.0, temp_modal.get_ptr_cpu(), 1);
-#else
-      dgemm(n_upts_per_ele, 1, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, ic, n_dims+1), temp_modal.get_ptr_cpu());
-#endif
-    }
-    else
-    {
-      FatalError("Unsupported shock capturing field.")
-    }
-
-    //step 2. perform inplace \hat{u}^2 store in temp_modal
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    vdSqr(n_upts_per_ele, temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu());
-#else
-    transform(temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu(n_upts_per_ele), temp_modal.get_ptr_cpu(), [](double x) { return x * x; });
-#endif
+    temp_modal = modal_energy_sensor.get_ptr_cpu(0, ic);
 
-    //step 3. use Parseval's theorem to calculate (u-u_n,u-u_n)
+    //step 2. use Parseval's theorem to calculate (u-u_n,u-u_n)
     sensor(ic) = 0;
     for (int j = 0; j < n_upts_per_ele; j++)
     {
       get_pris_basis_index(j, order, x, y, z);
       if (x + y == order || z == order)
-        sensor(ic) += temp_modal(j) * norm_basis_persson(j);
+        sensor(ic) += temp_modal[j] * norm_basis_persson(j);
     }
 
-    //step 4. use Parseval's theorem to calculate (u,u),  and calculate ((u-u_n,u-u_n)/(u,u))
+    //step 3. use Parseval's theorem to calculate (u,u),  and calculate ((u-u_n,u-u_n)/(u,u))
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    sensor(ic) /= cblas_ddot(n_upts_per_ele, norm_basis_persson.get_ptr_cpu(), 1, temp_modal.get_ptr_cpu(), 1);
+    sensor(ic) /= cblas_ddot(n_upts_per_ele, norm_basis_persson.get_ptr_cpu(), 1, temp_modal, 1);
 #else
-    sensor(ic) /= inner_product(norm_basis_persson.get_ptr_cpu(), norm_basis_persson.get_ptr_cpu(n_upts_per_ele), temp_modal.get_ptr_cpu(), 0.);
+    sensor(ic) /= inner_product(norm_basis_persson.get_ptr_cpu(), norm_basis_persson.get_ptr_cpu(n_upts_per_ele), temp_modal, 0.);
 #endif
   }
 }
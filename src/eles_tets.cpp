@@ -37,6 +37,10 @@ using namespace std;
 
 eles_tets::eles_tets()
 {
+  ele_type=2;
+#ifdef _MEM_TRACK
+  memory_tracker().add_owner(this, sizeof(*this), "eles_tets", ele_type);
+#endif
 }
 
 // #### methods ####
@@ -68,6 +72,9 @@ void eles_tets::setup_ele_type_specific()
   set_loc_upts();
   set_vandermonde();
 
+  if (run_input.split_form)
+    FatalError("Split form flux only supported for quads and hexas");
+
   //set shock capturing arrays
   if(run_input.shock_cap)
   {
@@ -749,52 +756,27 @@ void eles_tets::shock_det_persson(void)
 {
   //calculate number of order-1 element
   int n_mode_under = order * (order + 1) * (order + 2) / 6;
-  hf_array<double> temp_modal(n_upts_per_ele); //store modal value
+  double *temp_modal;
+
+  //step 1. convert to modal value and perform \hat{u}^2 for all elements
+  calc_modal_energy_sensor();
 
   for (int ic = 0; ic < n_eles; ic++)
   {
-    if (run_input.shock_det_field == 0) //density
-    {
-//step 1. convert to modal value
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-      cblas_dgemv(CblasColMajor, CblasNoTrans, n_upts_per_ele, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, ic, 0), 1, 0.0, temp_modal.get_ptr_cpu(), 1);
-#else
-      dgemm(n_upts_per_ele, 1, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, ic, 0), temp_modal.get_ptr_cpu());
-#endif
-    }
-    else if (run_input.shock_det_field == 1) //total energy
-    {
-//step 1. convert to modal value
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-      cblas_dgemv(CblasColMajor, CblasNoTrans, n_upts_per_ele, n_upts_per_ele, 1.0, inv_vandermonde.get_ptr_cpu(), n_upts_per_ele, disu_upts(0).get_ptr_cpu(0, ic, n_dims + 1), 1, 0.0, temp_modal.get_ptr_cpu(), 1);
-#else
-      dgemm(n_upts_per_ele, 1, n_upts_per_ele, 1.0, 0.0, inv_vandermonde.get_ptr_cpu(), disu_upts(0).get_ptr_cpu(0, ic, n_dims + 1), temp_modal.get_ptr_cpu());
-#endif
-    }
-    else
-    {
-      FatalError("Unsupported shock capturing field.")
-    }
-
-    //step 2. perform inplace \hat{u}^2 store in temp_modal
-#if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    vdSqr(n_upts_per_ele, temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu());
-#else
-    transform(temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu(n_upts_per_ele), temp_modal.get_ptr_cpu(), [](double x) { return x * x; });
-#endif
+    temp_modal = modal_energy_sensor.get_ptr_cpu(0, ic);
 
-    //step 3. use Parseval's theorem to calculate (u-u_n,u-u_n)
+    //step 2. use Parseval's theorem to calculate (u-u_n,u-u_n)
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    sensor(ic) = cblas_dasum(n_upts_per_ele - n_mode_under, temp_modal.get_ptr_cpu(n_mode_under), 1);
+    sensor(ic) = cblas_dasum(n_upts_per_ele - n_mode_under, temp_modal + n_mode_under, 1);
 #else
-    sensor(ic) = accumulate(temp_modal.get_ptr_cpu(n_mode_under), temp_modal.get_ptr_cpu(n_upts_per_ele), 0.);
+    sensor(ic) = accumulate(temp_modal + n_mode_under, temp_modal + n_upts_per_ele, 0.);
 #endif
 
-//step 4. use Parseval's theorem to calculate (u,u),  and calculate ((u-u_n,u-u_n)/(u,u))
+//step 3. use Parseval's theorem to calculate (u,u),  and calculate ((u-u_n,u-u_n)/(u,u))
 #if defined _ACCELERATE_BLAS || defined _MKL_BLAS || defined _STANDARD_BLAS
-    sensor(ic) /= cblas_dasum(n_upts_per_ele, temp_modal.get_ptr_cpu(), 1);
+    sensor(ic) /= cblas_dasum(n_upts_per_ele, temp_modal, 1);
 #else
-    sensor(ic) /= accumulate(temp_modal.get_ptr_cpu(), temp_modal.get_ptr_cpu(n_upts_per_ele), 0.);
+    sensor(ic) /= accumulate(temp_modal, temp_modal + n_upts_per_ele, 0.);
 #endif
   }
 }
@@ -124,6 +124,90 @@ void calc_invf_3d(hf_array<double>& in_u, hf_array<double>& out_f)
 
 }
 
+// logarithmic mean (a-b)/(ln(a)-ln(b)), Ismail & Roe's expansion near a=b
+
+static double log_mean(double a, double b)
+{
+  double xi = a / b;
+  double f = (xi - 1.0) / (xi + 1.0);
+  double u = f * f;
+  double F;
+
+  if (u < 1.e-2)
+    F = 1.0 + u / 3.0 + u * u / 5.0 + u * u * u / 7.0;
+  else
+    F = log(xi) / (2.0 * f);
+
+  return (a + b) / (2.0 * F);
+}
+
+// calculate symmetric two-point split-form inviscid flux along in_norm
+// 1: kinetic energy preserving flux of Pirozzoli
+// 2: entropy conservative and kinetic energy preserving flux of Chandrashekar
+
+void calc_split_invf(hf_array<double>& in_u_l, hf_array<double>& in_u_r, hf_array<double>& in_norm, hf_array<double>& out_f)
+{
+  int n_dims = in_norm.get_dim(0);
+
+  if (run_input.equation == 0) // Euler and NS equation
+    {
+      double rho_l = in_u_l(0), rho_r = in_u_r(0);
+      double v_l[3], v_r[3], v_avg[3];
+      double vsq_l = 0., vsq_r = 0., vn_avg = 0., vsq_avg = 0.;
+      double p_l, p_r, p_avg, rho_avg;
+
+      for (int i = 0; i < n_dims; i++)
+        {
+          v_l[i] = in_u_l(i + 1) / rho_l;
+          v_r[i] = in_u_r(i + 1) / rho_r;
+          v_avg[i] = 0.5 * (v_l[i] + v_r[i]);
+          vsq_l += v_l[i] * v_l[i];
+          vsq_r += v_r[i] * v_r[i];
+          vn_avg += v_avg[i] * in_norm(i);
+          vsq_avg += v_avg[i] * v_avg[i];
+        }
+      p_l = (run_input.gamma - 1.0) * (in_u_l(n_dims + 1) - 0.5 * rho_l * vsq_l);
+      p_r = (run_input.gamma - 1.0) * (in_u_r(n_dims + 1) - 0.5 * rho_r * vsq_r);
+      rho_avg = 0.5 * (rho_l + rho_r);
+
+      if (run_input.split_form == 1)
+        {
+          double h_avg = 0.5 * ((in_u_l(n_dims + 1) + p_l) / rho_l + (in_u_r(n_dims + 1) + p_r) / rho_r);
+
+          p_avg = 0.5 * (p_l + p_r);
+          out_f(0) = rho_avg * vn_avg;
+          out_f(n_dims + 1) = out_f(0) * h_avg;
+        }
+      else if (run_input.split_form == 2)
+        {
+          double beta_l = 0.5 * rho_l / p_l, beta_r = 0.5 * rho_r / p_r;
+          double beta_ln = log_mean(beta_l, beta_r);
+
+          p_avg = rho_avg / (beta_l + beta_r);
+          out_f(0) = log_mean(rho_l, rho_r) * vn_avg;
+          out_f(n_dims + 1) = out_f(0) * (0.5 / ((run_input.gamma - 1.0) * beta_ln) - 0.25 * (vsq_l + vsq_r) + vsq_avg) + p_avg * vn_avg;
+        }
+      else
+        {
+          FatalError("split form flux not recognized");
+        }
+
+      for (int i = 0; i < n_dims; i++)
+        out_f(i + 1) = out_f(0) * v_avg[i] + p_avg * in_norm(i);
+    }
+  else if (run_input.equation == 1) // Advection-diffusion equation
+    {
+      double an = 0.;
+      for (int i = 0; i < n_dims; i++)
+        an += run_input.wave_speed(i) * in_norm(i);
+      out_f(0) = an * 0.5 * (in_u_l(0) + in_u_r(0));
+    }
+  else
+    {
+      FatalError("equation not recognized");
+    }
+}
+
 // calculate viscous flux in 2D
 
 void calc_visf_2d(hf_array<double>& in_u, hf_array<double>& in_grad_u, hf_array<double>& out_f)
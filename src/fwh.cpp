@@ -0,0 +1,280 @@
+/*!
+ * \file fwh.cpp
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <sys/stat.h>
+
+#include "../include/global.h"
+#include "../include/fwh.h"
+
+using namespace std;
+
+fwh::fwh()
+{
+    active = 0;
+    n_out = 0;
+}
+
+fwh::~fwh()
+{
+    //dtor
+}
+
+#ifdef _MPI
+void fwh::setup(struct solution *in_sol, MPI_Comm in_comm)
+#else
+void fwh::setup(struct solution *in_sol)
+#endif
+{
+    FlowSol = in_sol;
+#ifdef _MPI
+    comm = in_comm;
+#endif
+    active = 1;
+    n_dims = FlowSol->n_dims;
+    n_surf = run_probe.fwh_probe.size();
+
+    probe2fwh.assign(run_probe.n_probe, -1);
+    for (int i = 0; i < n_surf; i++)
+        probe2fwh[run_probe.fwh_probe[i]] = i;
+    disu_surf.setup(max(n_surf, 1), n_dims + 2);
+
+    //read observer positions
+    ifstream obs_f(run_probe.fwh_observer_file.c_str());
+    if (!obs_f)
+        FatalError("Unable to open FW-H observer file");
+    vector<double> temp_pos;
+    double x;
+    while (obs_f >> x)
+        temp_pos.push_back(x);
+    obs_f.close();
+    n_obs = temp_pos.size() / n_dims;
+    if (n_obs == 0 || (int)temp_pos.size() != n_obs * n_dims)
+        FatalError("FW-H observer file must list n_dims coordinates per observer");
+    pos_obs.setup(n_dims, n_obs);
+    copy(temp_pos.begin(), temp_pos.end(), pos_obs.get_ptr_cpu());
+
+    //ambient state is the initial condition
+    rho0 = run_input.rho_c_ic;
+    p0 = run_input.p_c_ic;
+    c0 = sqrt(run_input.gamma * p0 / rho0);
+    dt_obs = run_input.dt * run_probe.probe_freq;
+
+    //surface to observer geometry
+    r_inv.setup(max(n_surf, 1), n_obs);
+    r_hat.setup(n_dims, max(n_surf, 1), n_obs);
+    t_delay.setup(max(n_surf, 1), n_obs);
+    r_min = 1e300;
+    for (int j = 0; j < n_obs; j++)
+        for (int i = 0; i < n_surf; i++)
+        {
+            double r = 0.;
+            for (int k = 0; k < n_dims; k++)
+            {
+                r_hat(k, i, j) = pos_obs(k, j) - run_probe.fwh_pos(k, i);
+                r += r_hat(k, i, j) * r_hat(k, i, j);
+            }
+            r = sqrt(r);
+            if (r == 0.)
+                FatalError("FW-H observer lies on the integration surface");
+            for (int k = 0; k < n_dims; k++)
+                r_hat(k, i, j) /= r;
+            r_inv(i, j) = 1. / r;
+            t_delay(i, j) = r / c0;
+            r_min = min(r_min, r);
+        }
+#ifdef _MPI
+    MPI_Allreduce(MPI_IN_PLACE, &r_min, 1, MPI_DOUBLE, MPI_MIN, comm);
+#endif
+
+    un_prev.setup(max(n_surf, 1));
+    l_prev.setup(n_dims, max(n_surf, 1));
+    n_sample = 0;
+    bin0 = 0;
+    p_obs.assign(n_obs, vector<double>());
+
+    //rank 0 writes the header of a new observer file
+    fname = run_probe.fwh_surface + "_fwh.dat";
+    if (FlowSol->rank == 0)
+    {
+        struct stat st = {0};
+        if (stat(fname.c_str(), &st) == -1)
+        {
+            double l_scale = (run_input.viscous && run_input.equation == 0) ? run_input.L_ref : 1.;
+            ofstream wt_fwh(fname.c_str());
+            if (!wt_fwh.is_open())
+                FatalError("Cannont open FW-H observer file for writing.");
+            wt_fwh.unsetf(ios::floatfield);
+            wt_fwh << "NOTE: ALL OUTPUTS ARE DIMENSIONAL IN SI UNITS" << endl;
+            wt_fwh << "Observer positions" << endl;
+            for (int j = 0; j < n_obs; j++)
+            {
+                for (int k = 0; k < n_dims; k++)
+                    wt_fwh << setw(20) << setprecision(10) << pos_obs(k, j) * l_scale;
+                wt_fwh << endl;
+            }
+            wt_fwh << setw(20) << "time";
+            for (int j = 0; j < n_obs; j++)
+                wt_fwh << setw(20) << "p'_" + to_string(j);
+            wt_fwh << endl;
+            wt_fwh.close();
+        }
+        cout << "FW-H: " << n_obs << " observers, c0=" << c0 << endl;
+    }
+}
+
+// Farassat 1A for a stationary permeable surface: with U_n=rho*u_n/rho0 and L_i=p'*n_i+rho*u_i*u_n,
+// 4*pi*p'(x,t)=integral of [rho0*dU_n/dt/r + dL_r/dt/(c0*r) + L_r/r^2] at tau=t-r/c0.
+// Time derivatives are taken between consecutive samples and the result is spread linearly over
+// the two observer samples bracketing the arrival time.
+
+void fwh::accumulate(double in_time)
+{
+    hf_array<double> un(max(n_surf, 1)), l(n_dims, max(n_surf, 1));
+
+    for (int i = 0; i < n_surf; i++)
+    {
+        double rho = disu_surf(i, 0);
+        double v_sq = 0., u_n = 0.;
+        for (int k = 0; k < n_dims; k++)
+        {
+            v_sq += disu_surf(i, k + 1) * disu_surf(i, k + 1);
+            u_n += disu_surf(i, k + 1) * run_probe.fwh_normal(k, i);
+        }
+        v_sq /= rho * rho;
+        u_n /= rho;
+        double p_prime = (run_input.gamma - 1.0) * (disu_surf(i, n_dims + 1) - 0.5 * rho * v_sq) - p0;
+        un(i) = rho * u_n / rho0;
+        for (int k = 0; k < n_dims; k++)
+            l(k, i) = p_prime * run_probe.fwh_normal(k, i) + disu_surf(i, k + 1) * u_n;
+    }
+
+    if (n_sample == 0)
+    {
+        t0 = in_time;
+        bin0 = (long)floor(r_min / c0 / dt_obs);
+    }
+    else
+    {
+        double dt_src = in_time - t_last;
+        double t_mid = 0.5 * (in_time + t_last);
+        double scale = dt_src / dt_obs / (4. * pi);
+        for (int j = 0; j < n_obs; j++)
+        {
+            vector<double> &sig = p_obs[j];
+            for (int i = 0; i < n_surf; i++)
+            {
+                double l_r = 0., dl_r = 0.;
+                for (int k = 0; k < n_dims; k++)
+                {
+                    l_r += 0.5 * (l(k, i) + l_prev(k, i)) * r_hat(k, i, j);
+                    dl_r += (l(k, i) - l_prev(k, i)) * r_hat(k, i, j);
+                }
+                dl_r /= dt_src;
+                double dun = (un(i) - un_prev(i)) / dt_src;
+                double dp = (rho0 * dun + dl_r / c0 + l_r * r_inv(i, j)) * r_inv(i, j) * run_probe.fwh_area[i] * scale;
+
+                double pos = (t_mid + t_delay(i, j) - t0) / dt_obs;
+                long b = (long)floor(pos);
+                double w = pos - b;
+                size_t idx = b - bin0;
+                if (sig.size() < idx + 2)
+                    sig.resize(idx + 2, 0.);
+                sig[idx] += (1. - w) * dp;
+                sig[idx + 1] += w * dp;
+            }
+        }
+    }
+
+    un_prev = un;
+    l_prev = l;
+    t_last = in_time;
+    n_sample++;
+}
+
+// samples earlier than the first arrival of the next surface sample are final
+
+void fwh::collect(void)
+{
+    n_out = 0;
+    if (n_sample < 2)
+        return;
+
+    long n_complete = (long)floor((t_last + r_min / c0 - t0) / dt_obs) - bin0;
+    if (n_complete <= 0)
+        return;
+
+    p_out.setup(n_complete, n_obs);
+    for (int j = 0; j < n_obs; j++)
+        for (long b = 0; b < n_complete; b++)
+            p_out(b, j) = b < (long)p_obs[j].size() ? p_obs[j][b] : 0.;
+
+    for (int j = 0; j < n_obs; j++)
+    {
+        if ((long)p_obs[j].size() > n_complete)
+            p_obs[j].erase(p_obs[j].begin(), p_obs[j].begin() + n_complete);
+        else
+            p_obs[j].clear();
+    }
+    n_out = n_complete;
+    bin_out = bin0;
+    bin0 += n_complete;
+}
+
+void fwh::write(void)
+{
+    if (n_out == 0)
+        return;
+
+#ifdef _MPI
+    if (FlowSol->rank == 0)
+        MPI_Reduce(MPI_IN_PLACE, p_out.get_ptr_cpu(), n_out * n_obs, MPI_DOUBLE, MPI_SUM, 0, comm);
+    else
+        MPI_Reduce(p_out.get_ptr_cpu(), NULL, n_out * n_obs, MPI_DOUBLE, MPI_SUM, 0, comm);
+#endif
+
+    if (FlowSol->rank == 0)
+    {
+        double t_scale = 1., p_scale = 1.;
+        if (run_input.viscous && run_input.equation == 0)
+        {
+            t_scale = run_input.time_ref;
+            p_scale = run_input.p_ref;
+        }
+        ofstream wt_fwh(fname.c_str(), ios_base::out | ios_base::app);
+        if (!wt_fwh.is_open())
+            FatalError("Cannont open FW-H observer file for writing.");
+        wt_fwh.setf(ios::scientific);
+        for (long b = 0; b < n_out; b++)
+        {
+            wt_fwh << setw(20) << setprecision(10) << (t0 + (bin_out + b) * dt_obs) * t_scale;
+            for (int j = 0; j < n_obs; j++)
+                wt_fwh << setw(20) << setprecision(10) << p_out(b, j) * p_scale;
+            wt_fwh << endl;
+        }
+        wt_fwh.close();
+    }
+    n_out = 0;
+}
@@ -180,6 +180,22 @@ void GeoPreprocess(struct solution *FlowSol, mesh &mesh_data)
   if (FlowSol->rank == 0)
     cout << "done initializing elements" << endl;
 
+  //count the solution points of all ranks, the problem size throughput is measured against
+  int n_fields = 0;
+  FlowSol->num_upts_global = 0;
+  for (int i = 0; i < FlowSol->n_ele_types; i++)
+    if (FlowSol->mesh_eles(i)->get_n_eles() != 0)
+    {
+      FlowSol->num_upts_global += (long long)FlowSol->mesh_eles(i)->get_n_eles() * FlowSol->mesh_eles(i)->get_n_upts_per_ele();
+      n_fields = FlowSol->mesh_eles(i)->get_n_fields();
+    }
+#ifdef _MPI
+  MPI_Allreduce(MPI_IN_PLACE, &FlowSol->num_upts_global, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &n_fields, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+#endif
+  if (FlowSol->rank == 0)
+    cout << "solution points: " << FlowSol->num_upts_global << ", degrees of freedom: " << FlowSol->num_upts_global * n_fields << endl;
+
   // Set shape for each cell
   hf_array<int> local_c(mesh_data.num_cells); //index of overall element to index in one type of element
 
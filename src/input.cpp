@@ -33,6 +33,9 @@
 
 #include "../include/global.h"
 #include "../include/param_reader.h"
+#ifdef _HDF5
+#include "hdf5.h"
+#endif
 
 using namespace std;
 
@@ -75,7 +78,24 @@ void input::read_input_file(string fileName, int rank)
     opts.getScalarValue("equation", equation);//0: navier-stokes/euler; 1: advection/diffusion
     opts.getScalarValue("order", order);
     opts.getScalarValue("viscous", viscous);
-    opts.getScalarValue("mesh_file", mesh_file);
+    opts.getScalarValue("mesh_format", mesh_format, 0); //0: read mesh_file (gambit .neu or gmsh .msh); 1: generate a box mesh
+    if (mesh_format == MESH_FILE)
+    {
+        opts.getScalarValue("mesh_file", mesh_file);
+    }
+    else if (mesh_format == MESH_BOX)
+    {
+        opts.getVectorValue("box_n", box_n); //number of cubes in each direction, 2 or 3 entries
+        opts.getScalarValue("box_ele_type", box_ele_type, string(box_n.get_dim(0) == 2 ? "quad" : "hex")); //hex, prism, tet or mixed (hex and prism halves in x); quad, tri or mixed in 2D
+        opts.getVectorValueOptional("box_min", box_min); //lower corner, default 0
+        opts.getVectorValueOptional("box_max", box_max); //upper corner, default 1
+        opts.getVectorValueOptional("box_periodic", box_periodic); //1: opposite sides form the cyclic boundary "periodic", 0: sides xmin, xmax, ... ; default 1
+        opts.getScalarValue("box_perturb", box_perturb, 0.); //random displacement of the interior vertices as a fraction of the cell size
+        opts.getScalarValue("box_seed", box_seed, 0); //seed of the random displacement
+        mesh_file = "box";
+    }
+    else
+        FatalError("mesh_format not recognized");
     opts.getScalarValue("ic_form", ic_form, 1);
     opts.getScalarValue("test_case", test_case, 0); //0: no testcase; 1: isentropic vortex; 5: couette flow
     opts.getScalarValue("n_steps", n_steps);
@@ -84,7 +104,14 @@ void input::read_input_file(string fileName, int rank)
     {
         opts.getScalarValue("restart_iter", restart_iter);
         if (restart_flag == 1)//ascii files need to know number of files
+        {
             opts.getScalarValue("n_restart_files", n_restart_files);
+            opts.getScalarValue("convert_restart", convert_restart, 0); //1: write the ascii restart files as a hdf5 restart file and stop
+#ifndef _HDF5
+            if (convert_restart)
+                FatalError("To convert restart files to HDF5, HiFiLES have to be compiled with HDF5");
+#endif
+        }
         else if (restart_flag == 2) //HDF5 restart file
         {
 #ifndef _HDF5
@@ -98,7 +125,19 @@ void input::read_input_file(string fileName, int rank)
     opts.getScalarValue("plot_freq", plot_freq, INT32_MAX);
     opts.getScalarValue("data_file_name", data_file_name, string("Mesh"));
     opts.getScalarValue("restart_dump_freq", restart_dump_freq, INT32_MAX);
+    opts.getScalarValue("walltime", walltime, 0.); //wall clock budget in seconds, a restart file is written and the run stops before it runs out. 0: unlimited
+    opts.getScalarValue("walltime_margin", walltime_margin, 0.); //seconds kept free of the walltime on top of one step and the mean restart write time so far
     opts.getScalarValue("monitor_res_freq", monitor_res_freq, 100);
+    opts.getScalarValue("timer_report", timer_report, 1); //0: no timers; 1: summary at the end of the run; 2: also every monitor_res_freq steps
+    opts.getScalarValue("trace_start", trace_start, 0); //first iteration written to the chrome trace <data_file_name>_trace.json
+    opts.getScalarValue("trace_end", trace_end, -1);    //last traced iteration, no trace if trace_end<trace_start
+    opts.getScalarValue("trace_buffer", trace_buffer, 1 << 18); //max number of trace events per thread
+    opts.getScalarValue("perf_counters", perf_counters, 0); //1: count cycles, instructions, LLC misses and FP operations per stage
+    opts.getScalarValue("perf_fp_event", perf_fp_event, string("auto")); //auto: FP events of the CPU vendor; or a raw event code
+    opts.getScalarValue("roofline_gflops", roofline_gflops, 0.); //peak GFLOP/s of one core, printed by hifiles_bench
+    opts.getScalarValue("roofline_bandwidth", roofline_bandwidth, 0.); //peak GB/s of one core, printed by hifiles_bench
+    opts.getScalarValue("comm_profile", comm_profile, 0); //1: bytes, messages and times of the halo exchanges per neighbor, printed at the end of the run
+    opts.getScalarValue("memory_report", memory_report, 0); //1: hf_array memory by array after preprocessing and at the peak, needs USE_MEM_TRACK
     opts.getScalarValue("calc_force", calc_force, 0);
     if (calc_force)
     {
@@ -108,7 +147,12 @@ void input::read_input_file(string fileName, int rank)
     opts.getScalarValue("res_norm_type", res_norm_type, 2);
     opts.getScalarValue("error_norm_type", error_norm_type, 2);
     opts.getScalarValue("p_res", p_res, 2);           // number of points per edge for plotting
-    opts.getScalarValue("write_type", write_type, 0); //0: vtu/pvtu; 1: tec; 2: cgns
+    opts.getScalarValue("write_type", write_type, 0); //0: vtu/pvtu; 1: tec; 2: cgns; 3: hdf5/xdmf
+    opts.getScalarValue("vtu_format", vtu_format, 0); //0: ascii; 1: appended raw binary; 2: appended zlib compressed binary
+    opts.getScalarValue("restart_compression", restart_compression, 0); //deflate level of the hdf5 restart data, 0: uncompressed
+    opts.getScalarValue("plot_compression", plot_compression, 0); //deflate level of the hdf5/xdmf plot data, 0: uncompressed
+    opts.getScalarValue("plot_precision", plot_precision, -1); //decimal digits kept in the hdf5/xdmf plot fields, -1: lossless
+    opts.getScalarValue("async_output", async_output, 0); //1: write plot/probe/restart files from a background thread
     opts.getScalarValue("probe", probe, 0);
     opts.getVectorValueOptional("integral_quantities", integral_quantities);
     opts.getVectorValueOptional("diagnostic_fields", diagnostic_fields);
@@ -245,15 +289,22 @@ void input::read_input_file(string fileName, int rank)
         opts.getScalarValue("x_shock_ic", x_shock_ic); //x-coord of shock wave
 
     /* ---- Shock Capturing / dealiasing ---- */
-    opts.getScalarValue("over_int", over_int, 0);
+    opts.getScalarValue("over_int", over_int, 0); //0: off 1: all elements 2: elements flagged by sensor
     if (over_int)
+    {
         opts.getScalarValue("over_int_order", over_int_order);
+        if (over_int == 2)
+            opts.getScalarValue("over_int_s0", over_int_s0, 1.e-3); //sensor threshold of selective over-integration
+    }
+
+    opts.getScalarValue("split_form", split_form, 0); //0: off 1: kinetic energy preserving 2: entropy conservative
 
     opts.getScalarValue("shock_cap", shock_cap, 0); //0: off 1: exponential filter
     if (shock_cap)
     {
         opts.getScalarValue("shock_det", shock_det, 0); //0: persson
         opts.getScalarValue("s0", s0);                  //sensor threshold
+        opts.getScalarValue("shock_det_freq", shock_det_freq, 0); //0: every RK stage n: first stage of every n steps
         if (shock_cap == 1)                             //exp filter
         {
             opts.getScalarValue("expf_fac", expf_fac, 36.0);
@@ -264,6 +315,11 @@ void input::read_input_file(string fileName, int rank)
         else
             FatalError("Shock capturing method not implemented!")
     }
+    else if (over_int == 2) //sensor only
+    {
+        opts.getScalarValue("shock_det", shock_det, 0);
+        opts.getScalarValue("shock_det_field", shock_det_field, 0);
+    }
 
     /* ---- FR Element Solution Point / Correction Function Parameters ---- */
     // Tris
@@ -520,6 +576,29 @@ void input::setup_params(int rank)
     if (write_type == 2)
         FatalError("To use CGNS output, build HiFiLES with CGNS support");
 #endif // !_CGNS
+#ifndef _HDF5
+    if (write_type == 3)
+        FatalError("To use HDF5/XDMF output, build HiFiLES with HDF5 support");
+#endif
+    if (vtu_format < 0 || vtu_format > 2)
+        FatalError("vtu_format must be 0 (ascii), 1 (binary) or 2 (compressed binary)");
+    if (restart_compression < 0 || restart_compression > 9 || plot_compression < 0 || plot_compression > 9)
+        FatalError("restart_compression and plot_compression must be deflate levels between 0 and 9");
+#ifndef _HDF5
+    if (restart_compression || plot_compression || plot_precision >= 0)
+        FatalError("Compressed restart and plot output requires HDF5 support");
+#endif
+#if defined(_HDF5) && defined(_MPI)
+#if !H5_VERSION_GE(1, 10, 2)
+    //filters on datasets written in parallel are only supported from HDF5 1.10.2 on
+    if (restart_compression || plot_compression || plot_precision >= 0)
+        FatalError("Compressed parallel restart and plot output requires HDF5 1.10.2 or later");
+#endif
+#endif
+#ifndef _ZLIB
+    if (vtu_format == 2)
+        FatalError("To use compressed vtu output, build HiFiLES with HDF5 and zlib support");
+#endif
 
     if (equation == 0)
     {
@@ -554,7 +633,22 @@ void input::setup_params(int rank)
     {
         if (over_int_order < 0)
             FatalError("Invalid under sampling order");
+        if (over_int != 1 && over_int != 2)
+            FatalError("Over-integration type not recognized");
+        if (over_int == 2 && over_int_s0 <= 0.)
+            FatalError("over_int_s0 must be positive");
+    }
+    if (split_form)
+    {
+        if (split_form != 1 && split_form != 2)
+            FatalError("Split form flux not recognized");
+        if (over_int)
+            FatalError("Cannot use split form flux with over-integration");
+        if (RANS)
+            FatalError("Split form flux not supported with RANS turbulent models");
     }
+    if (shock_cap && shock_det_freq < 0)
+        FatalError("shock_det_freq must be non-negative");
 
     // --------------------------
     // SETTING UP RK COEFFICIENTS
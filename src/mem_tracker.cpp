@@ -0,0 +1,290 @@
+/*!
+ * \file mem_tracker.cpp
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include "../include/mem_tracker.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+using namespace std;
+
+//rows of the breakdown, the rest is summed in one row
+#define N_REPORT_ROWS 40
+
+static const char *mem_type_names[] = {"tri", "quad", "tet", "pri", "hex", "-"};
+
+mem_tracker &memory_tracker(void)
+{
+  static mem_tracker *tracker = new mem_tracker;
+  return *tracker;
+}
+
+int mem_tracker::find_owner(const void *in_ptr)
+{
+  const char *p = (const char *)in_ptr;
+  int found = -1;
+  for (size_t i = 0; i < owners.size(); i++)
+    if (p >= owners[i].begin && p < owners[i].begin + owners[i].size && (found < 0 || owners[i].size < owners[found].size))
+      found = i;
+  return found;
+}
+
+int mem_tracker::get_tag(const void *in_array, const char *in_file, int in_line)
+{
+  lock_guard<mutex> lock(tracker_mutex);
+
+  int i_owner = find_owner(in_array);
+  const char *owner = i_owner < 0 ? nullptr : owners[i_owner].name;
+  int ele_type = i_owner < 0 ? -1 : owners[i_owner].ele_type;
+
+  auto key = make_tuple(in_file, in_line, owner, ele_type);
+  auto it = tag_index.find(key);
+  if (it != tag_index.end())
+    return it->second;
+
+  tag_info info;
+  info.file = in_file;
+  info.line = in_line;
+  info.owner = owner;
+  info.ele_type = ele_type;
+  tags.push_back(info);
+  bytes.push_back(0);
+  n_arrays.push_back(0);
+  peak_bytes.push_back(0);
+  peak_n_arrays.push_back(0);
+  tag_index[key] = tags.size() - 1;
+  return tags.size() - 1;
+}
+
+void mem_tracker::add(int in_tag, long long in_bytes)
+{
+  lock_guard<mutex> lock(tracker_mutex);
+  bytes[in_tag] += in_bytes;
+  n_arrays[in_tag]++;
+  total += in_bytes;
+  if (total > peak_total)
+  {
+    peak_total = total;
+    peak_bytes = bytes;
+    peak_n_arrays = n_arrays;
+  }
+}
+
+void mem_tracker::remove(int in_tag, long long in_bytes)
+{
+  lock_guard<mutex> lock(tracker_mutex);
+  bytes[in_tag] -= in_bytes;
+  n_arrays[in_tag]--;
+  total -= in_bytes;
+}
+
+void mem_tracker::add_owner(const void *in_owner, size_t in_size, const char *in_name, int in_ele_type)
+{
+  lock_guard<mutex> lock(tracker_mutex);
+  owner_info info;
+  info.begin = (const char *)in_owner;
+  info.size = in_size;
+  info.name = in_name;
+  info.ele_type = in_ele_type;
+  owners.push_back(info);
+}
+
+void mem_tracker::add_nested(const void *in_data, size_t in_size, const void *in_array)
+{
+  lock_guard<mutex> lock(tracker_mutex);
+  int i_owner = find_owner(in_array);
+  if (i_owner < 0)
+    return;
+  owner_info info = owners[i_owner];
+  info.begin = (const char *)in_data;
+  info.size = in_size;
+  owners.push_back(info);
+}
+
+void mem_tracker::remove_owner(const void *in_owner)
+{
+  lock_guard<mutex> lock(tracker_mutex);
+  for (size_t i = 0; i < owners.size(); i++)
+    if (owners[i].begin == (const char *)in_owner)
+    {
+      owners.erase(owners.begin() + i);
+      return;
+    }
+}
+
+// format the breakdown of this rank as text, the largest arrays first
+
+static string format_breakdown(const vector<long long> &in_bytes, const vector<long long> &in_n_arrays,
+                               const vector<string> &in_owner, const vector<string> &in_site, const vector<int> &in_ele_type, long long in_total)
+{
+  char line[512];
+  string text;
+  vector<size_t> order;
+  for (size_t i = 0; i < in_bytes.size(); i++)
+    if (in_bytes[i] > 0)
+      order.push_back(i);
+  sort(order.begin(), order.end(), [&](size_t a, size_t b) { return in_bytes[a] > in_bytes[b]; });
+
+  snprintf(line, sizeof(line), "%-12s %-5s %-40s %8s %11s %7s\n", "owner", "type", "site", "arrays", "MB", "%");
+  text += line;
+  long long other_bytes = 0, other_arrays = 0;
+  for (size_t r = 0; r < order.size(); r++)
+  {
+    size_t i = order[r];
+    if (r >= N_REPORT_ROWS)
+    {
+      other_bytes += in_bytes[i];
+      other_arrays += in_n_arrays[i];
+      continue;
+    }
+    snprintf(line, sizeof(line), "%-12s %-5s %-40.40s %8lld %11.3f %7.2f\n", in_owner[i].c_str(),
+             mem_type_names[in_ele_type[i] < 0 ? 5 : in_ele_type[i]], in_site[i].c_str(),
+             in_n_arrays[i], in_bytes[i] / 1048576., in_total > 0 ? 100. * in_bytes[i] / in_total : 0.);
+    text += line;
+  }
+  if (other_arrays)
+  {
+    snprintf(line, sizeof(line), "%-12s %-5s %-40s %8lld %11.3f %7.2f\n", "other", "-", "-",
+             other_arrays, other_bytes / 1048576., in_total > 0 ? 100. * other_bytes / in_total : 0.);
+    text += line;
+  }
+
+  //totals per element type
+  long long type_bytes[6] = {0, 0, 0, 0, 0, 0};
+  for (size_t i = 0; i < in_bytes.size(); i++)
+    type_bytes[in_ele_type[i] < 0 ? 5 : in_ele_type[i]] += in_bytes[i];
+  text += "per element type (MB):";
+  for (int t = 0; t < 6; t++)
+  {
+    snprintf(line, sizeof(line), " %s %.3f", t < 5 ? mem_type_names[t] : "other", type_bytes[t] / 1048576.);
+    text += line;
+  }
+  text += "\n";
+  return text;
+}
+
+// gather the usage of every rank, then the rank using the most memory formats its breakdown and sends it to rank 0.
+// Every rank has to call it
+
+void mem_tracker::report(bool in_peak, const char *in_label, ostream &out)
+{
+  int rank = 0, nproc = 1;
+  vector<long long> loc_bytes, loc_n_arrays;
+  vector<string> owner, site;
+  vector<int> ele_type;
+  long long loc_total;
+  struct
+  {
+    double val;
+    int rank;
+  } loc_max, max_total;
+
+  {
+    lock_guard<mutex> lock(tracker_mutex);
+    loc_bytes = in_peak ? peak_bytes : bytes;
+    loc_n_arrays = in_peak ? peak_n_arrays : n_arrays;
+    loc_total = in_peak ? peak_total : total;
+    for (size_t i = 0; i < tags.size(); i++)
+    {
+      const char *base = strrchr(tags[i].file, '/');
+      base = base ? base + 1 : tags[i].file;
+      site.push_back(string(base) + ":" + to_string(tags[i].line));
+      //arrays outside a registered object are attributed to the file that sized them
+      owner.push_back(tags[i].owner ? tags[i].owner : string(base).substr(0, string(base).find('.')));
+      ele_type.push_back(tags[i].ele_type);
+    }
+  }
+
+  //merge the tags of the same line and owner, a header line may be seen from several translation units
+  map<tuple<string, string, int>, size_t> merged;
+  for (size_t i = 0; i < site.size(); i++)
+  {
+    auto key = make_tuple(site[i], owner[i], ele_type[i]);
+    auto it = merged.find(key);
+    if (it == merged.end())
+      merged[key] = i;
+    else
+    {
+      loc_bytes[it->second] += loc_bytes[i];
+      loc_n_arrays[it->second] += loc_n_arrays[i];
+      loc_bytes[i] = 0;
+    }
+  }
+
+  loc_max.val = loc_total;
+  loc_max.rank = 0;
+  max_total = loc_max;
+  double min_total = loc_total, sum_total = loc_total;
+
+#ifdef _MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  loc_max.rank = rank;
+  double loc_val = loc_total;
+  MPI_Allreduce(&loc_max, &max_total, 1, MPI_DOUBLE_INT, MPI_MAXLOC, MPI_COMM_WORLD);
+  MPI_Reduce(&loc_val, &min_total, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&loc_val, &sum_total, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+#endif
+
+  string text;
+  if (rank == max_total.rank)
+    text = format_breakdown(loc_bytes, loc_n_arrays, owner, site, ele_type, loc_total);
+
+#ifdef _MPI
+  if (max_total.rank != 0)
+  {
+    int n_chars = text.size();
+    if (rank == max_total.rank)
+    {
+      MPI_Send(&n_chars, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
+      MPI_Send(&text[0], n_chars, MPI_CHAR, 0, 1, MPI_COMM_WORLD);
+    }
+    else if (rank == 0)
+    {
+      MPI_Recv(&n_chars, 1, MPI_INT, max_total.rank, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      text.resize(n_chars);
+      MPI_Recv(&text[0], n_chars, MPI_CHAR, max_total.rank, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+  }
+#endif
+
+  if (rank != 0)
+    return;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  char line[256];
+  snprintf(line, sizeof(line), "Memory of the hf_arrays %s, %s: min %.3f MB, avg %.3f MB, max %.3f MB on rank %d",
+           in_label, in_peak ? "high-water mark" : "current", min_total / 1048576., sum_total / nproc / 1048576.,
+           max_total.val / 1048576., max_total.rank);
+  out << line << endl;
+  snprintf(line, sizeof(line), "(peak resident set size of rank 0: %.3f MB)", usage.ru_maxrss / 1024.);
+  out << line << endl;
+  out << "Breakdown of rank " << max_total.rank << ":" << endl
+      << text;
+}
@@ -27,38 +27,214 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
+//number of fluid elements between two entries of the element index of ascii gmsh files
+static const long long ele_block_size = 4096;
+
+/*------------------------------text parsers----------------------------*/
+//the mesh file is memory mapped and parsed in place, these replace the stream extraction
+
+static inline void skip_space(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+}
+
+static inline void skip_line(const char *&p, const char *end)
+{
+    const char *q = (const char *)memchr(p, '\n', end - p);
+    p = q ? q + 1 : end;
+}
+
+static inline long long parse_int(const char *&p, const char *end)
+{
+    bool neg = false;
+    long long val = 0;
+
+    skip_space(p, end);
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = (*p++ == '-');
+    if (p >= end || *p < '0' || *p > '9')
+        FatalError("Integer expected in mesh file");
+    while (p < end && *p >= '0' && *p <= '9')
+        val = val * 10 + (*p++ - '0');
+    return neg ? -val : val;
+}
+
+// mantissas of up to 19 digits below 2^53 scaled by at most 10^22 are exact in one
+// floating point operation, anything else is left to strtod
+
+static inline double parse_double(const char *&p, const char *end)
+{
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    unsigned long long mant = 0;
+    int n_digits = 0, n_sig = 0, exp10 = 0, exp_val = 0;
+    bool neg = false, exp_neg = false, exact = true;
+    const char *start;
+    char *q;
+
+    skip_space(p, end);
+    start = p;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = (*p++ == '-');
+    for (; p < end && *p >= '0' && *p <= '9'; p++, n_digits++)
+    {
+        if (n_sig < 19)
+        {
+            mant = mant * 10 + (*p - '0');
+            if (mant)
+                n_sig++;
+        }
+        else
+            exact = false;
+    }
+    if (p < end && *p == '.')
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, n_digits++)
+        {
+            if (n_sig < 19)
+            {
+                mant = mant * 10 + (*p - '0');
+                if (mant)
+                    n_sig++;
+                exp10--;
+            }
+            else
+                exact = false;
+        }
+    if (n_digits && p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        if (p < end && (*p == '-' || *p == '+'))
+            exp_neg = (*p++ == '-');
+        while (p < end && *p >= '0' && *p <= '9' && exp_val < 10000)
+            exp_val = exp_val * 10 + (*p++ - '0');
+        exp10 += exp_neg ? -exp_val : exp_val;
+    }
+
+    if (n_digits && exact && mant < (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+    {
+        double val = exp10 < 0 ? (double)mant / pow10[-exp10] : (double)mant * pow10[exp10];
+        return neg ? -val : val;
+    }
+
+    double val = strtod(start, &q);
+    if (q == start)
+        FatalError("Number expected in mesh file");
+    p = q;
+    return val;
+}
+
+static inline string parse_word(const char *&p, const char *end)
+{
+    skip_space(p, end);
+    const char *start = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+        p++;
+    return string(start, p);
+}
+
+//pointer to the line following the first line containing in_text
+
+static const char *find_text(const char *p, const char *end, const char *in_text)
+{
+    const char *q = (const char *)memmem(p, end - p, in_text, strlen(in_text));
+    if (q == NULL)
+        return NULL;
+    skip_line(q, end);
+    return q;
+}
+
+//number of nodes of gmsh element types, -1 if not recognized
+
+static int gmsh_n_nodes(int in_elmtype)
+{
+    static const int n_nodes[] = {-1, 2, 3, 4, 4, 8, 6, 5, 3, 6, 9, 10, 27, 18, 14, 1, 8, 20, 15};
+    if (in_elmtype < 1 || in_elmtype > 18)
+        return -1;
+    return n_nodes[in_elmtype];
+}
+
+//number of corner vertices of gmsh boundary face element types, 0 if not a face
+
+static int gmsh_n_face_verts(int in_elmtype)
+{
+    if (in_elmtype == 1 || in_elmtype == 8) // first and second order Edge
+        return 2;
+    else if (in_elmtype == 3 || in_elmtype == 16) // first and second order Quad face
+        return 4;
+    else if (in_elmtype == 2 || in_elmtype == 9) // first and second order tri face
+        return 3;
+    return 0;
+}
+
 mesh_reader::mesh_reader(string in_fileName, mesh *in_mesh)
 {
     fname = in_fileName;
     mesh_ptr = in_mesh;
-    if (!fname.compare(fname.size() - 3, 3, "neu"))
-        mesh_format = 0;
-    else if (!fname.compare(fname.size() - 3, 3, "msh"))
-        mesh_format = 1;
+    map_ptr = NULL;
+    map_size = 0;
+    if (run_input.mesh_format == MESH_BOX)
+        mesh_format = MESH_BOX;
+    else if (fname.size() > 3 && !fname.compare(fname.size() - 3, 3, "neu"))
+        mesh_format = MESH_GAMBIT;
+    else if (fname.size() > 3 && !fname.compare(fname.size() - 3, 3, "msh"))
+        mesh_format = MESH_GMSH;
     else
         FatalError("Mesh format not recognized");
 
+    if (mesh_format != MESH_BOX) //the box is generated, there is no file
+        map_file();
     read_header();
 }
 
 mesh_reader::~mesh_reader()
 {
+    if (map_ptr)
+        munmap((void *)map_ptr, map_size);
+}
+
+// map the whole file read only, ranks on the same node share the pages in the page cache
+
+void mesh_reader::map_file(void)
+{
+    struct stat st;
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        FatalError("Unable to open mesh file");
+    if (fstat(fd, &st) || st.st_size == 0)
+        FatalError("Unable to read mesh file");
+
+    map_size = st.st_size;
+    void *ptr = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        FatalError("Unable to map mesh file");
+    map_ptr = (const char *)ptr;
 }
 
 void mesh_reader::read_header(void)
 {
 
-    if (mesh_format == 0) //gambit
+    if (mesh_format == MESH_GAMBIT)
     {
         read_header_gambit();
     }
-    else if (mesh_format == 1) //gmsh
+    else if (mesh_format == MESH_GMSH)
     {
         read_header_gmsh();
     }
+    else if (mesh_format == MESH_BOX)
+    {
+        read_header_box();
+    }
 }
 
 void mesh_reader::partial_read_connectivity(int kstart, int in_num_cells)
@@ -68,82 +244,86 @@ void mesh_reader::partial_read_connectivity(int kstart, int in_num_cells)
 
     mesh_ptr->num_cells = in_num_cells; //store number of cells read by this processor in mesh obj
 
-    if (mesh_format == 0) //gambit
+    if (mesh_format == MESH_GAMBIT)
     {
         partial_read_connectivity_gambit(kstart, in_num_cells);
     }
-    else if (mesh_format == 1) //gmsh
+    else if (mesh_format == MESH_GMSH)
     {
         partial_read_connectivity_gmsh(kstart, in_num_cells);
     }
+    else if (mesh_format == MESH_BOX)
+    {
+        partial_read_connectivity_box(kstart, in_num_cells);
+    }
 }
 
 void mesh_reader::read_vertices(void)
 {
-    if (mesh_format == 0) //gambit
+    if (mesh_format == MESH_GAMBIT)
     {
         read_vertices_gambit();
     }
-    else if (mesh_format == 1) //gmsh
+    else if (mesh_format == MESH_GMSH)
     {
         read_vertices_gmsh();
     }
+    else if (mesh_format == MESH_BOX)
+    {
+        read_vertices_box();
+    }
 }
 
 void mesh_reader::read_boundary(void)
 {
-    if (mesh_format == 0) //gambit
+    if (mesh_format == MESH_GAMBIT)
     {
         read_boundary_gambit();
     }
-    else if (mesh_format == 1) //gmsh
+    else if (mesh_format == MESH_GMSH)
     {
         read_boundary_gmsh();
     }
+    else if (mesh_format == MESH_BOX)
+    {
+        read_boundary_box();
+    }
 }
 /*------------------------------gambit readers----------------------------*/
 void mesh_reader::read_header_gambit(void)
 {
-    int dummy;
-    char buf[BUFSIZ] = {""};
-
-    mesh_file.open(fname.c_str());
-    if (!mesh_file)
-        FatalError("Unable to open mesh file");
+    const char *end = map_ptr + map_size, *p = map_ptr;
 
     // Skip 6-line header
     for (int i = 0; i < 6; i++)
-        mesh_file.getline(buf, BUFSIZ);
+        skip_line(p, end);
 
     // Find number of vertices and number of cells
-    mesh_file >> mesh_ptr->num_verts_global // num vertices in mesh
-        >> mesh_ptr->num_cells_global       // num elements
-        >> dummy                            // num material groups
-        >> mesh_ptr->n_bdy                  // num boundary groups
-        >> mesh_ptr->n_ele_dims             // num ele dimensions(surf/vol)
-        >> mesh_ptr->n_dims;                // num coordinate dimensions
+    mesh_ptr->num_verts_global = parse_int(p, end); // num vertices in mesh
+    mesh_ptr->num_cells_global = parse_int(p, end); // num elements
+    parse_int(p, end);                              // num material groups
+    mesh_ptr->n_bdy = parse_int(p, end);            // num boundary groups
+    mesh_ptr->n_ele_dims = parse_int(p, end);       // num ele dimensions(surf/vol)
+    mesh_ptr->n_dims = parse_int(p, end);           // num coordinate dimensions
     if (mesh_ptr->n_dims != 2 && mesh_ptr->n_dims != 3)
     {
         FatalError("Invalid mesh dimensionality. Expected 2D or 3D.");
     }
-    mesh_file.close();
 }
 
 void mesh_reader::partial_read_connectivity_gambit(int kstart, int in_num_cells)
 {
-    int dummy;
-    char buf[BUFSIZ] = {""};
-
-    mesh_file.open(fname.c_str());
-    if (!mesh_file)
-        FatalError("Unable to open mesh file");
-
-    while (1) //skip to element section
-    {
-        mesh_file.getline(buf, BUFSIZ);
-        if (strstr(buf, "ELEMENTS/CELLS") != NULL)
-            break;
-    }
+    // gambit vertex order of each element type and number of vertices, in the order of the hifiles vertex slots they fill
+    static const int tri3[] = {0, 1, 2}, tri6[] = {0, 3, 1, 4, 2, 5};
+    static const int quad4[] = {0, 1, 3, 2}, quad8[] = {0, 4, 1, 5, 2, 6, 3, 7};
+    static const int tet4[] = {0, 1, 2, 3}, tet10[] = {0, 4, 1, 5, 7, 2, 6, 9, 8, 3};
+    static const int pri6[] = {0, 1, 2, 3, 4, 5}, pri15[] = {0, 6, 1, 8, 7, 2, 9, 10, 11, 3, 12, 4, 14, 13, 5};
+    static const int hex8[] = {0, 2, 4, 6, 1, 3, 5, 7}, hex20[] = {0, 11, 3, 12, 15, 4, 19, 7, 8, 10, 16, 18, 1, 9, 2, 13, 14, 5, 17, 6};
+
+    const char *end = map_ptr + map_size;
+    const char *p = find_text(map_ptr, end, "ELEMENTS/CELLS"); //skip to element section
+    if (p == NULL)
+        FatalError("ELEMENTS/CELLS section not found");
 
     //allocate memory
     mesh_ptr->c2v.setup(in_num_cells, MAX_V_PER_C); // stores the vertices making that cell
@@ -154,154 +334,129 @@ void mesh_reader::partial_read_connectivity_gambit(int kstart, int in_num_cells)
     // Initialize arrays to -1
     mesh_ptr->c2v.initialize_to_value(-1);
 
-    // Skip elements being read by other processors
+    // Skip elements being read by other processors, an element may continue over several lines
 
     for (int i = 0; i < kstart; i++)
     {
-        mesh_file >> dummy >> dummy >> dummy;
-        mesh_file.getline(buf, BUFSIZ); // skip end of line
-        if (dummy > 7)
-            mesh_file.getline(buf, BUFSIZ); // skip another line
-        if (dummy > 14)
-            mesh_file.getline(buf, BUFSIZ); // skip another line
-        if (dummy > 21)
-            mesh_file.getline(buf, BUFSIZ); // skip another line
+        parse_int(p, end);
+        parse_int(p, end);
+        int n_v = parse_int(p, end);
+        for (int k = 0; k < n_v; k++)
+            parse_int(p, end);
     }
 
     // Read a block of elements
 
     int eleType;//general type of element 
+    const int *order;
 
     for (int i = 0; i < in_num_cells; i++)
     {
         //  ctype is the element type:  1=edge, 2=quad, 3=tri, 4=brick, 5=wedge, 6=tet, 7=pyramid
-        mesh_file >> mesh_ptr->ic2icg(i) >> eleType >> mesh_ptr->c2n_v(i);
+        mesh_ptr->ic2icg(i) = parse_int(p, end);
+        eleType = parse_int(p, end);
+        mesh_ptr->c2n_v(i) = parse_int(p, end);
 
         //identify type of the element
-        if (eleType == 3)
-            mesh_ptr->ctype(i) = TRI;
-        else if (eleType == 2)
-            mesh_ptr->ctype(i) = QUAD;
-        else if (eleType == 6)
-            mesh_ptr->ctype(i) = TET;
-        else if (eleType == 5)
-            mesh_ptr->ctype(i) = PRISM;
-        else if (eleType == 4)
-            mesh_ptr->ctype(i) = HEX;
-
+        order = NULL;
         // triangle
-        if (mesh_ptr->ctype(i) == TRI)
+        if (eleType == 3)
         {
+            mesh_ptr->ctype(i) = TRI;
             if (mesh_ptr->c2n_v(i) == 3) // linear triangle
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2);
+                order = tri3;
             else if (mesh_ptr->c2n_v(i) == 6) // quadratic triangle
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 5);
+                order = tri6;
             else
                 FatalError("triangle element type not implemented");
         }
         // quad
-        else if (mesh_ptr->ctype(i) == QUAD)
+        else if (eleType == 2)
         {
+            mesh_ptr->ctype(i) = QUAD;
             if (mesh_ptr->c2n_v(i) == 4) // linear quadrangle
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 2);
+                order = quad4;
             else if (mesh_ptr->c2n_v(i) == 8) // quadratic quad
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 7);
+                order = quad8;
             else
                 FatalError("quad element type not implemented");
         }
         // tet
-        else if (mesh_ptr->ctype(i) == TET)
+        else if (eleType == 6)
         {
+            mesh_ptr->ctype(i) = TET;
             if (mesh_ptr->c2n_v(i) == 4) // linear tets
-            {
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3);
-            }
+                order = tet4;
             else if (mesh_ptr->c2n_v(i) == 10) // quadratic tet
-            {
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 7);
-                mesh_file >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 9) >> mesh_ptr->c2v(i, 8) >> mesh_ptr->c2v(i, 3);
-            }
+                order = tet10;
             else
                 FatalError("tet element type not implemented");
         }
         // prisms
-        else if (mesh_ptr->ctype(i) == PRISM)
+        else if (eleType == 5)
         {
+            mesh_ptr->ctype(i) = PRISM;
             if (mesh_ptr->c2n_v(i) == 6) // linear prism
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5);
+                order = pri6;
             else if (mesh_ptr->c2n_v(i) == 15) // quadratic prism
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 8) >> mesh_ptr->c2v(i, 7) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 9) >> mesh_ptr->c2v(i, 10) >> mesh_ptr->c2v(i, 11) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 12) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 14) >> mesh_ptr->c2v(i, 13) >> mesh_ptr->c2v(i, 5);
+                order = pri15;
             else
                 FatalError("Prism element type not implemented");
         }
         // hexa
-        else if (mesh_ptr->ctype(i) == HEX)
+        else if (eleType == 4)
         {
+            mesh_ptr->ctype(i) = HEX;
             if (mesh_ptr->c2n_v(i) == 8) // linear hexas
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 7);
+                order = hex8;
             else if (mesh_ptr->c2n_v(i) == 20) // quadratic hexas
-                mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 11) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 12) >> mesh_ptr->c2v(i, 15) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 19) >> mesh_ptr->c2v(i, 7) >> mesh_ptr->c2v(i, 8) >> mesh_ptr->c2v(i, 10) >> mesh_ptr->c2v(i, 16) >> mesh_ptr->c2v(i, 18) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 9) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 13) >> mesh_ptr->c2v(i, 14) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 17) >> mesh_ptr->c2v(i, 6);
+                order = hex20;
             else
                 FatalError("Hexa element type not implemented");
         }
         else
         {
-            cout << "Element Type = " << mesh_ptr->ctype(i) << endl;
+            cout << "Element Type = " << eleType << endl;
             FatalError("Haven't implemented this element type in gambit_meshreader3, exiting ");
         }
-        mesh_file.getline(buf, BUFSIZ); // skip end of line
 
         // Shift every values of c2v by -1 to be 0 based, rest of it to be -1
         for (int k = 0; k < mesh_ptr->c2n_v(i); k++)
-                mesh_ptr->c2v(i, k)--;
+            mesh_ptr->c2v(i, order[k]) = parse_int(p, end) - 1;
 
         // Also shift every value of ic2icg to be 0 based
         mesh_ptr->ic2icg(i)--;
     }
-    mesh_file.close();
 }
 
 void mesh_reader::read_vertices_gambit(void)
 {
-    // Now open gambit file and read the vertices
-    char buf[BUFSIZ] = {""};
-
-    mesh_file.open(fname.c_str());
-
-    if (!mesh_file)
-        FatalError("Could not open mesh file");
-
-    while (1) //skip to vertex section
-    {
-        mesh_file.getline(buf, BUFSIZ);
-        if (strstr(buf, "NODAL COORDINATES") != NULL)
-            break;
-    }
+    // Now read the vertices from the gambit file
+    const char *end = map_ptr + map_size;
+    const char *p = find_text(map_ptr, end, "NODAL COORDINATES"); //skip to vertex section
+    if (p == NULL)
+        FatalError("NODAL COORDINATES section not found");
 
     // Read the location of vertices
     mesh_ptr->xv.setup(mesh_ptr->num_verts, mesh_ptr->n_dims);
     int id, index;
     for (int i = 0; i < mesh_ptr->num_verts_global; i++)
     {
-        mesh_file >> id;//global id
+        id = parse_int(p, end); //global id
         index = index_locate_int(id - 1, mesh_ptr->iv2ivg.get_ptr_cpu(), mesh_ptr->num_verts);//find local index
 
         if (index != -1) // Vertex belongs to this processor
         {
             for (int m = 0; m < mesh_ptr->n_dims; m++)
-                mesh_file >> mesh_ptr->xv(index, m);
+                mesh_ptr->xv(index, m) = parse_double(p, end);
         }
-        mesh_file.getline(buf, BUFSIZ); //clear the line
+        skip_line(p, end); //clear the line
     }
-    mesh_file.close();
 }
 
 void mesh_reader::read_boundary_gambit()
 {
-    char buf[BUFSIZ] = {""};
-    mesh_file.open(fname.c_str());
-    if (!mesh_file)
-        FatalError("Unable to open mesh file");
+    const char *end = map_ptr + map_size, *p = map_ptr;
 
     mesh_ptr->bc_id.setup(mesh_ptr->num_cells, MAX_F_PER_C);//array that hold the index of bc_objects in bc_list
     mesh_ptr->bc_id.initialize_to_value(-1);//-1 as default internal face
@@ -310,24 +465,25 @@ void mesh_reader::read_boundary_gambit()
     for (int i = 0; i < mesh_ptr->n_bdy; i++)
     {
         // Move cursor to the next boundary
-        while (1)
-        {
-            mesh_file.getline(buf, BUFSIZ);
-            if (strstr(buf, "BOUNDARY CONDITIONS") != NULL)
-                break;
-        }
+        p = find_text(p, end, "BOUNDARY CONDITIONS");
+        if (p == NULL)
+            FatalError("BOUNDARY CONDITIONS section not found");
 
-        int bcNF, dummy, icg, k, real_face;
+        int bcNF, icg, k, real_face;
         string bcname;
-        mesh_file >> bcname >> dummy >> bcNF;
+        bcname = parse_word(p, end);
+        parse_int(p, end);
+        bcNF = parse_int(p, end);
         run_input.bc_list(i).setup(bcname); //setup bcname
 
-        mesh_file.getline(buf, BUFSIZ);//skip rest of line
+        skip_line(p, end);//skip rest of line
 
         int eleType;
         for (int bf = 0; bf < bcNF; bf++)
         {
-            mesh_file >> icg >> eleType >> k;
+            icg = parse_int(p, end);
+            eleType = parse_int(p, end);
+            k = parse_int(p, end);
             icg--; // 1-indexed -> 0-indexed
             // Matching Gambit faces with face convention in code
             if (eleType == 2 || eleType == 3)
@@ -388,104 +544,396 @@ void mesh_reader::read_boundary_gambit()
 
         }
     }
-
-    mesh_file.close();
 }
 
 /*------------------------------gmsh readers----------------------------*/
+// Gmsh 2.2 ascii and Gmsh 4.1 ascii/binary files are supported. Rank 0 indexes the sections and the element
+// blocks once and broadcasts them, so that each processor only parses its own ranges of the file.
 
 void mesh_reader::read_header_gmsh(void)
 {
-    int dummy;
-    char buf[BUFSIZ] = {""};
-    string str, bc_txt_temp;
+    const char *end = map_ptr + map_size, *p;
+    string bc_txt_temp;
     int bcid;
 
-    //open file
-    mesh_file.open(fname.c_str());
-    if (!mesh_file)
-        FatalError("Unable to open mesh file");
-
-    // Move cursor to $PhysicalNames
-    while (1)
-    {
-        getline(mesh_file, str);
-        if (str.find("$PhysicalNames") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$PhysicalNames tag not found!");
-    }
+    index_sections_gmsh();
 
     // Read number of physical groups
-    mesh_file >> mesh_ptr->n_bdy;
+    p = section_gmsh("PhysicalNames");
+    mesh_ptr->n_bdy = parse_int(p, end);
     mesh_ptr->n_bdy--;              //substract FLUID group
-    mesh_file.getline(buf, BUFSIZ); // clear rest of line
+    skip_line(p, end); // clear rest of line
     for (int i = 0; i < mesh_ptr->n_bdy + 1; i++)
     {
-        mesh_file >> mesh_ptr->n_dims >> bcid >> bc_txt_temp;
+        mesh_ptr->n_dims = parse_int(p, end);
+        bcid = parse_int(p, end);
+        bc_txt_temp = parse_word(p, end);
         mesh_ptr->n_ele_dims = mesh_ptr->n_dims;//element dimension equals to mesh dimension
         bc_txt_temp.erase(bc_txt_temp.find_last_not_of(" \n\r\t") + 1);
         bc_txt_temp.erase(bc_txt_temp.find_last_not_of("\"") + 1);
         if (bc_txt_temp.find_first_not_of("\"") != 0)
             bc_txt_temp.erase(bc_txt_temp.find_first_not_of("\"") - 1, 1);
         if (bc_txt_temp == "FLUID")
+        {
+            fluid_id = bcid;
             break;
+        }
         if (i == mesh_ptr->n_bdy)
             FatalError("Cant find fluid group in mesh file");
-        mesh_file.getline(buf, BUFSIZ); // clear rest of line
+        skip_line(p, end); // clear rest of line
     }
 
     if (mesh_ptr->n_dims != 2 && mesh_ptr->n_dims != 3)
         FatalError("Invalid mesh dimensionality. Expected 2D or 3D.");
 
-    mesh_file.clear();
-    mesh_file.seekg(mesh_file.beg);
+    if (gmsh_version == 4)
+        read_entities_gmsh();
+
+    // total num vertices in mesh
+    p = section_gmsh("Nodes");
+    if (gmsh_version == 4)
+        get_size_gmsh(p); //number of entity blocks
+    mesh_ptr->num_verts_global = get_size_gmsh(p);
+
+    // Rank 0 counts the global cells and indexes the element section for all processors
+    index_elements_gmsh();
+}
 
-    // Move cursor to $Nodes
-    while (1)
+void mesh_reader::index_sections_gmsh(void)
+{
+    int rank = 0;
+#ifdef _MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+
+    if (rank == 0)
+        scan_sections_gmsh();
+
+#ifdef _MPI
+    // section names are sent as one newline separated string, followed by their offsets
+    string names;
+    vector<long long> pos;
+    for (map<string, size_t>::iterator it = section_pos.begin(); it != section_pos.end(); it++)
     {
-        getline(mesh_file, str);
-        if (str.find("$Nodes") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$Nodes tag not found!");
+        names += it->first + "\n";
+        pos.push_back(it->second);
     }
+    long long n_info[4] = {(long long)names.size(), (long long)pos.size(), gmsh_version, gmsh_binary};
+    MPI_Bcast(n_info, 4, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    names.resize(n_info[0]);
+    pos.resize(n_info[1]);
+    gmsh_version = n_info[2];
+    gmsh_binary = n_info[3];
+    MPI_Bcast(&names[0], n_info[0], MPI_CHAR, 0, MPI_COMM_WORLD);
+    MPI_Bcast(pos.data(), n_info[1], MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+    {
+        size_t start = 0, stop;
+        for (size_t i = 0; i < pos.size(); i++, start = stop + 1)
+        {
+            stop = names.find('\n', start);
+            section_pos[names.substr(start, stop - start)] = pos[i];
+        }
+    }
+#endif
+}
 
-    mesh_file >> mesh_ptr->num_verts_global; // total num vertices in mesh
-
-    mesh_file.clear();
-    mesh_file.seekg(mesh_file.beg);
+void mesh_reader::scan_sections_gmsh(void)
+{
+    const char *end = map_ptr + map_size, *p = map_ptr, *q;
+    string name;
 
-    // Move cursor to $Elements
-    while (1)
+    gmsh_version = 0;
+    gmsh_binary = false;
+    // in ascii files '$' only appears in the section tags, binary data of the large sections is skipped using the block sizes
+    while ((q = (const char *)memchr(p, '$', end - p)) != NULL)
     {
-        getline(mesh_file, str);
-        if (str.find("$Elements") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$Elements tag not found!");
+        p = q + 1;
+        name = parse_word(p, end);
+        skip_line(p, end);
+        if (!name.compare(0, 3, "End"))
+            continue;
+        section_pos[name] = p - map_ptr;
+
+        if (name == "MeshFormat")
+        {
+            double version = parse_double(p, end);
+            int file_type = parse_int(p, end);
+            int data_size = parse_int(p, end);
+            gmsh_version = (int)version;
+            gmsh_binary = (file_type == 1);
+            if (gmsh_version != 2 && !(gmsh_version == 4 && version >= 4.1))
+                FatalError("Only gmsh mesh format 2.2 and 4.1 are supported");
+            if (gmsh_binary)
+            {
+                int one;
+                if (gmsh_version != 4)
+                    FatalError("Binary gmsh mesh has to be in format 4.1");
+                if (data_size != 8)
+                    FatalError("Binary gmsh mesh has to use 8 byte sizes");
+                skip_line(p, end);
+                memcpy(&one, p, sizeof(int));
+                if (one != 1)
+                    FatalError("Binary gmsh mesh has a different byte order");
+                p += sizeof(int);
+            }
+        }
+        else if (gmsh_binary && name == "Nodes")
+        {
+            long long n_blocks = get_size_gmsh(p);
+            for (int i = 0; i < 3; i++)
+                get_size_gmsh(p);
+            for (long long i = 0; i < n_blocks && p < end; i++)
+            {
+                int dim = get_int_gmsh(p);
+                get_int_gmsh(p);
+                int parametric = get_int_gmsh(p);
+                long long n = get_size_gmsh(p);
+                p += n * (1 + 3 + (parametric ? dim : 0)) * sizeof(double);
+            }
+        }
+        else if (gmsh_binary && name == "Elements")
+        {
+            long long n_blocks = get_size_gmsh(p);
+            for (int i = 0; i < 3; i++)
+                get_size_gmsh(p);
+            for (long long i = 0; i < n_blocks && p < end; i++)
+            {
+                get_int_gmsh(p);
+                get_int_gmsh(p);
+                int n_nodes = gmsh_n_nodes(get_int_gmsh(p));
+                long long n = get_size_gmsh(p);
+                if (n_nodes < 0)
+                    FatalError("gmsh element type not recognized");
+                p += n * (1 + n_nodes) * sizeof(long long);
+            }
+        }
+        else if (gmsh_binary)
+        {
+            string end_tag = "$End" + name;
+            q = (const char *)memmem(p, end - p, end_tag.c_str(), end_tag.size());
+            p = q ? q : end;
+        }
+        if (p > end)
+            FatalError("Mesh file is truncated");
     }
 
-    // Each processor first reads number of global cells
-    int n_entities, bcid2;
-    // Read number of elements and bdys
-    mesh_file >> n_entities;        // num entities in mesh
-    mesh_file.getline(buf, BUFSIZ); // clear rest of line
+    if (!gmsh_version)
+        FatalError("$MeshFormat tag not found!");
+}
+
+const char *mesh_reader::section_gmsh(string in_name)
+{
+    map<string, size_t>::iterator it = section_pos.find(in_name);
+    if (it == section_pos.end())
+        FatalError(("$" + in_name + " tag not found!").c_str());
+    return map_ptr + it->second;
+}
+
+void mesh_reader::read_entities_gmsh(void)
+{
+    const char *p = section_gmsh("Entities");
+    long long n_entities[4];
 
-    int icount = 0;
+    for (int i = 0; i < 4; i++)
+        n_entities[i] = get_size_gmsh(p);
 
-    for (int i = 0; i < n_entities; i++)
+    // points, curves, surfaces and volumes, the physical group of an entity is FLUID if any of its groups is
+    for (int dim = 0; dim < 4; dim++)
     {
-        mesh_file >> dummy >> dummy >> dummy;
-        mesh_file >> bcid2;
+        for (long long i = 0; i < n_entities[dim]; i++)
+        {
+            int tag = get_int_gmsh(p);
+            for (int j = 0; j < (dim ? 6 : 3); j++) //coordinates or bounding box
+                get_double_gmsh(p);
+            long long n_phys = get_size_gmsh(p);
+            int phys = 0;
+            for (long long j = 0; j < n_phys; j++)
+            {
+                int temp_phys = get_int_gmsh(p);
+                if (j == 0 || temp_phys == fluid_id)
+                    phys = temp_phys;
+            }
+            if (dim)
+            {
+                long long n_bound = get_size_gmsh(p);
+                for (long long j = 0; j < n_bound; j++)
+                    get_int_gmsh(p);
+            }
+            entity_phys[dim][tag] = phys;
+        }
+    }
+}
 
-        if (bcid2 == bcid) //if the element belongs to fluid physical group
-            icount++;
+void mesh_reader::index_elements_gmsh(void)
+{
+    int rank = 0;
+#ifdef _MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+
+    if (rank == 0)
+        scan_elements_gmsh();
+
+#ifdef _MPI
+    // the other ranks get the blocks instead of reading through the whole section themselves
+    long long n_blks[3] = {(long long)fluid_blocks.size(), (long long)bdy_blocks.size(), mesh_ptr->num_cells_global};
+    MPI_Bcast(n_blks, 3, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    fluid_blocks.resize(n_blks[0]);
+    bdy_blocks.resize(n_blks[1]);
+    mesh_ptr->num_cells_global = n_blks[2];
+    MPI_Bcast(fluid_blocks.data(), n_blks[0] * sizeof(gmsh_block), MPI_BYTE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(bdy_blocks.data(), n_blks[1] * sizeof(gmsh_block), MPI_BYTE, 0, MPI_COMM_WORLD);
+#endif
+}
 
-        mesh_file.getline(buf, BUFSIZ); // clear rest of line
+void mesh_reader::scan_elements_gmsh(void)
+{
+    const char *end = map_ptr + map_size, *p = section_gmsh("Elements"), *q;
+    long long icount = 0; //number of fluid cells
+    gmsh_block blk;
+
+    if (gmsh_version == 2)
+    {
+        // one element per line: id, type, number of tags, tags, nodes; the first tag is the physical group.
+        // Runs of consecutive boundary elements make up the boundary blocks, their groups are read per line
+        long long n_entities = parse_int(p, end);
+        bool in_bdy = false;
+        skip_line(p, end);
+        blk.type = -1;
+        for (long long k = 0; k < n_entities; k++)
+        {
+            q = p;
+            parse_int(p, end);
+            parse_int(p, end);
+            parse_int(p, end);
+            if (parse_int(p, end) == fluid_id)
+            {
+                if (icount % ele_block_size == 0)
+                {
+                    blk.pos = q - map_ptr;
+                    blk.phys = fluid_id;
+                    blk.n = 0;
+                    blk.first = icount;
+                    fluid_blocks.push_back(blk);
+                }
+                fluid_blocks.back().n++;
+                icount++;
+                in_bdy = false;
+            }
+            else
+            {
+                if (!in_bdy)
+                {
+                    blk.pos = q - map_ptr;
+                    blk.phys = -1;
+                    blk.n = 0;
+                    blk.first = -1;
+                    bdy_blocks.push_back(blk);
+                    in_bdy = true;
+                }
+                bdy_blocks.back().n++;
+            }
+            skip_line(p, end);
+        }
+    }
+    else
+    {
+        long long n_blocks = get_size_gmsh(p);
+        for (int i = 0; i < 3; i++)
+            get_size_gmsh(p);
+        next_line_gmsh(p);
+        for (long long i = 0; i < n_blocks; i++)
+        {
+            int dim = get_int_gmsh(p);
+            int tag = get_int_gmsh(p);
+            blk.type = get_int_gmsh(p);
+            long long n = get_size_gmsh(p);
+            next_line_gmsh(p);
+            int n_nodes = gmsh_n_nodes(blk.type);
+            if (n_nodes < 0)
+            {
+                cout << "elmtype=" << blk.type << endl;
+                FatalError("element type not recognized");
+            }
+            map<int, int>::iterator it = entity_phys[dim].find(tag);
+            blk.phys = (it == entity_phys[dim].end()) ? 0 : it->second;
+
+            if (blk.phys == fluid_id)
+            {
+                for (long long j = 0; j < n; j += ele_block_size)
+                {
+                    blk.pos = p - map_ptr;
+                    blk.n = gmsh_binary ? n : min(ele_block_size, n - j);
+                    blk.first = icount + j;
+                    fluid_blocks.push_back(blk);
+                    if (gmsh_binary)
+                        break;
+                    for (long long k = 0; k < blk.n; k++)
+                        skip_line(p, end);
+                }
+                icount += n;
+            }
+            else
+            {
+                if (blk.phys) //boundary group
+                {
+                    blk.pos = p - map_ptr;
+                    blk.n = n;
+                    blk.first = -1;
+                    bdy_blocks.push_back(blk);
+                }
+                if (!gmsh_binary)
+                    for (long long k = 0; k < n; k++)
+                        skip_line(p, end);
+            }
+            if (gmsh_binary)
+                p += n * (1 + n_nodes) * sizeof(long long);
+        }
     }
     mesh_ptr->num_cells_global = icount;
-    mesh_file.close();
+}
+
+int mesh_reader::get_int_gmsh(const char *&p)
+{
+    if (gmsh_binary)
+    {
+        int val;
+        memcpy(&val, p, sizeof(int));
+        p += sizeof(int);
+        return val;
+    }
+    return parse_int(p, map_ptr + map_size);
+}
+
+long long mesh_reader::get_size_gmsh(const char *&p)
+{
+    if (gmsh_binary)
+    {
+        long long val;
+        memcpy(&val, p, sizeof(long long));
+        p += sizeof(long long);
+        return val;
+    }
+    return parse_int(p, map_ptr + map_size);
+}
+
+double mesh_reader::get_double_gmsh(const char *&p)
+{
+    if (gmsh_binary)
+    {
+        double val;
+        memcpy(&val, p, sizeof(double));
+        p += sizeof(double);
+        return val;
+    }
+    return parse_double(p, map_ptr + map_size);
+}
+
+void mesh_reader::next_line_gmsh(const char *&p)
+{
+    if (!gmsh_binary)
+        skip_line(p, map_ptr + map_size);
 }
 
 void mesh_reader::partial_read_connectivity_gmsh(int kstart, int in_num_cells)
@@ -500,256 +948,250 @@ void mesh_reader::partial_read_connectivity_gmsh(int kstart, int in_num_cells)
     // Initialize arrays to -1
     mesh_ptr->c2v.initialize_to_value(-1);
 
-    int ntags, dummy, bcid; //bcid:id number that hold "FLUID";
-    char buf[BUFSIZ] = {""};
-    string str, bc_txt_temp;
+    const char *end = map_ptr + map_size, *p;
+    long long nodes[27];
+    int i = 0; //index of cell to read(local index)
 
-    //open file
-    mesh_file.open(fname.c_str());
-    if (!mesh_file)
-        FatalError("Unable to open mesh file");
+    // Start from the indexed block holding the first cell to read, skipping elements read by other processors
+    vector<gmsh_block>::iterator blk = upper_bound(fluid_blocks.begin(), fluid_blocks.end(), (long long)kstart,
+                                                   [](long long val, const gmsh_block &b) { return val < b.first; }) - 1;
 
-    // Move cursor to $PhysicalNames
-    while (1)
+    for (; i < in_num_cells; blk++)
     {
-        getline(mesh_file, str);
-        if (str.find("$PhysicalNames") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$PhysicalNames tag not found!");
-    }
+        long long j = kstart + i - blk->first; //index in the block of the next cell to read
+        p = map_ptr + blk->pos;
 
-    // Read number of boundaries and fields defined
-    mesh_file >> dummy;
-    mesh_file.getline(buf, BUFSIZ); // clear rest of line
-    for (int i = 0; i < mesh_ptr->n_bdy + 1; i++)
-    {
-        mesh_file >> dummy >> bcid >> bc_txt_temp;
-        bc_txt_temp.erase(bc_txt_temp.find_last_not_of(" \n\r\t") + 1);
-        bc_txt_temp.erase(bc_txt_temp.find_last_not_of("\"") + 1);
-        if (bc_txt_temp.find_first_not_of("\"") != 0)
-            bc_txt_temp.erase(bc_txt_temp.find_first_not_of("\"") - 1, 1);
-        if (bc_txt_temp == "FLUID")
-            break;
-        mesh_file.getline(buf, BUFSIZ); // clear rest of line
+        if (gmsh_version == 2)
+        {
+            for (long long k = 0; k < blk->n && i < in_num_cells; skip_line(p, end))
+            {
+                parse_int(p, end);
+                int elmtype = parse_int(p, end);
+                int ntags = parse_int(p, end);
+                int bcid = parse_int(p, end);
+                if (bcid != fluid_id) //not FLUID cell
+                    continue;
+                if (k++ < j) //FLUID cell read by another processor
+                    continue;
+                for (int tag = 0; tag < ntags - 1; tag++)//skip tags
+                    parse_int(p, end);
+                int n_nodes = gmsh_n_nodes(elmtype);
+                for (int m = 0; m < n_nodes; m++)
+                    nodes[m] = parse_int(p, end);
+                mesh_ptr->ic2icg(i) = blk->first + k - 1;
+                set_cell_gmsh(i, elmtype, nodes);
+                i++;
+            }
+        }
+        else
+        {
+            int n_nodes = gmsh_n_nodes(blk->type);
+            if (gmsh_binary)
+                p += j * (1 + n_nodes) * sizeof(long long);
+            else
+                for (long long k = 0; k < j; k++)
+                    skip_line(p, end);
+
+            for (; j < blk->n && i < in_num_cells; j++, i++)
+            {
+                get_size_gmsh(p); //element tag
+                for (int m = 0; m < n_nodes; m++)
+                    nodes[m] = get_size_gmsh(p);
+                next_line_gmsh(p);
+                mesh_ptr->ic2icg(i) = blk->first + j;
+                set_cell_gmsh(i, blk->type, nodes);
+            }
+        }
     }
+}
 
-    // Move cursor to $Elements
-    mesh_file.clear();
-    mesh_file.seekg(0, ios::beg);
+// ctype is the element type:  for HiFiLES: 0=tri, 1=quad, 2=tet, 3=prism, 4=hex
+// For Gmsh node ordering, see: http://geuz.org/gmsh/doc/texinfo/gmsh.html#Node-ordering
 
-    while (1)
+void mesh_reader::set_cell_gmsh(int in_cell, int in_elmtype, long long *in_nodes)
+{
+    // hifiles vertex slot of each gmsh node
+    static const int tri3[] = {0, 1, 2}, tri6[] = {0, 1, 2, 3, 4, 5};
+    static const int quad4[] = {0, 1, 3, 2}, quad8[] = {0, 1, 2, 3, 4, 5, 6, 7};
+    static const int tet4[] = {0, 1, 2, 3}, tet10[] = {0, 1, 2, 3, 4, 7, 5, 6, 8, 9};
+    static const int pri6[] = {0, 1, 2, 3, 4, 5}, pri15[] = {0, 1, 2, 3, 4, 5, 6, 8, 9, 7, 10, 11, 12, 14, 13};
+    static const int hex8[] = {0, 1, 3, 2, 4, 5, 7, 6}, hex20[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 11, 12, 9, 13, 10, 14, 15, 16, 19, 17, 18};
+    const int *order;
+
+    if (in_elmtype == 2 || in_elmtype == 9) // Triangle
     {
-        getline(mesh_file, str);
-        if (str.find("$Elements") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$Elements tag not found!");
+        mesh_ptr->ctype(in_cell) = TRI;
+        mesh_ptr->c2n_v(in_cell) = (in_elmtype == 2) ? 3 : 6; // linear/quadratic triangle
+        order = (in_elmtype == 2) ? tri3 : tri6;
+    }
+    else if (in_elmtype == 3 || in_elmtype == 16) // Quad
+    {
+        mesh_ptr->ctype(in_cell) = QUAD;
+        mesh_ptr->c2n_v(in_cell) = (in_elmtype == 3) ? 4 : 8; // linear/quadratic quadrangle
+        order = (in_elmtype == 3) ? quad4 : quad8;
+    }
+    else if (in_elmtype == 4 || in_elmtype == 11) // Tetrahedron
+    {
+        mesh_ptr->ctype(in_cell) = TET;
+        mesh_ptr->c2n_v(in_cell) = (in_elmtype == 4) ? 4 : 10; // linear/quadratic tet
+        order = (in_elmtype == 4) ? tet4 : tet10;
+    }
+    else if (in_elmtype == 6 || in_elmtype == 18) // prisms
+    {
+        mesh_ptr->ctype(in_cell) = PRISM;
+        mesh_ptr->c2n_v(in_cell) = (in_elmtype == 6) ? 6 : 15; // linear/15 points prism
+        order = (in_elmtype == 6) ? pri6 : pri15;
+    }
+    else if (in_elmtype == 5 || in_elmtype == 17) // Hexahedron
+    {
+        mesh_ptr->ctype(in_cell) = HEX;
+        mesh_ptr->c2n_v(in_cell) = (in_elmtype == 5) ? 8 : 20; // linear/20-node quadratic hexahedron
+        order = (in_elmtype == 5) ? hex8 : hex20;
+    }
+    else
+    {
+        cout << "elmtype=" << in_elmtype << endl;
+        FatalError("element type not recognized");
     }
 
-    int n_entities, elmtype, bcid2;
-
-    mesh_file >> n_entities;        // num entities in mesh
-    mesh_file.getline(buf, BUFSIZ); // clear rest of line
+    // Shift every values of c2v by -1 to be 0 based with -1 as nan
+    for (int k = 0; k < mesh_ptr->c2n_v(in_cell); k++)
+        mesh_ptr->c2v(in_cell, order[k]) = in_nodes[k] - 1;
+}
 
-    // Skip elements being read by other processors
-    int icount = 0; //index of fluid cell(global index)
-    int i = 0;      //index of cell to read(local index)
+void mesh_reader::read_vertices_gmsh()
+{
+    const char *end = map_ptr + map_size, *p = section_gmsh("Nodes");
+    int *iv2ivg = mesh_ptr->iv2ivg.get_ptr_cpu();
+    int n_verts = mesh_ptr->num_verts;
+    int index;
 
-    // ctype is the element type:  for HiFiLES: 0=tri, 1=quad, 2=tet, 3=prism, 4=hex
-    // For Gmsh node ordering, see: http://geuz.org/gmsh/doc/texinfo/gmsh.html#Node-ordering
+    mesh_ptr->xv.setup(mesh_ptr->num_verts, mesh_ptr->n_dims);
 
-    for (int k = 0; k < n_entities; k++)
+    if (gmsh_version == 2)
     {
-        mesh_file >> dummy >> elmtype >> ntags;
-        mesh_file >> bcid2;
-        for (int tag = 0; tag < ntags - 1; tag++)//skip tags
-            mesh_file >> dummy;
+        skip_line(p, end); //skip total vertex number
+
+        for (int i = 0; i < mesh_ptr->num_verts_global; i++)
+        {
+            index = index_locate_int(parse_int(p, end) - 1, iv2ivg, n_verts); //local index of global id
 
-        if (bcid2 == bcid) //if belong to fluid group
+            if (index != -1) // Vertex belongs to this processor
+                for (int m = 0; m < mesh_ptr->n_dims; m++)
+                    mesh_ptr->xv(index, m) = parse_double(p, end);
+            skip_line(p, end);
+        }
+    }
+    else
+    {
+        // each block lists the node tags followed by the coordinates
+        vector<pair<long long, int> > local; //position in the block and local index of the vertices of this processor
+        long long n_blocks = get_size_gmsh(p);
+        for (int i = 0; i < 3; i++)
+            get_size_gmsh(p);
+        next_line_gmsh(p);
+
+        for (long long i = 0; i < n_blocks; i++)
         {
-            if (icount >= kstart && i < in_num_cells) // if belong to the block to read
+            int dim = get_int_gmsh(p);
+            get_int_gmsh(p);
+            int parametric = get_int_gmsh(p);
+            long long n = get_size_gmsh(p);
+            int n_coords = 3 + (parametric ? dim : 0);
+            next_line_gmsh(p);
+            local.clear();
+
+            if (gmsh_binary)
             {
-                mesh_ptr->ic2icg(i) = icount;
-                if (elmtype == 2 || elmtype == 9) // Triangle
+                // consecutive tags are located by a binary search over the local vertices instead of reading every tag
+                long long first = 0, last = -1, tag;
+                bool consecutive;
+                if (n)
                 {
-                    mesh_ptr->ctype(i) = TRI;
-                    if (elmtype == 2) // linear triangle
-                    {
-                        mesh_ptr->c2n_v(i) = 3;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2);
-                    }
-                    else if (elmtype == 9) // quadratic triangle
-                    {
-                        mesh_ptr->c2n_v(i) = 6;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5);
-                    }
+                    memcpy(&first, p, sizeof(long long));
+                    memcpy(&last, p + (n - 1) * sizeof(long long), sizeof(long long));
                 }
-                else if (elmtype == 3 || elmtype == 16) // Quad
+                consecutive = (last - first == n - 1);
+                if (consecutive)
                 {
-                    mesh_ptr->ctype(i) = QUAD;
-                    if (elmtype == 3) // linear quadrangle
-                    {
-                        mesh_ptr->c2n_v(i) = 4;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 2);
-                    }
-                    else if (elmtype == 16) // quadratic quadrangle
+                    for (int *v = lower_bound(iv2ivg, iv2ivg + n_verts, (int)(first - 1)); v < iv2ivg + n_verts && *v < last; v++)
                     {
-                        mesh_ptr->c2n_v(i) = 8;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 7);
-                    }
-                }
-                else if (elmtype == 4 || elmtype == 11) // Tetrahedron
-                {
-                    mesh_ptr->ctype(i) = TET;
-                    if (elmtype == 4) // Linear tet
-                    {
-                        mesh_ptr->c2n_v(i) = 4;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3);
-                    }
-                    else if (elmtype == 11) // Quadratic tet
-                    {
-                        mesh_ptr->c2n_v(i) = 10;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4);
-                        mesh_file >> mesh_ptr->c2v(i, 7) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 8) >> mesh_ptr->c2v(i, 9);
+                        memcpy(&tag, p + (*v - first + 1) * sizeof(long long), sizeof(long long));
+                        if (tag != *v + 1)
+                        {
+                            consecutive = false;
+                            local.clear();
+                            break;
+                        }
+                        local.push_back(make_pair(*v - first + 1, (int)(v - iv2ivg)));
                     }
                 }
-                else if (elmtype == 6 || elmtype == 18) // prisms
-                {
-                    mesh_ptr->ctype(i) = PRISM;
-                    if (elmtype == 6) //linear prism
+                if (!consecutive)
+                    for (long long j = 0; j < n; j++)
                     {
-                        mesh_ptr->c2n_v(i) = 6; // linear prism
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5);
+                        memcpy(&tag, p + j * sizeof(long long), sizeof(long long));
+                        index = index_locate_int(tag - 1, iv2ivg, n_verts);
+                        if (index != -1)
+                            local.push_back(make_pair(j, index));
                     }
-                    else if (elmtype == 18) // 15 points prism
-                    {
-                        mesh_ptr->c2n_v(i) = 15;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 8) >> mesh_ptr->c2v(i, 9) >> mesh_ptr->c2v(i, 7) >> mesh_ptr->c2v(i, 10) >> mesh_ptr->c2v(i, 11) >> mesh_ptr->c2v(i, 12) >> mesh_ptr->c2v(i, 14) >> mesh_ptr->c2v(i, 13);
-                    }
-                }
-                else if (elmtype == 5 || elmtype == 12) // Hexahedron
+                p += n * sizeof(long long);
+
+                for (size_t j = 0; j < local.size(); j++)
+                    for (int m = 0; m < mesh_ptr->n_dims; m++)
+                        memcpy(mesh_ptr->xv.get_ptr_cpu(local[j].second, m), p + (local[j].first * n_coords + m) * sizeof(double), sizeof(double));
+                p += n * n_coords * sizeof(double);
+            }
+            else
+            {
+                for (long long j = 0; j < n; j++)
                 {
-                    mesh_ptr->ctype(i) = HEX;
-                    if (elmtype == 5) // linear quadrangle
-                    {
-                        mesh_ptr->c2n_v(i) = 8;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 2);
-                        mesh_file >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 7) >> mesh_ptr->c2v(i, 6);
-                    }
-                    else if (elmtype == 17) // 20-node quadratic hexahedron
-                    {
-                        mesh_ptr->c2n_v(i) = 20;
-                        mesh_file >> mesh_ptr->c2v(i, 0) >> mesh_ptr->c2v(i, 1) >> mesh_ptr->c2v(i, 2) >> mesh_ptr->c2v(i, 3) >> mesh_ptr->c2v(i, 4) >> mesh_ptr->c2v(i, 5) >> mesh_ptr->c2v(i, 6) >> mesh_ptr->c2v(i, 7) >> mesh_ptr->c2v(i, 8) >> mesh_ptr->c2v(i, 11) >> mesh_ptr->c2v(i, 12) >> mesh_ptr->c2v(i, 9) >> mesh_ptr->c2v(i, 13) >> mesh_ptr->c2v(i, 10) >> mesh_ptr->c2v(i, 14) >> mesh_ptr->c2v(i, 15) >> mesh_ptr->c2v(i, 16) >> mesh_ptr->c2v(i, 19) >> mesh_ptr->c2v(i, 17) >> mesh_ptr->c2v(i, 18);
-                    }
+                    index = index_locate_int(parse_int(p, end) - 1, iv2ivg, n_verts);
+                    if (index != -1)
+                        local.push_back(make_pair(j, index));
+                    skip_line(p, end);
                 }
-                else
+
+                long long j = 0;
+                for (size_t k = 0; k < local.size(); k++)
                 {
-                    cout << "elmtype=" << elmtype << endl;
-                    FatalError("element type not recognized");
+                    for (; j < local[k].first; j++)
+                        skip_line(p, end);
+                    for (int m = 0; m < mesh_ptr->n_dims; m++)
+                        mesh_ptr->xv(local[k].second, m) = parse_double(p, end);
+                    skip_line(p, end);
+                    j++;
                 }
-
-                // Shift every values of c2v by -1 to be 0 based with -1 as nan
-                for (int k = 0; k < mesh_ptr->c2n_v(i); k++)
-                        mesh_ptr->c2v(i, k)--;
-
-                i++;
-                mesh_file.getline(buf, BUFSIZ); // skip end of line
-            }
-            else //
-            {
-                mesh_file.getline(buf, BUFSIZ); // skip line, cell doesn't belong to this processor
+                for (; j < n; j++)
+                    skip_line(p, end);
             }
-            icount++; // FLUID cell, increase icount
         }
-        else // Not FLUID cell, skip line
-        {
-            mesh_file.getline(buf, BUFSIZ); // skip line, cell doesn't belong to this processor
-        }
-
-    } // End of loop over entities
-
-    mesh_file.close();
-}
-
-void mesh_reader::read_vertices_gmsh()
-{
-    string str;
-    char buf[BUFSIZ] = {""};
-
-    mesh_file.open(fname.c_str());
-
-    if (!mesh_file)
-        FatalError("Could not open mesh file");
-
-    // Move cursor to $Nodes
-    while (1)
-    {
-        getline(mesh_file, str);
-        if (str.find("$Nodes") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$Nodes tag not found!");
     }
-
-    mesh_file.getline(buf, BUFSIZ); //skip total vertex number
-
-    int id;
-    int index;
-    mesh_ptr->xv.setup(mesh_ptr->num_verts, mesh_ptr->n_dims);
-
-    for (int i = 0; i < mesh_ptr->num_verts_global; i++)
-    {
-        mesh_file >> id;//global id
-        index = index_locate_int(id - 1, mesh_ptr->iv2ivg.get_ptr_cpu(), mesh_ptr->num_verts);//local index
-
-        if (index != -1) // Vertex belongs to this processor
-            for (int m = 0; m < mesh_ptr->n_dims; m++)
-                mesh_file >> mesh_ptr->xv(index, m);
-        mesh_file.getline(buf, BUFSIZ);
-    }
-
-    mesh_file.close();
 }
 
 void mesh_reader::read_boundary_gmsh(void)
 {
-    string str;
-
-    mesh_file.open(fname.c_str());
-    if (!mesh_file)
-        FatalError("Unable to open mesh file");
-
-    // Move cursor to $PhysicalNames
-    while (1)
-    {
-        getline(mesh_file, str);
-        if (str.find("$PhysicalNames") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$PhysicalNames tag not found!");
-    }
+    const char *end = map_ptr + map_size, *p = section_gmsh("PhysicalNames");
 
     // Read number of boundaries and fields defined
-    int id, dummy, n_bcs;
-    int elmtype, ntags, bcid, bcdim;
-    char buf[BUFSIZ] = {""};
+    int n_bcs;
+    int elmtype, ntags, bcid, num_face_vert;
     string bc_txt_temp;
-    int fluid_id; //id of fluid group
 
     mesh_ptr->bc_id.setup(mesh_ptr->num_cells, MAX_F_PER_C);
     mesh_ptr->bc_id.initialize_to_value(-1);//-1 as default internal face
     run_input.bc_list.setup(mesh_ptr->n_bdy);
 
-    mesh_file >> n_bcs;
+    n_bcs = parse_int(p, end);
     map<int,int> temp_bcid;
-    mesh_file.getline(buf, BUFSIZ); // clear rest of line
+    skip_line(p, end); // clear rest of line
     int bc_counter = 0;
 
     for (int i = 0; i < n_bcs; i++)//read physical groups
     {
-        mesh_file >> bcdim >> bcid >> bc_txt_temp;//bcid is 1 based
-        mesh_file.getline(buf, BUFSIZ); //clear the rest of line
+        parse_int(p, end);
+        bcid = parse_int(p, end); //bcid is 1 based
+        bc_txt_temp = parse_word(p, end);
+        skip_line(p, end); //clear the rest of line
         bc_txt_temp.erase(bc_txt_temp.find_last_not_of(" \n\r\t") + 1);
         bc_txt_temp.erase(bc_txt_temp.find_last_not_of("\"") + 1);
         if(bc_txt_temp.find_first_not_of("\"")!=0)
@@ -760,132 +1202,341 @@ void mesh_reader::read_boundary_gmsh(void)
             temp_bcid[bcid] = bc_counter;
             bc_counter++;
         }
-        else
+    }
+
+    hf_array<int> vlist_bound;
+
+    if (gmsh_version == 2)
+    {
+        // only the runs of boundary elements indexed by rank 0 are read, the fluid elements in between are skipped
+        for (size_t i = 0; i < bdy_blocks.size(); i++)
         {
-            fluid_id = bcid;
+            p = map_ptr + bdy_blocks[i].pos;
+            for (long long k = 0; k < bdy_blocks[i].n; k++, skip_line(p, end))
+            {
+                parse_int(p, end);
+                elmtype = parse_int(p, end);
+                ntags = parse_int(p, end);
+                bcid = parse_int(p, end);
+
+                for (int tag = 0; tag < ntags - 1; tag++)//skip tags
+                    parse_int(p, end);
+
+                num_face_vert = gmsh_n_face_verts(elmtype);
+                if (!num_face_vert)
+                {
+                    cout << "Gmsh boundary element type: " << elmtype << endl;
+                    FatalError("Boundary elmtype not recognized");
+                }
+
+                // Read the corner vertices, shift by -1 (1-indexed -> 0-indexed)
+                vlist_bound.setup(num_face_vert);
+                for (int j = 0; j < num_face_vert; j++)
+                    vlist_bound(j) = parse_int(p, end) - 1;
+
+                set_bdy_face(vlist_bound, temp_bcid.find(bcid)->second);
+            }
         }
     }
+    else
+    {
+        for (size_t i = 0; i < bdy_blocks.size(); i++)
+        {
+            num_face_vert = gmsh_n_face_verts(bdy_blocks[i].type);
+            if (!num_face_vert)
+            {
+                cout << "Gmsh boundary element type: " << bdy_blocks[i].type << endl;
+                FatalError("Boundary elmtype not recognized");
+            }
+            int n_nodes = gmsh_n_nodes(bdy_blocks[i].type);
+            int bc = temp_bcid.find(bdy_blocks[i].phys)->second;
 
-    mesh_file.clear();
-    mesh_file.seekg(mesh_file.beg);
+            p = map_ptr + bdy_blocks[i].pos;
+            vlist_bound.setup(num_face_vert);
+            for (long long k = 0; k < bdy_blocks[i].n; k++)
+            {
+                get_size_gmsh(p); //element tag
+                for (int j = 0; j < n_nodes; j++)
+                {
+                    long long node = get_size_gmsh(p);
+                    if (j < num_face_vert)
+                        vlist_bound(j) = node - 1;
+                }
+                next_line_gmsh(p);
 
-    // Move cursor to $Elements
-    while (1)
-    {
-        getline(mesh_file, str);
-        if (str.find("$Elements") != string::npos)
-            break;
-        if (mesh_file.eof())
-            FatalError("$Elements tag not found!");
+                set_bdy_face(vlist_bound, bc);
+            }
+        }
     }
+}
 
-    // Each processor reads number of entities
-    int n_entities;
-    // Read number of elements and bdys
-    mesh_file >> n_entities;        // num cells in mesh
-    mesh_file.getline(buf, BUFSIZ); // clear rest of line
-    
+void mesh_reader::set_bdy_face(hf_array<int> &in_vlist, int in_bc)
+{
+    int num_face_vert = in_vlist.get_dim(0);
     int num_v_per_f;
-    int num_face_vert;
-    hf_array<int> vlist_bound,vlist_cell;
+    hf_array<int> vlist_cell;
 
-    for (int i = 0; i < n_entities; i++) //bc_face list
+    // Check if all vertices belong to processor
+    for (int j = 0; j < num_face_vert; j++)
     {
-        mesh_file >> id >> elmtype >> ntags;
-        mesh_file >> bcid;
-        for (int tag = 0; tag < ntags - 1; tag++)//skip tags
-            mesh_file >> dummy;
+        in_vlist(j) = index_locate_int(in_vlist(j), mesh_ptr->iv2ivg.get_ptr_cpu(), mesh_ptr->num_verts);
+        if (in_vlist(j) == -1)
+            return;
+    }
 
-        if (bcid == fluid_id)//belong to fluid,skip
+    // All vertices on face belong to processor
+    // Try to find the cell that they belong to
+    // loop over the vertex on the face to find out the common cell they share
+    vector<int> intersection = mesh_ptr->v2c(in_vlist(0));
+    std::vector<int>::iterator it_intersect;
+    for (int i = 1; i < num_face_vert; i++)
+    {
+        it_intersect = set_intersection(mesh_ptr->v2c(in_vlist(i)).begin(), mesh_ptr->v2c(in_vlist(i)).end(), intersection.begin(), intersection.end(), intersection.begin()); //get the intersection of 2 sorted data
+        intersection.resize(it_intersect - intersection.begin());
+    }
+    if (intersection.size() == 1) //only cell
+    {
+        for (int k = 0; k < mesh_ptr->num_f_per_c(mesh_ptr->ctype(intersection[0])); k++)
         {
-            mesh_file.getline(buf, BUFSIZ); // skip line
-            continue;
+            // Get local vertices of local face k of cell ic
+            num_v_per_f = mesh_ptr->get_corner_vlist_face(intersection[0], k, vlist_cell);
+
+            if (num_v_per_f == num_face_vert)
+            {
+                if (mesh_ptr->compare_faces_boundary(in_vlist, vlist_cell))
+                {
+                    mesh_ptr->bc_id(intersection[0], k) = in_bc;
+                    break;
+                }
+            }
         }
+    }
+    else if (intersection.size() > 1)
+    {
+        FatalError("2 cell sharing a boundary face");
+    }
+}
+
+/*------------------------------box generator----------------------------*/
+//the box is a lattice of n_x*n_y(*n_z) cubes split into cells. Cells and vertices follow from their global index,
+//so each rank generates its own block of cells and the vertices it needs without reading anything
 
-        if (elmtype == 1 || elmtype == 8) // first and second order Edge
+//corners of a cube are numbered x+2y+4z, which is the vertex order of quads and hexes. Prisms/tris split the
+//cube along the 0-3 diagonal and tets along the 0-7 diagonal (Kuhn split), so the faces of neighbouring cubes
+//match. The tet vertices are ordered to give a positive volume
+static const int box_hex[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+static const int box_pri[2][6] = {{0, 1, 3, 4, 5, 7}, {0, 3, 2, 4, 7, 6}};
+static const int box_tet[6][4] = {{0, 1, 3, 7}, {0, 5, 1, 7}, {0, 3, 2, 7}, {0, 2, 6, 7}, {0, 4, 5, 7}, {0, 6, 4, 7}};
+
+static const char *box_side_names[6] = {"xmin", "xmax", "ymin", "ymax", "zmin", "zmax"};
+
+//uniform pseudo random number in [-1,1) hashed from an integer key (splitmix64 finalizer)
+
+static inline double hash_uniform(unsigned long long in_key)
+{
+    in_key += 0x9E3779B97F4A7C15ULL;
+    in_key = (in_key ^ (in_key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    in_key = (in_key ^ (in_key >> 27)) * 0x94D049BB133111EBULL;
+    in_key ^= in_key >> 31;
+    return (double)(in_key >> 11) * (2. / 9007199254740992.) - 1.;
+}
+
+void mesh_reader::read_header_box(void)
+{
+    static const char *type_names[2][4] = {{"quad", "tri", "", "mixed"}, {"hex", "prism", "tet", "mixed"}};
+
+    mesh_ptr->n_dims = run_input.box_n.get_dim(0);
+    if (mesh_ptr->n_dims != 2 && mesh_ptr->n_dims != 3)
+        FatalError("box_n needs 2 or 3 entries");
+    mesh_ptr->n_ele_dims = mesh_ptr->n_dims;
+
+    box_type = -1;
+    for (int i = 0; i < 4; i++)
+        if (*type_names[mesh_ptr->n_dims - 2][i] && run_input.box_ele_type == type_names[mesh_ptr->n_dims - 2][i])
+            box_type = i;
+    if (box_type == -1)
+        FatalError("box_ele_type not recognized, use hex, prism, tet or mixed in 3D and quad, tri or mixed in 2D");
+
+    for (int m = 0; m < 3; m++)
+    {
+        if (m < mesh_ptr->n_dims)
         {
-            num_face_vert = 2;
-            vlist_bound.setup(num_face_vert);
-            // Read the two vertices
-            mesh_file >> vlist_bound(0) >> vlist_bound(1);
+            box_n[m] = run_input.box_n(m);
+            box_min[m] = run_input.box_min.get_dim(0) ? run_input.box_min(m) : 0.;
+            box_max[m] = run_input.box_max.get_dim(0) ? run_input.box_max(m) : 1.;
+            box_periodic[m] = run_input.box_periodic.get_dim(0) ? run_input.box_periodic(m) : 1;
+            if (box_n[m] < 1 || box_max[m] <= box_min[m])
+                FatalError("Empty box");
         }
-        else if (elmtype == 3 || elmtype == 16) // first and second order Quad face
+        else //one layer of cubes in 2D
         {
-            num_face_vert = 4;
-            vlist_bound.setup(num_face_vert);
+            box_n[m] = 1;
+            box_periodic[m] = 0;
+        }
+    }
+    if ((run_input.box_min.get_dim(0) && run_input.box_min.get_dim(0) != mesh_ptr->n_dims) ||
+        (run_input.box_max.get_dim(0) && run_input.box_max.get_dim(0) != mesh_ptr->n_dims) ||
+        (run_input.box_periodic.get_dim(0) && run_input.box_periodic.get_dim(0) != mesh_ptr->n_dims))
+        FatalError("box_min, box_max and box_periodic need as many entries as box_n");
+
+    //mixed boxes are hexes/quads in the lower half of x and prisms/tris in the upper half
+    int n_hex = (box_type == 0) ? box_n[0] : ((box_type == 3) ? box_n[0] / 2 : 0);
+    long long n_cells = n_hex + (box_type == 2 ? 6 : 2) * (long long)(box_n[0] - n_hex);
+    box_cells_per_row = n_cells;
+    n_cells *= (long long)box_n[1] * box_n[2];
+    long long n_verts = (long long)(box_n[0] + 1) * (box_n[1] + 1) * (mesh_ptr->n_dims == 3 ? box_n[2] + 1 : 1);
+    if (n_cells > 2147483647LL || n_verts > 2147483647LL)
+        FatalError("Too many cells in the box");
+    mesh_ptr->num_cells_global = n_cells;
+    mesh_ptr->num_verts_global = n_verts;
+
+    //one cyclic group for all the periodic sides, one group for each other side
+    mesh_ptr->n_bdy = (box_periodic[0] || box_periodic[1] || box_periodic[2]) ? 1 : 0;
+    for (int s = 0; s < 2 * mesh_ptr->n_dims; s++)
+        box_bc[s] = box_periodic[s / 2] ? 0 : mesh_ptr->n_bdy++;
+}
 
-            mesh_file >> vlist_bound(0) >> vlist_bound(1) >> vlist_bound(2) >> vlist_bound(3);
+void mesh_reader::get_cell_box(int in_icg, int *out_ijk, int &out_sub, int &out_ctype)
+{
+    int n_hex = (box_type == 0) ? box_n[0] : ((box_type == 3) ? box_n[0] / 2 : 0);
+    int row = in_icg / box_cells_per_row, r = in_icg % box_cells_per_row;
+
+    if (r < n_hex)
+    {
+        out_ijk[0] = r;
+        out_sub = 0;
+        out_ctype = (mesh_ptr->n_dims == 3) ? HEX : QUAD;
+    }
+    else
+    {
+        int n_sub = (box_type == 2) ? 6 : 2;
+        out_ijk[0] = n_hex + (r - n_hex) / n_sub;
+        out_sub = (r - n_hex) % n_sub;
+        out_ctype = (box_type == 2) ? TET : ((mesh_ptr->n_dims == 3) ? PRISM : TRI);
+    }
+    out_ijk[1] = row % box_n[1];
+    out_ijk[2] = row / box_n[1];
+}
+
+void mesh_reader::get_vert_box(int in_ivg, int *out_ijk)
+{
+    out_ijk[0] = in_ivg % (box_n[0] + 1);
+    in_ivg /= box_n[0] + 1;
+    out_ijk[1] = in_ivg % (box_n[1] + 1);
+    out_ijk[2] = in_ivg / (box_n[1] + 1);
+}
+
+void mesh_reader::partial_read_connectivity_box(int kstart, int in_num_cells)
+{
+    //allocate memory
+    mesh_ptr->c2v.setup(in_num_cells, MAX_V_PER_C);
+    mesh_ptr->c2n_v.setup(in_num_cells);
+    mesh_ptr->ctype.setup(in_num_cells);
+    mesh_ptr->ic2icg.setup(in_num_cells);
+
+    // Initialize arrays to -1
+    mesh_ptr->c2v.initialize_to_value(-1);
+
+    int ijk[3], sub, ctype, n_v, c;
+    const int *corners;
+    for (int i = 0; i < in_num_cells; i++)
+    {
+        mesh_ptr->ic2icg(i) = kstart + i;
+        get_cell_box(kstart + i, ijk, sub, ctype);
+        mesh_ptr->ctype(i) = ctype;
+        if (ctype == QUAD || ctype == HEX)
+        {
+            corners = box_hex;
+            n_v = (ctype == HEX) ? 8 : 4;
         }
-        else if (elmtype == 2 || elmtype == 9) // first and second order tri face
+        else if (ctype == TRI || ctype == PRISM)
         {
-            num_face_vert = 3;
-            vlist_bound.setup(num_face_vert);
-
-            mesh_file >> vlist_bound(0) >> vlist_bound(1) >> vlist_bound(2);
+            corners = box_pri[sub]; //tris are the bottom of the prisms
+            n_v = (ctype == PRISM) ? 6 : 3;
         }
         else
         {
-            cout << "Gmsh boundary element type: " << elmtype << endl;
-            FatalError("Boundary elmtype not recognized");
+            corners = box_tet[sub];
+            n_v = 4;
         }
+        mesh_ptr->c2n_v(i) = n_v;
 
-        // Shift by -1 (1-indexed -> 0-indexed)
-        for (int j = 0; j < num_face_vert; j++)
+        for (int k = 0; k < n_v; k++)
         {
-            vlist_bound(j)--;
+            c = corners[k];
+            mesh_ptr->c2v(i, k) = (ijk[0] + (c & 1)) + (box_n[0] + 1) * ((ijk[1] + ((c >> 1) & 1)) + (box_n[1] + 1) * (ijk[2] + (c >> 2)));
         }
+    }
+}
+
+// vertices are displaced by up to box_perturb cell sizes, the sides of the box stay flat. The displacement is
+// hashed from the seed and the lattice index wrapped in the periodic directions, so it does not depend on the
+// number of ranks and both vertices of a cyclic pair move alike
+
+void mesh_reader::read_vertices_box(void)
+{
+    int ijk[3];
+    unsigned long long key;
+    double h[3];
+
+    for (int m = 0; m < mesh_ptr->n_dims; m++)
+        h[m] = (box_max[m] - box_min[m]) / box_n[m];
 
-        mesh_file.getline(buf, BUFSIZ); // Get rest of line
+    mesh_ptr->xv.setup(mesh_ptr->num_verts, mesh_ptr->n_dims);
+    for (int i = 0; i < mesh_ptr->num_verts; i++)
+    {
+        get_vert_box(mesh_ptr->iv2ivg(i), ijk);
+        key = run_input.box_seed;
+        for (int m = 0; m < mesh_ptr->n_dims; m++)
+            key = key * 2147483647ULL + (box_periodic[m] ? ijk[m] % box_n[m] : ijk[m]);
 
-        // Check if all vertices belong to processor
-        bool belong_to_proc = true;
-        for (int j = 0; j < num_face_vert; j++)
+        for (int m = 0; m < mesh_ptr->n_dims; m++)
         {
-            vlist_bound(j) = index_locate_int(vlist_bound(j), mesh_ptr->iv2ivg.get_ptr_cpu(), mesh_ptr->num_verts);
-            if (vlist_bound(j) == -1)
-            {
-                belong_to_proc = false;
-                break;
-            }
+            mesh_ptr->xv(i, m) = box_min[m] + ijk[m] * h[m];
+            if (run_input.box_perturb != 0. && ijk[m] > 0 && ijk[m] < box_n[m])
+                mesh_ptr->xv(i, m) += run_input.box_perturb * h[m] * hash_uniform(key * 3 + m);
         }
+    }
+}
 
-        if (belong_to_proc)
+void mesh_reader::read_boundary_box(void)
+{
+    mesh_ptr->bc_id.setup(mesh_ptr->num_cells, MAX_F_PER_C);
+    mesh_ptr->bc_id.initialize_to_value(-1);//-1 as default internal face
+    run_input.bc_list.setup(mesh_ptr->n_bdy);
+    for (int s = 0; s < 2 * mesh_ptr->n_dims; s++)
+        run_input.bc_list(box_bc[s]).setup(box_periodic[s / 2] ? "periodic" : box_side_names[s]);
+
+    //the periodic sides are one box length apart
+    if (box_periodic[0])
+        run_input.dx_cyclic = box_max[0] - box_min[0];
+    if (box_periodic[1])
+        run_input.dy_cyclic = box_max[1] - box_min[1];
+    if (box_periodic[2])
+        run_input.dz_cyclic = box_max[2] - box_min[2];
+
+    //a face is on a side when all its corners are
+    hf_array<int> vlist;
+    int ijk[3], on_side[6], n_v;
+    for (int ic = 0; ic < mesh_ptr->num_cells; ic++)
+    {
+        for (int k = 0; k < mesh_ptr->num_f_per_c(mesh_ptr->ctype(ic)); k++)
         {
-            // All vertices on face belong to processor
-            // Try to find the cell that they belong to
-            // loop over the vertex on the face to find out the common cell they share
-            vector<int> intersection = mesh_ptr->v2c(vlist_bound(0));
-            std::vector<int>::iterator it_intersect;
-            for (int i = 1; i < num_face_vert; i++)
+            n_v = mesh_ptr->get_corner_vlist_face(ic, k, vlist);
+            for (int s = 0; s < 2 * mesh_ptr->n_dims; s++)
+                on_side[s] = 1;
+            for (int v = 0; v < n_v; v++)
             {
-                it_intersect = set_intersection(mesh_ptr->v2c(vlist_bound(i)).begin(), mesh_ptr->v2c(vlist_bound(i)).end(), intersection.begin(), intersection.end(), intersection.begin()); //get the intersection of 2 sorted data
-                intersection.resize(it_intersect - intersection.begin());
-            }
-            if (intersection.size() == 1) //only cell
-            {
-                for (int k = 0; k < mesh_ptr->num_f_per_c(mesh_ptr->ctype(intersection[0])); k++)
+                get_vert_box(mesh_ptr->iv2ivg(vlist(v)), ijk);
+                for (int m = 0; m < mesh_ptr->n_dims; m++)
                 {
-                    // Get local vertices of local face k of cell ic
-                    num_v_per_f = mesh_ptr->get_corner_vlist_face(intersection[0], k, vlist_cell);
-
-                    if (num_v_per_f == num_face_vert)
-                    {
-                        if (mesh_ptr->compare_faces_boundary(vlist_bound, vlist_cell))
-                        {
-                            mesh_ptr->bc_id(intersection[0], k) = temp_bcid.find(bcid)->second;
-                            break;
-                        }
-                    }
+                    on_side[2 * m] &= (ijk[m] == 0);
+                    on_side[2 * m + 1] &= (ijk[m] == box_n[m]);
                 }
             }
-            else if (intersection.size() > 1)
-            {
-                FatalError("2 cell sharing a boundary face");
-            }
-
-            } // If all vertices belong to processor
-
-        } // Loop over entities
-
-        mesh_file.close();
-    }
\ No newline at end of file
+            for (int s = 0; s < 2 * mesh_ptr->n_dims; s++)
+                if (on_side[s])
+                    mesh_ptr->bc_id(ic, k) = box_bc[s];
+        }
+    }
+}
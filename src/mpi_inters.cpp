@@ -29,6 +29,7 @@
 #include "../include/solver.h"
 #include "../include/output.h"
 #include "../include/flux.h"
+#include "../include/timer.h"
 
 #if defined _GPU
 #include "../include/cuda_kernels.h"
@@ -40,7 +41,11 @@ using namespace std;
 
 // default constructor
 
-mpi_inters::mpi_inters() { }
+mpi_inters::mpi_inters()
+{
+  for (int e=0;e<N_COMM_EXCHANGES;e++)
+    n_pending[e]=0;
+}
 
 mpi_inters::~mpi_inters() { }
 
@@ -106,6 +111,8 @@ void mpi_inters::set_nout_proc(int in_nout,int in_p)
 
 void mpi_inters::set_mpi_requests(int in_number_of_requests)
 {
+  request_proc.setup(in_number_of_requests);
+  done_index.setup(in_number_of_requests);
   mpi_in_requests.setup(in_number_of_requests);
   mpi_out_requests.setup(in_number_of_requests);
   if (viscous)
@@ -248,12 +255,19 @@ void mpi_inters::send_solution()
 #ifdef _MPI
               MPI_Isend(out_buffer_disu.get_ptr_cpu(sk),Nout,MPI_DOUBLE,p,inters_type*nproc+p   ,MPI_COMM_WORLD,&mpi_out_requests[request_count]);
               MPI_Irecv(in_buffer_disu.get_ptr_cpu(sk),Nout,MPI_DOUBLE,p,inters_type*nproc+rank,MPI_COMM_WORLD,&mpi_in_requests[request_count]);
+              request_proc(request_count)=p;
+              if (run_comm.is_active())
+                run_comm.add_message(CE_SOLUTION,p,Nout*sizeof(double));
 #endif
               sk+=Nout;
               Nmess++;
               request_count++;
             }
         }
+#ifdef _MPI
+      post_time[CE_SOLUTION] = std::chrono::steady_clock::now();
+      n_pending[CE_SOLUTION] = Nmess;
+#endif
 
     }
 }
@@ -264,8 +278,7 @@ void mpi_inters::receive_solution()
   if (n_inters!=0) {
       // Receive in_buffer
 #ifdef _MPI
-      MPI_Waitall(Nmess,mpi_in_requests.get_ptr_cpu(),MPI_STATUSES_IGNORE);
-      MPI_Waitall(Nmess,mpi_out_requests.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+      wait_exchange(CE_SOLUTION,mpi_in_requests,mpi_out_requests);
 #endif
 #ifdef _GPU
       in_buffer_disu.cp_cpu_gpu();
@@ -310,12 +323,19 @@ void mpi_inters::send_corrected_gradient()
 #ifdef _MPI
               MPI_Isend(out_buffer_grad_disu.get_ptr_cpu(sk),Nout,MPI_DOUBLE,p,inters_type*nproc+3*nproc+p   ,MPI_COMM_WORLD,&mpi_out_requests_grad[request_count]);
               MPI_Irecv(in_buffer_grad_disu.get_ptr_cpu(sk),Nout,MPI_DOUBLE,p,inters_type*nproc+3*nproc+rank,MPI_COMM_WORLD,&mpi_in_requests_grad[request_count]);
+              request_proc(request_count)=p;
+              if (run_comm.is_active())
+                run_comm.add_message(CE_GRADIENT,p,Nout*sizeof(double));
 #endif
               sk+=Nout;
               Nmess++;
               request_count++;
             }
         }
+#ifdef _MPI
+      post_time[CE_GRADIENT] = std::chrono::steady_clock::now();
+      n_pending[CE_GRADIENT] = Nmess;
+#endif
     }
 
 }
@@ -325,8 +345,7 @@ void mpi_inters::receive_corrected_gradient()
   if (n_inters!=0)
     {
 #ifdef _MPI
-      MPI_Waitall(Nmess,mpi_in_requests_grad.get_ptr_cpu(),MPI_STATUSES_IGNORE);
-      MPI_Waitall(Nmess,mpi_out_requests_grad.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+      wait_exchange(CE_GRADIENT,mpi_in_requests_grad,mpi_out_requests_grad);
 #endif
 #ifdef _GPU
       in_buffer_grad_disu.cp_cpu_gpu();
@@ -371,12 +390,19 @@ void mpi_inters::send_sgsf_fpts()
 #ifdef _MPI
               MPI_Isend(out_buffer_sgsf.get_ptr_cpu(sk),Nout,MPI_DOUBLE,p,inters_type*nproc+6*nproc+p   ,MPI_COMM_WORLD,&mpi_out_requests_sgsf[request_count]);
               MPI_Irecv(in_buffer_sgsf.get_ptr_cpu(sk),Nout,MPI_DOUBLE,p,inters_type*nproc+6*nproc+rank,MPI_COMM_WORLD,&mpi_in_requests_sgsf[request_count]);
+              request_proc(request_count)=p;
+              if (run_comm.is_active())
+                run_comm.add_message(CE_SGSF,p,Nout*sizeof(double));
 #endif
               sk+=Nout;
               Nmess++;
               request_count++;
             }
         }
+#ifdef _MPI
+      post_time[CE_SGSF] = std::chrono::steady_clock::now();
+      n_pending[CE_SGSF] = Nmess;
+#endif
     }
 
 }
@@ -386,8 +412,7 @@ void mpi_inters::receive_sgsf_fpts()
   if (n_inters!=0)
     {
 #ifdef _MPI
-      MPI_Waitall(Nmess,mpi_in_requests_sgsf.get_ptr_cpu(),MPI_STATUSES_IGNORE);
-      MPI_Waitall(Nmess,mpi_out_requests_sgsf.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+      wait_exchange(CE_SGSF,mpi_in_requests_sgsf,mpi_out_requests_sgsf);
 #endif
 #ifdef _GPU
       in_buffer_sgsf.cp_cpu_gpu();
@@ -396,6 +421,72 @@ void mpi_inters::receive_sgsf_fpts()
 
 }
 
+// wait for the receives and sends of one exchange. While profiling, the receives complete one by one so the time
+// from posting to the arrival of each neighbor's message is known. Messages that arrived during the compute
+// before the wait were already recorded by poll_exchanges at the end of the stage they arrived in
+
+void mpi_inters::wait_exchange(int in_exchange, hf_array<MPI_Request> &in_requests, hf_array<MPI_Request> &out_requests)
+{
+#ifdef _MPI
+  scoped_timer timer(T_MPI_WAIT);
+  if (!run_comm.is_active())
+    {
+      MPI_Waitall(Nmess,in_requests.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+      MPI_Waitall(Nmess,out_requests.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+      return;
+    }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int n_out;
+  while (n_pending[in_exchange] > 0)
+    {
+      MPI_Waitsome(Nmess,in_requests.get_ptr_cpu(),&n_out,done_index.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+      if (n_out == MPI_UNDEFINED)
+        break;
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - post_time[in_exchange]).count();
+      for (int i=0;i<n_out;i++)
+        run_comm.add_completion(in_exchange,request_proc(done_index(i)),elapsed);
+      n_pending[in_exchange] -= n_out;
+    }
+  n_pending[in_exchange] = 0;
+  MPI_Waitall(Nmess,out_requests.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  run_comm.add_wait(in_exchange,std::chrono::duration<double>(start - post_time[in_exchange]).count(),
+                    std::chrono::duration<double>(end - start).count());
+#endif
+}
+
+void mpi_inters::poll_exchanges(void)
+{
+#ifdef _MPI
+  if (n_inters==0 || !run_comm.is_active())
+    return;
+
+  if (n_pending[CE_SOLUTION])
+    test_arrivals(CE_SOLUTION,mpi_in_requests);
+  if (n_pending[CE_GRADIENT])
+    test_arrivals(CE_GRADIENT,mpi_in_requests_grad);
+  if (n_pending[CE_SGSF])
+    test_arrivals(CE_SGSF,mpi_in_requests_sgsf);
+#endif
+}
+
+// completed receives are set to MPI_REQUEST_NULL, so the wait at the end of the exchange skips them
+
+void mpi_inters::test_arrivals(int in_exchange, hf_array<MPI_Request> &in_requests)
+{
+#ifdef _MPI
+  int n_out;
+  MPI_Testsome(Nmess,in_requests.get_ptr_cpu(),&n_out,done_index.get_ptr_cpu(),MPI_STATUSES_IGNORE);
+  if (n_out == MPI_UNDEFINED || n_out == 0)
+    return;
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - post_time[in_exchange]).count();
+  for (int i=0;i<n_out;i++)
+    run_comm.add_completion(in_exchange,request_proc(done_index(i)),elapsed);
+  n_pending[in_exchange] -= n_out;
+#endif
+}
+
 // calculate normal transformed continuous inviscid flux at the flux points at mpi faces
 void mpi_inters::calculate_common_invFlux(void)
 {
@@ -23,7 +23,11 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <cstdint>
+#include <iomanip>
 #include <cmath>
+#include <algorithm>
 #include <dirent.h>
 
 // Used for making sub-directories
@@ -39,11 +43,17 @@
 #include "../include/eles_pris.h"
 #include "../include/int_inters.h"
 #include "../include/bdy_inters.h"
+#include "../include/timer.h"
+#include "../include/reduction.h"
 
 #ifdef _HDF5
 #include "hdf5.h"
 #endif
 
+#ifdef _ZLIB
+#include "zlib.h"
+#endif
+
 #ifdef _GPU
 #include "../include/util.h"
 #endif
@@ -57,13 +67,196 @@ using namespace std;
 output::output(struct solution *in_sol)
 {
   FlowSol = in_sol;
+  out_time = FlowSol->time;
 #ifdef _CGNS
   if (run_input.write_type == 2) //initialize cgns parameter
     setup_CGNS();
 #endif
+#ifdef _HDF5
+  if (run_input.write_type == 3) //initialize HDF5/XDMF parameter
+    setup_xdmf();
+#endif
+
+  //writers use their own communicator so that their collectives never mix with the solver's
+#ifdef _MPI
+  MPI_Comm_dup(MPI_COMM_WORLD, &out_comm);
+#endif
+
+  reset_metrics(0);
+  force_offset = intq_offset = res_offset = -1;
+  n_probe_buf[0] = n_probe_buf[1] = 0;
+  probe_fill = probe_out = 0;
+  async = run_input.async_output;
+  io_busy = false;
+  io_stop = false;
+#ifdef _MPI
+  if (async)
+  {
+    int thread_level;
+    MPI_Query_thread(&thread_level);
+    if (thread_level < MPI_THREAD_MULTIPLE)
+    {
+      if (FlowSol->rank == 0)
+        cout << "MPI library does not support MPI_THREAD_MULTIPLE, writing output synchronously" << endl;
+      async = 0;
+    }
+  }
+#endif
+  if (async)
+    io_thread = thread(&output::io_loop, this);
+}
+
+output::~output()
+{
+  if (io_thread.joinable())
+  {
+    {
+      lock_guard<mutex> lock(io_mutex);
+      io_stop = true;
+    }
+    io_cond.notify_all();
+    io_thread.join();
+  }
+}
+
+// write files due at this step. Probes are sampled here, the writers only get a full probe buffer, or the
+// samples buffered when a restart is written. In asynchronous mode the solution is copied to the staging
+// buffers of each element type for a plot or restart and the background thread interpolates and writes from there
+
+void output::write_outputs(int in_file_num, bool in_plot, bool in_probe, bool in_restart)
+{
+  if (!(in_plot || in_probe || in_restart))
+    return;
+
+  scoped_timer timer(T_WRITE_OUTPUTS);
+
+  if (in_probe)
+    sample_probe(FlowSol->time);
+  bool flush_probe = n_probe_buf[probe_fill] && (n_probe_buf[probe_fill] == run_probe.probe_buffer || in_restart);
+  if (!(in_plot || flush_probe || in_restart))
+    return;
+
+  //back-pressure: the staging buffers and the probe buffer handed off are in use until the previous job is written
+  wait_outputs();
+
+  if (flush_probe)
+    hand_probe();
+
+  if (!async)
+  {
+    out_time = FlowSol->time;
+    job_file_num = in_file_num;
+    job_plot = in_plot;
+    job_probe = flush_probe;
+    job_restart = in_restart;
+    write_job();
+    return;
+  }
+
+  if (in_plot || in_restart)
+    for (int i = 0; i < FlowSol->n_ele_types; i++)
+      FlowSol->mesh_eles(i)->snapshot_output(in_plot);
+
+  {
+    lock_guard<mutex> lock(io_mutex);
+    out_time = FlowSol->time;
+    job_file_num = in_file_num;
+    job_plot = in_plot;
+    job_probe = flush_probe;
+    job_restart = in_restart;
+    io_busy = true;
+  }
+  io_cond.notify_all();
+}
+
+void output::wait_outputs(void)
+{
+  if (async)
+  {
+    unique_lock<mutex> lock(io_mutex);
+    io_cond.wait(lock, [this] { return !io_busy; });
+  }
+}
+
+void output::close_outputs(void)
+{
+  wait_outputs();
+  if (io_thread.joinable())
+  {
+    {
+      lock_guard<mutex> lock(io_mutex);
+      io_stop = true;
+    }
+    io_cond.notify_all();
+    io_thread.join();
+  }
+  if (run_input.probe && n_probe_buf[probe_fill])
+  {
+    hand_probe();
+    write_probe();
+  }
+#ifdef _MPI
+  MPI_Comm_free(&out_comm);
+#endif
+}
+
+void output::io_loop(void)
+{
+  run_trace.name_thread("output");
+  unique_lock<mutex> lock(io_mutex);
+  while (true)
+  {
+    io_cond.wait(lock, [this] { return io_busy || io_stop; });
+    if (!io_busy) //stop requested and nothing pending
+      return;
+    lock.unlock();
+    write_job();
+    for (int i = 0; i < FlowSol->n_ele_types; i++)
+      FlowSol->mesh_eles(i)->release_output();
+    lock.lock();
+    io_busy = false;
+    io_cond.notify_all();
+  }
+}
+
+void output::write_job(void)
+{
+  if (job_plot)
+    write_plot(job_file_num);
+
+  //the probe samples handed off with a restart keep the probe files in step with the restart file
+  if (job_probe)
+    write_probe();
+
+  if (job_restart)
+  {
+    scoped_timer timer(T_WRITE_RESTART);
+#ifdef _HDF5
+    write_restart_hdf5(job_file_num);
+#else
+    write_restart_ascii(job_file_num);
+#endif
+  }
 }
 
-output::~output() { }
+void output::write_plot(int in_file_num)
+{
+  scoped_timer timer(T_WRITE_PLOT);
+  if (run_input.write_type == 0)
+    write_vtu(in_file_num);
+  else if (run_input.write_type == 1)
+    write_tec(in_file_num);
+#ifdef _CGNS
+  else if (run_input.write_type == 2)
+    write_CGNS(in_file_num);
+#endif
+#ifdef _HDF5
+  else if (run_input.write_type == 3)
+    write_xdmf(in_file_num);
+#endif
+  else
+    FatalError("ERROR: Trying to write unrecognized file format ... ");
+}
 
 #ifdef _CGNS
 void output::setup_CGNS(void)
@@ -161,6 +354,277 @@ void output::setup_CGNS(void)
 }
 #endif
 
+#ifdef _HDF5
+// plot elements of each type are numbered rank after rank, as in the CGNS output
+
+void output::setup_xdmf(void)
+{
+  hf_array<int> local(FlowSol->n_ele_types, 4);
+
+  xdmf_ele_start.setup(FlowSol->n_ele_types);
+  xdmf_n_eles_glob.setup(FlowSol->n_ele_types);
+  xdmf_n_ppts.setup(FlowSol->n_ele_types);
+  xdmf_n_peles.setup(FlowSol->n_ele_types);
+  xdmf_n_verts.setup(FlowSol->n_ele_types);
+
+  for (int i = 0; i < FlowSol->n_ele_types; i++)
+  {
+    local(i, 0) = FlowSol->mesh_eles(i)->get_n_eles();
+    if (local(i, 0))
+    {
+      local(i, 1) = FlowSol->mesh_eles(i)->get_n_ppts_per_ele();
+      local(i, 2) = FlowSol->mesh_eles(i)->get_n_peles_per_ele();
+      local(i, 3) = FlowSol->mesh_eles(i)->get_n_verts_per_ele();
+    }
+    else
+      local(i, 1) = local(i, 2) = local(i, 3) = 0;
+  }
+
+#ifdef _MPI
+  //element sizes are only known by ranks having that type of element
+  MPI_Exscan(local.get_ptr_cpu(0, 0), xdmf_ele_start.get_ptr_cpu(), FlowSol->n_ele_types, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  if (FlowSol->rank == 0)
+    xdmf_ele_start.initialize_to_zero();
+  MPI_Allreduce(local.get_ptr_cpu(0, 0), xdmf_n_eles_glob.get_ptr_cpu(), FlowSol->n_ele_types, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(local.get_ptr_cpu(0, 1), xdmf_n_ppts.get_ptr_cpu(), FlowSol->n_ele_types, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(local.get_ptr_cpu(0, 2), xdmf_n_peles.get_ptr_cpu(), FlowSol->n_ele_types, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(local.get_ptr_cpu(0, 3), xdmf_n_verts.get_ptr_cpu(), FlowSol->n_ele_types, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+#else
+  for (int i = 0; i < FlowSol->n_ele_types; i++)
+  {
+    xdmf_ele_start(i) = 0;
+    xdmf_n_eles_glob(i) = local(i, 0);
+    xdmf_n_ppts(i) = local(i, 1);
+    xdmf_n_peles(i) = local(i, 2);
+    xdmf_n_verts(i) = local(i, 3);
+  }
+#endif
+}
+
+// dataset creation property list with the optional deflate and scale-offset filters. in_digits >= 0 keeps
+// that many decimal digits of a floating point dataset (absolute error below 10^-in_digits)
+
+static hid_t create_filtered_plist(int in_rank, const hsize_t *in_chunk, int in_deflate, int in_digits)
+{
+  hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+
+  if (in_deflate == 0 && in_digits < 0)
+    return plist_id;
+
+  H5Pset_chunk(plist_id, in_rank, in_chunk);
+  if (in_digits >= 0)
+  {
+    if (!H5Zfilter_avail(H5Z_FILTER_SCALEOFFSET))
+      FatalError("HDF5 library does not provide the scale-offset filter");
+    H5Pset_scaleoffset(plist_id, H5Z_SO_FLOAT_DSCALE, in_digits);
+  }
+  if (in_deflate)
+  {
+    if (!H5Zfilter_avail(H5Z_FILTER_DEFLATE))
+      FatalError("HDF5 library does not provide the deflate filter");
+    if (in_digits < 0)
+      H5Pset_shuffle(plist_id);
+    H5Pset_deflate(plist_id, in_deflate);
+  }
+#ifdef _MPI
+  //parallel writes to filtered datasets do not support fill values
+  H5Pset_fill_time(plist_id, H5D_FILL_TIME_NEVER);
+#endif
+  return plist_id;
+}
+
+// write a (rows x cols) dataset of which this rank owns rows [in_row_start, in_row_start+in_n_rows).
+// Filtered datasets are chunked in whole elements of in_rows_per_ele rows, about 1MB per chunk
+
+static void write_xdmf_dataset(hid_t in_loc_id, const char *in_name, hid_t in_type, hsize_t in_n_rows_glob, hsize_t in_n_cols, hsize_t in_row_start, hsize_t in_n_rows, const void *in_data,
+                               hsize_t in_rows_per_ele, int in_deflate, int in_digits)
+{
+  hid_t dataset_id, dataspace_id, memspace_id, plist_id;
+  hsize_t dim[2], offset[2], count[2], chunk[2];
+  int rank = (in_n_cols > 1) ? 2 : 1;
+
+  dim[0] = in_n_rows_glob;
+  dim[1] = in_n_cols;
+  dataspace_id = H5Screate_simple(rank, dim, NULL);
+  chunk[0] = min(in_n_rows_glob, in_rows_per_ele * max((hsize_t)1, (1 << 20) / (in_rows_per_ele * in_n_cols * H5Tget_size(in_type))));
+  chunk[1] = in_n_cols;
+  plist_id = create_filtered_plist(rank, chunk, in_n_rows_glob ? in_deflate : 0, in_n_rows_glob ? in_digits : -1);
+  dataset_id = H5Dcreate2(in_loc_id, in_name, in_type, dataspace_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+  H5Pclose(plist_id);
+
+  offset[0] = in_row_start;
+  offset[1] = 0;
+  count[0] = in_n_rows;
+  count[1] = in_n_cols;
+  memspace_id = H5Screate_simple(rank, count, NULL);
+  if (in_n_rows)
+    H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+  else
+  {
+    H5Sselect_none(dataspace_id);
+    H5Sselect_none(memspace_id);
+  }
+
+  plist_id = H5Pcreate(H5P_DATASET_XFER);
+#ifdef _MPI
+  H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+#endif
+  H5Dwrite(dataset_id, in_type, memspace_id, dataspace_id, plist_id, in_data);
+
+  H5Pclose(plist_id);
+  H5Sclose(memspace_id);
+  H5Sclose(dataspace_id);
+  H5Dclose(dataset_id);
+}
+
+// the plot points and connectivity are written once per run to <data_file_name>_<first file number>.h5,
+// every dump then adds a group holding only the fields. Rank 0 rewrites the XDMF descriptor listing all dumps
+
+void output::write_xdmf(int in_file_num)
+{
+  const char *type_names[5] = {"tri", "quad", "tet", "pris", "hex"};
+  const char *topo_names[5] = {"Triangle", "Quadrilateral", "Tetrahedron", "Wedge", "Hexahedron"};
+  char step_name[32], xmf_name[256];
+  hid_t fid, plist_id, step_id, group_id, attr_dspace, attr_id;
+  bool first = xdmf_steps.empty();
+  vector<float> sol_data, vel_data, pos_data;
+  vector<int> con_data;
+  hsize_t n_pts_loc, n_pts_glob, pt_start;
+
+  if (first)
+  {
+    char fname[256];
+    sprintf(fname, "%s_%.09d.h5", run_input.data_file_name.c_str(), in_file_num);
+    xdmf_h5_name = fname;
+    get_plot_field_names(xdmf_fields);
+  }
+
+  if (FlowSol->rank == 0)
+    cout << "Writing HDF5 plot data for step " << in_file_num << " ...." << flush;
+
+  plist_id = H5Pcreate(H5P_FILE_ACCESS);
+#ifdef _MPI
+  H5Pset_fapl_mpio(plist_id, out_comm, MPI_INFO_NULL);
+#endif
+  if (first)
+    fid = H5Fcreate(xdmf_h5_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  else
+    fid = H5Fopen(xdmf_h5_name.c_str(), H5F_ACC_RDWR, plist_id);
+  if (fid < 0)
+    FatalError("Unable to open the HDF5 plot file");
+  H5Pclose(plist_id);
+
+  sprintf(step_name, "step_%.09d", in_file_num);
+  step_id = H5Gcreate2(fid, step_name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  attr_dspace = H5Screate(H5S_SCALAR);
+  attr_id = H5Acreate2(step_id, "time", H5T_NATIVE_DOUBLE, attr_dspace, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attr_id, H5T_NATIVE_DOUBLE, &out_time);
+  H5Aclose(attr_id);
+  H5Sclose(attr_dspace);
+
+  for (int i = 0; i < FlowSol->n_ele_types; i++)
+  {
+    if (xdmf_n_eles_glob(i) == 0)
+      continue;
+
+    n_pts_loc = (hsize_t)FlowSol->mesh_eles(i)->get_n_eles() * xdmf_n_ppts(i);
+    n_pts_glob = (hsize_t)xdmf_n_eles_glob(i) * xdmf_n_ppts(i);
+    pt_start = (hsize_t)xdmf_ele_start(i) * xdmf_n_ppts(i);
+
+    if (n_pts_loc)
+      calc_plot_data(i, first, xdmf_fields, sol_data, vel_data, pos_data, con_data);
+    else
+    {
+      sol_data.clear();
+      vel_data.clear();
+      pos_data.clear();
+      con_data.clear();
+    }
+
+    if (first) //plot mesh of this type
+    {
+      for (size_t k = 0; k < con_data.size(); k++)
+        con_data[k] += pt_start;
+      group_id = H5Gcreate2(fid, type_names[i], H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      write_xdmf_dataset(group_id, "coordinates", H5T_NATIVE_FLOAT, n_pts_glob, 3, pt_start, n_pts_loc, pos_data.data(),
+                         xdmf_n_ppts(i), run_input.plot_compression, -1);
+      write_xdmf_dataset(group_id, "connectivity", H5T_NATIVE_INT, (hsize_t)xdmf_n_eles_glob(i) * xdmf_n_peles(i), xdmf_n_verts(i),
+                         (hsize_t)xdmf_ele_start(i) * xdmf_n_peles(i), con_data.size() / xdmf_n_verts(i), con_data.data(),
+                         xdmf_n_peles(i), run_input.plot_compression, -1);
+      H5Gclose(group_id);
+    }
+
+    //fields of this type
+    group_id = H5Gcreate2(step_id, type_names[i], H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    write_xdmf_dataset(group_id, "Velocity", H5T_NATIVE_FLOAT, n_pts_glob, 3, pt_start, n_pts_loc, vel_data.data(),
+                       xdmf_n_ppts(i), run_input.plot_compression, run_input.plot_precision);
+    for (size_t l = 0; l < xdmf_fields.size(); l++)
+      write_xdmf_dataset(group_id, xdmf_fields[l].c_str(), H5T_NATIVE_FLOAT, n_pts_glob, 1, pt_start, n_pts_loc, n_pts_loc ? &sol_data[l * n_pts_loc] : NULL,
+                         xdmf_n_ppts(i), run_input.plot_compression, run_input.plot_precision);
+    H5Gclose(group_id);
+  }
+
+  H5Gclose(step_id);
+  H5Fclose(fid);
+
+  xdmf_steps.push_back(in_file_num);
+  xdmf_times.push_back(out_time);
+
+  //descriptor listing every dump written so far
+  if (FlowSol->rank == 0)
+  {
+    ofstream write_xmf;
+    sprintf(xmf_name, "%s_%.09d.xmf", run_input.data_file_name.c_str(), xdmf_steps[0]);
+    write_xmf.open(xmf_name);
+    write_xmf.precision(15);
+    write_xmf << "<?xml version=\"1.0\" ?>" << endl;
+    write_xmf << "<Xdmf Version=\"3.0\">" << endl;
+    write_xmf << "  <Domain>" << endl;
+    write_xmf << "    <Grid Name=\"TimeSeries\" GridType=\"Collection\" CollectionType=\"Temporal\">" << endl;
+    for (size_t t = 0; t < xdmf_steps.size(); t++)
+    {
+      sprintf(step_name, "step_%.09d", xdmf_steps[t]);
+      write_xmf << "      <Grid Name=\"" << step_name << "\" GridType=\"Collection\" CollectionType=\"Spatial\">" << endl;
+      write_xmf << "        <Time Value=\"" << xdmf_times[t] << "\" />" << endl;
+      for (int i = 0; i < FlowSol->n_ele_types; i++)
+      {
+        if (xdmf_n_eles_glob(i) == 0)
+          continue;
+        long n_pts_i = (long)xdmf_n_eles_glob(i) * xdmf_n_ppts(i);
+        long n_cells_i = (long)xdmf_n_eles_glob(i) * xdmf_n_peles(i);
+        write_xmf << "        <Grid Name=\"" << type_names[i] << "\" GridType=\"Uniform\">" << endl;
+        write_xmf << "          <Topology TopologyType=\"" << topo_names[i] << "\" NumberOfElements=\"" << n_cells_i << "\">" << endl;
+        write_xmf << "            <DataItem Dimensions=\"" << n_cells_i << " " << xdmf_n_verts(i) << "\" NumberType=\"Int\" Format=\"HDF\">"
+                  << xdmf_h5_name << ":/" << type_names[i] << "/connectivity</DataItem>" << endl;
+        write_xmf << "          </Topology>" << endl;
+        write_xmf << "          <Geometry GeometryType=\"XYZ\">" << endl;
+        write_xmf << "            <DataItem Dimensions=\"" << n_pts_i << " 3\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\">"
+                  << xdmf_h5_name << ":/" << type_names[i] << "/coordinates</DataItem>" << endl;
+        write_xmf << "          </Geometry>" << endl;
+        write_xmf << "          <Attribute Name=\"Velocity\" AttributeType=\"Vector\" Center=\"Node\">" << endl;
+        write_xmf << "            <DataItem Dimensions=\"" << n_pts_i << " 3\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\">"
+                  << xdmf_h5_name << ":/" << step_name << "/" << type_names[i] << "/Velocity</DataItem>" << endl;
+        write_xmf << "          </Attribute>" << endl;
+        for (size_t l = 0; l < xdmf_fields.size(); l++)
+        {
+          write_xmf << "          <Attribute Name=\"" << xdmf_fields[l] << "\" AttributeType=\"Scalar\" Center=\"Node\">" << endl;
+          write_xmf << "            <DataItem Dimensions=\"" << n_pts_i << "\" NumberType=\"Float\" Precision=\"4\" Format=\"HDF\">"
+                    << xdmf_h5_name << ":/" << step_name << "/" << type_names[i] << "/" << xdmf_fields[l] << "</DataItem>" << endl;
+          write_xmf << "          </Attribute>" << endl;
+        }
+        write_xmf << "        </Grid>" << endl;
+      }
+      write_xmf << "      </Grid>" << endl;
+    }
+    write_xmf << "    </Grid>" << endl;
+    write_xmf << "  </Domain>" << endl;
+    write_xmf << "</Xdmf>" << endl;
+    write_xmf.close();
+    cout << "done." << endl;
+  }
+}
+#endif
+
 // method to write out a tecplot file
 void output::write_tec(int in_file_num)
 {
@@ -231,7 +695,7 @@ void output::write_tec(int in_file_num)
   }
   else
       sprintf(file_name_s,"%s_%.09d_p%.04d.plt",run_input.data_file_name.c_str(),in_file_num,FlowSol->rank);
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(out_comm);
   if (FlowSol->rank==0) cout << "Writing Tecplot file number " << in_file_num << " ...." << flush;
 #else
   sprintf(file_name_s,"%s_%.09d_p%.04d.plt",run_input.data_file_name.c_str(),in_file_num,0);
@@ -324,7 +788,7 @@ void output::write_tec(int in_file_num)
               grad_disu_ppts_temp.initialize_to_zero();
             }
             diag_ppts_temp.setup(n_ppts_per_ele, n_diag_fields);
-            if (run_input.shock_cap)
+            if (run_input.shock_cap || run_input.over_int == 2)
               sensor_ppts_temp.setup(n_ppts_per_ele);
           }
 
@@ -357,7 +821,7 @@ void output::write_tec(int in_file_num)
 
           if(time_iter == 0)
             {
-              write_tec <<"SolutionTime=" << FlowSol->time << endl;
+              write_tec <<"SolutionTime=" << out_time << endl;
               time_iter = 1;
             }
 
@@ -379,9 +843,9 @@ void output::write_tec(int in_file_num)
                 {
                   if (run_input.viscous)
                     FlowSol->mesh_eles(i)->calc_grad_disu_ppts(j, grad_disu_ppts_temp);
-                  if (run_input.shock_cap)
+                  if (run_input.shock_cap || run_input.over_int == 2)
                     FlowSol->mesh_eles(i)->calc_sensor_ppts(j, sensor_ppts_temp);
-                  FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, FlowSol->time);
+                  FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, out_time);
                 }
 
                 for(k=0;k<n_ppts_per_ele;k++)
@@ -617,7 +1081,7 @@ void output::write_vtu(int in_file_num)
     }
 
   /*! Wait for all processes to get to this point, otherwise there won't be a directory to put .vtus into */
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(out_comm);
 
 #else
 
@@ -626,6 +1090,14 @@ void output::write_vtu(int in_file_num)
 
 #endif
 
+  /*! Binary files are written by blocks of whole arrays */
+  if (run_input.vtu_format != 0)
+  {
+    write_vtu_appended(vtu_s);
+    if(my_rank==0) cout<<"done."<<endl;
+    return;
+  }
+
   /*! Each process writes its own .vtu file */
   write_vtu.open(vtu_s);
   /*! File header */
@@ -679,7 +1151,7 @@ void output::write_vtu(int in_file_num)
             diag_ppts_temp.setup(n_points,n_diag_fields);
 
             /*! Temporary field for sensor hf_array at plot points */
-            if (run_input.shock_cap)
+            if (run_input.shock_cap || run_input.over_int == 2)
               sensor_ppts_temp.setup(n_points);
               
           }
@@ -705,14 +1177,14 @@ void output::write_vtu(int in_file_num)
                 if (run_input.viscous)
                   FlowSol->mesh_eles(i)->calc_grad_disu_ppts(j, grad_disu_ppts_temp);
 
-                if(run_input.shock_cap)
+                if(run_input.shock_cap || run_input.over_int == 2)
                 {
                   /*! Calculate the sensor at the plot points */
                   FlowSol->mesh_eles(i)->calc_sensor_ppts(j,sensor_ppts_temp);
                 }
 
                 /*! Calculate the diagnostic fields at the plot points */
-                FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, FlowSol->time);
+                FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, out_time);
               }
 
               /*! write out solution to file */
@@ -896,6 +1368,258 @@ void output::write_vtu(int in_file_num)
   if(my_rank==0) cout<<"done."<<endl;
 }
 
+// append one data array to the appended data section of a vtu file, return its offset in the section.
+// the block is prefixed by a UInt64 byte count, or by the vtkZLibDataCompressor block header when compressed
+
+static size_t append_vtu_block(const void *in_data, size_t in_n_bytes, vector<char> &out_appended)
+{
+  size_t offset = out_appended.size();
+  const char *data = (const char *)in_data;
+
+  if (run_input.vtu_format == 1)
+  {
+    uint64_t n_bytes = in_n_bytes;
+    out_appended.insert(out_appended.end(), (char *)&n_bytes, (char *)&n_bytes + sizeof(uint64_t));
+    out_appended.insert(out_appended.end(), data, data + in_n_bytes);
+  }
+#ifdef _ZLIB
+  else
+  {
+    const size_t block_size = 32768;
+    size_t n_blocks = (in_n_bytes + block_size - 1) / block_size;
+    vector<uint64_t> header(3 + n_blocks);
+    vector<char> comp_data;
+    uLongf comp_size;
+
+    header[0] = n_blocks;
+    header[1] = block_size;
+    header[2] = in_n_bytes % block_size;
+
+    comp_data.resize(compressBound(block_size) * n_blocks);
+    size_t pos = 0;
+    for (size_t i = 0; i < n_blocks; i++)
+    {
+      size_t n_in = min(block_size, in_n_bytes - i * block_size);
+      comp_size = compressBound(n_in);
+      if (compress2((Bytef *)&comp_data[pos], &comp_size, (const Bytef *)(data + i * block_size), n_in, Z_DEFAULT_COMPRESSION) != Z_OK)
+        FatalError("Failed to compress vtu data");
+      header[3 + i] = comp_size;
+      pos += comp_size;
+    }
+    out_appended.insert(out_appended.end(), (char *)header.data(), (char *)(header.data() + header.size()));
+    out_appended.insert(out_appended.end(), comp_data.begin(), comp_data.begin() + pos);
+  }
+#endif
+
+  return offset;
+}
+
+// names of the scalar plot fields: density, specific total energy, nu_tilde, averaged and diagnostic fields
+
+void output::get_plot_field_names(vector<string> &out_names)
+{
+  out_names.clear();
+  out_names.push_back("Density");
+  out_names.push_back("SpecificTotalEnergy");
+  if (run_input.RANS == 1)
+    out_names.push_back("Nu_Tilde");
+  for(int m=0;m<run_input.n_average_fields;m++)
+    out_names.push_back(run_input.average_fields(m));
+  for(int m=0;m<run_input.n_diagnostic_fields;m++)
+    out_names.push_back(run_input.diagnostic_fields(m));
+}
+
+// interpolate the solution of all local elements of one type to the plot points, as contiguous float arrays.
+// out_sol holds the scalar fields named in out_names one after another, out_vel and out_pos have 3 components
+// per point and out_con holds the plot sub-element vertices numbered from the first local point
+
+void output::calc_plot_data(int in_ele_type, bool in_mesh, vector<string> &out_names, vector<float> &out_sol, vector<float> &out_vel, vector<float> &out_pos, vector<int> &out_con)
+{
+  int j,k,l,m;
+  int n_fields, n_dims, n_eles, n_points, n_cells, n_verts;
+  int n_diag_fields = run_input.n_diagnostic_fields;
+  int n_average_fields = run_input.n_average_fields;
+  size_t n_pts_tot, n_cells_tot;
+
+  hf_array<double> pos_ppts_temp, disu_ppts_temp, grad_disu_ppts_temp, diag_ppts_temp, disu_average_ppts_temp, sensor_ppts_temp;
+  hf_array<int> con;
+
+  n_eles = FlowSol->mesh_eles(in_ele_type)->get_n_eles();
+  n_points = FlowSol->mesh_eles(in_ele_type)->get_n_ppts_per_ele();
+  n_cells  = FlowSol->mesh_eles(in_ele_type)->get_n_peles_per_ele();
+  n_verts  = FlowSol->mesh_eles(in_ele_type)->get_n_verts_per_ele();
+  n_fields = FlowSol->mesh_eles(in_ele_type)->get_n_fields();
+  n_dims = FlowSol->mesh_eles(in_ele_type)->get_n_dims();
+  n_pts_tot = (size_t)n_eles*n_points;
+  n_cells_tot = (size_t)n_eles*n_cells;
+
+  get_plot_field_names(out_names);
+
+  out_sol.resize(out_names.size()*n_pts_tot);
+  out_vel.resize(3*n_pts_tot);
+  if (in_mesh)
+  {
+    out_pos.resize(3*n_pts_tot);
+    out_con.resize(n_cells_tot*n_verts);
+    pos_ppts_temp.setup(n_points,n_dims);
+    con = FlowSol->mesh_eles(in_ele_type)->get_connectivity_plot();
+  }
+
+  disu_ppts_temp.setup(n_points,n_fields);
+  if(n_average_fields > 0)
+    disu_average_ppts_temp.setup(n_points,n_average_fields);
+  if(n_diag_fields > 0) {
+    if (run_input.viscous)
+    {
+      grad_disu_ppts_temp.setup(n_points,n_fields,n_dims);
+      grad_disu_ppts_temp.initialize_to_zero();
+    }
+    diag_ppts_temp.setup(n_points,n_diag_fields);
+    if (run_input.shock_cap || run_input.over_int == 2)
+      sensor_ppts_temp.setup(n_points);
+  }
+
+  for(j=0;j<n_eles;j++)
+    {
+      size_t pt0 = (size_t)j*n_points;
+      size_t cell0 = (size_t)j*n_cells;
+
+      FlowSol->mesh_eles(in_ele_type)->calc_disu_ppts(j,disu_ppts_temp);
+      if(n_average_fields > 0)
+        FlowSol->mesh_eles(in_ele_type)->calc_time_average_ppts(j,disu_average_ppts_temp);
+      if(n_diag_fields > 0) {
+        if (run_input.viscous)
+          FlowSol->mesh_eles(in_ele_type)->calc_grad_disu_ppts(j, grad_disu_ppts_temp);
+        if(run_input.shock_cap || run_input.over_int == 2)
+          FlowSol->mesh_eles(in_ele_type)->calc_sensor_ppts(j,sensor_ppts_temp);
+        FlowSol->mesh_eles(in_ele_type)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, out_time);
+      }
+
+      for(k=0;k<n_points;k++)
+        {
+          l = 0;
+          out_sol[l++*n_pts_tot+pt0+k] = disu_ppts_temp(k,0);
+          out_sol[l++*n_pts_tot+pt0+k] = disu_ppts_temp(k,n_dims+1)/disu_ppts_temp(k,0);
+          if (run_input.RANS == 1)
+            out_sol[l++*n_pts_tot+pt0+k] = disu_ppts_temp(k,n_dims+2)/disu_ppts_temp(k,0);
+          for(m=0;m<n_average_fields;m++)
+            out_sol[l++*n_pts_tot+pt0+k] = disu_average_ppts_temp(k,m);
+          for(m=0;m<n_diag_fields;m++)
+            out_sol[l++*n_pts_tot+pt0+k] = diag_ppts_temp(k,m);
+
+          /*! velocity always has 3 components */
+          for(l=0;l<3;l++)
+            out_vel[3*(pt0+k)+l] = (l<n_dims) ? disu_ppts_temp(k,l+1)/disu_ppts_temp(k,0) : 0.;
+        }
+
+      if (in_mesh)
+        {
+          FlowSol->mesh_eles(in_ele_type)->calc_pos_ppts(j,pos_ppts_temp);
+          for(k=0;k<n_points;k++)
+            for(l=0;l<3;l++)
+              out_pos[3*(pt0+k)+l] = (l<n_dims) ? pos_ppts_temp(k,l) : 0.;
+
+          for(k=0;k<n_cells;k++)
+            for(l=0;l<n_verts;l++)
+              out_con[(cell0+k)*n_verts+l] = con(l,k)+pt0;
+        }
+    }
+}
+
+// write the local .vtu file with all arrays stored in a raw (optionally compressed) appended data section.
+// each element type is written as one piece so every array goes to the file in one block
+
+void output::write_vtu_appended(char *in_vtu_s)
+{
+  int i,l;
+  int n_eles, n_cells, n_verts;
+  int n_sol_arrays;
+  size_t n_pts_tot, n_cells_tot;
+  int vtktypes[5] = {5,9,10,13,12};
+
+  /*! data of one piece, [field][point] for scalar fields */
+  vector<float> sol_data, vel_data, pos_data;
+  vector<int> con_data, offset_data;
+  vector<unsigned char> type_data;
+
+  /*! names of the scalar point data arrays */
+  vector<string> array_names;
+  /*! xml of the pieces and the appended data section */
+  ostringstream pieces;
+  vector<char> appended;
+  size_t offset;
+
+  ofstream write_vtu;
+
+  for(i=0;i<FlowSol->n_ele_types;i++)
+    {
+      n_eles = FlowSol->mesh_eles(i)->get_n_eles();
+      if (n_eles==0)
+        continue;
+
+      n_cells  = FlowSol->mesh_eles(i)->get_n_peles_per_ele();
+      n_verts  = FlowSol->mesh_eles(i)->get_n_verts_per_ele();
+      n_pts_tot = (size_t)n_eles*FlowSol->mesh_eles(i)->get_n_ppts_per_ele();
+      n_cells_tot = (size_t)n_eles*n_cells;
+
+      calc_plot_data(i, true, array_names, sol_data, vel_data, pos_data, con_data);
+      n_sol_arrays = array_names.size();
+
+      offset_data.resize(n_cells_tot);
+      for(size_t k=0;k<n_cells_tot;k++)
+        offset_data[k] = (k+1)*n_verts;
+      type_data.assign(n_cells_tot, vtktypes[i]);
+
+      /*! piece header and point data */
+      pieces << "		<Piece NumberOfPoints=\"" << n_pts_tot << "\" NumberOfCells=\"" << n_cells_tot << "\">" << endl;
+      pieces << "			<PointData>" << endl;
+      offset = append_vtu_block(&sol_data[0], n_pts_tot*sizeof(float), appended);
+      pieces << "				<DataArray type=\"Float32\" Name=\"Density\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+      offset = append_vtu_block(&vel_data[0], 3*n_pts_tot*sizeof(float), appended);
+      pieces << "				<DataArray type=\"Float32\" NumberOfComponents=\"3\" Name=\"Velocity\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+      for(l=1;l<n_sol_arrays;l++)
+        {
+          offset = append_vtu_block(&sol_data[l*n_pts_tot], n_pts_tot*sizeof(float), appended);
+          pieces << "				<DataArray type=\"Float32\" Name=\"" << array_names[l] << "\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+        }
+      pieces << "			</PointData>" << endl;
+
+      /*! plot coordinates */
+      pieces << "			<Points>" << endl;
+      offset = append_vtu_block(&pos_data[0], 3*n_pts_tot*sizeof(float), appended);
+      pieces << "				<DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+      pieces << "			</Points>" << endl;
+
+      /*! cells: connectivity, offsets, element types */
+      pieces << "			<Cells>" << endl;
+      offset = append_vtu_block(&con_data[0], con_data.size()*sizeof(int), appended);
+      pieces << "				<DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+      offset = append_vtu_block(&offset_data[0], offset_data.size()*sizeof(int), appended);
+      pieces << "				<DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+      offset = append_vtu_block(&type_data[0], type_data.size()*sizeof(unsigned char), appended);
+      pieces << "				<DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << offset << "\" />" << endl;
+      pieces << "			</Cells>" << endl;
+      pieces << "		</Piece>" << endl;
+    }
+
+  write_vtu.open(in_vtu_s, ios::binary);
+  write_vtu << "<?xml version=\"1.0\" ?>" << endl;
+  write_vtu << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\"";
+  if (run_input.vtu_format == 2)
+    write_vtu << " compressor=\"vtkZLibDataCompressor\"";
+  write_vtu << ">" << endl;
+  write_vtu << "	<UnstructuredGrid>" << endl;
+  write_vtu << pieces.str();
+  write_vtu << "	</UnstructuredGrid>" << endl;
+  write_vtu << "	<AppendedData encoding=\"raw\">" << endl;
+  write_vtu << "_";
+  write_vtu.write(appended.data(), appended.size());
+  write_vtu << endl;
+  write_vtu << "	</AppendedData>" << endl;
+  write_vtu << "</VTKFile>" << endl;
+  write_vtu.close();
+}
+
 
 #ifdef _CGNS
 void output::write_CGNS(int in_file_num)
@@ -931,7 +1655,7 @@ void output::write_CGNS(int in_file_num)
   int n_average_fields = run_input.n_average_fields;
 
   sprintf(fname, "%s_%.09d.cgns", run_input.data_file_name.c_str(), in_file_num);
-  cgp_mpi_comm(MPI_COMM_WORLD);
+  cgp_mpi_comm(out_comm);
   //cgp_pio_mode(CGP_COLLECTIVE);//default
   if (FlowSol->rank == 0)
     cout << "Writing CGNS file " << fname << " ...." << flush;
@@ -1047,7 +1771,7 @@ void output::write_CGNS(int in_file_num)
         }
         diag_ppts_temp.setup(n_ppts_per_ele, n_diag_fields);
         diag_ppts_wt.setup(n_ppts_per_ele, n_eles, n_diag_fields);
-        if (run_input.shock_cap)
+        if (run_input.shock_cap || run_input.over_int == 2)
           sensor_ppts_temp.setup(n_ppts_per_ele);
       }
 
@@ -1070,10 +1794,10 @@ void output::write_CGNS(int in_file_num)
         {
           if (run_input.viscous)
             FlowSol->mesh_eles(i)->calc_grad_disu_ppts(j, grad_disu_ppts_temp);
-          if (run_input.shock_cap)
+          if (run_input.shock_cap || run_input.over_int == 2)
             /*! Calculate the sensor at the plot points */
             FlowSol->mesh_eles(i)->calc_sensor_ppts(j, sensor_ppts_temp);
-          FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, FlowSol->time);//get diagnostic field
+          FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, out_time);//get diagnostic field
           for (int k = 0; k < n_ppts_per_ele; k++) //copy to array
             for (int l = 0; l < n_diag_fields; l++)
               diag_ppts_wt(k, j, l) = diag_ppts_temp(k, l);
@@ -1278,7 +2002,7 @@ void output::write_CGNS(int in_file_num)
           grad_disu_ppts_temp.initialize_to_zero();
         }
         diag_ppts_temp.setup(n_ppts_per_ele, n_diag_fields);
-        if (run_input.shock_cap)
+        if (run_input.shock_cap || run_input.over_int == 2)
           sensor_ppts_temp.setup(n_ppts_per_ele);
       }
 
@@ -1324,10 +2048,10 @@ void output::write_CGNS(int in_file_num)
         {
           if (run_input.viscous)
             FlowSol->mesh_eles(i)->calc_grad_disu_ppts(j, grad_disu_ppts_temp);
-          if (run_input.shock_cap)
+          if (run_input.shock_cap || run_input.over_int == 2)
             /*! Calculate the sensor at the plot points */
             FlowSol->mesh_eles(i)->calc_sensor_ppts(j, sensor_ppts_temp);
-          FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, FlowSol->time);
+          FlowSol->mesh_eles(i)->calc_diagnostic_fields_ppts(j, disu_ppts_temp, grad_disu_ppts_temp, sensor_ppts_temp, diag_ppts_temp, out_time);
           for (int k = 0; k < n_diag_fields; k++)
             if (cg_field_partial_write(F, B, Z, S, CGNS_ENUMV(RealDouble), run_input.diagnostic_fields(i).c_str(), &temp_ptr, &temp_ptr2, diag_ppts_temp.get_ptr_cpu(k * n_ppts_per_ele), Fs_diag.get_ptr_cpu(k)))
               cg_error_exit();
@@ -1393,6 +2117,175 @@ void output::write_CGNS(int in_file_num)
 }
 #endif
 
+// set the typewise probe interpolation operators and the sample buffer
+
+void output::setup_probe(void)
+{
+  hf_array<double> loc_probe_temp;
+  vector<int> probe_eles;
+
+  probe_type_list.assign(FlowSol->n_ele_types, vector<int>());
+  for (int i = 0; i < run_probe.n_probe; i++)
+    probe_type_list[run_probe.p2t[i]].push_back(i);
+
+  for (int i = 0; i < FlowSol->n_ele_types; i++)
+  {
+    int n_probes_type = probe_type_list[i].size();
+    if (n_probes_type == 0)
+      continue;
+    loc_probe_temp.setup(FlowSol->n_dims, n_probes_type);
+    probe_eles.resize(n_probes_type);
+    for (int j = 0; j < n_probes_type; j++)
+    {
+      for (int k = 0; k < FlowSol->n_dims; k++)
+        loc_probe_temp(k, j) = run_probe.loc_probe(k, probe_type_list[i][j]);
+      probe_eles[j] = run_probe.p2c[probe_type_list[i][j]];
+    }
+    FlowSol->mesh_eles(i)->set_opp_probe(probe_eles, loc_probe_temp);
+  }
+
+  if (run_probe.fwh_surface != "")
+#ifdef _MPI
+    acoustic.setup(FlowSol, out_comm);
+#else
+    acoustic.setup(FlowSol);
+#endif
+
+  for (int i = 0; i < 2; i++)
+  {
+    probe_buf[i].setup(run_probe.probe_buffer, max(run_probe.n_probe, 1), run_probe.n_probe_fields);
+    probe_buf_time[i].setup(run_probe.probe_buffer);
+    n_probe_buf[i] = 0;
+  }
+}
+
+// dimensional value of one probe field from the conservative variables
+
+static double calc_probe_field(const string &in_field, hf_array<double> &in_disu, int in_probe, int in_n_dims)
+{
+  int viscous = run_input.viscous;
+
+  if (in_field == "rho")
+  {
+    if (viscous && run_input.equation == 0)
+      return in_disu(in_probe, 0) * run_input.rho_ref;
+    else
+      return in_disu(in_probe, 0);
+  }
+  else if (in_field == "u")
+  {
+    if (viscous)
+      return in_disu(in_probe, 1) / in_disu(in_probe, 0) * run_input.uvw_ref;
+    else
+      return in_disu(in_probe, 1) / in_disu(in_probe, 0);
+  }
+  else if (in_field == "v")
+  {
+    if (viscous)
+      return in_disu(in_probe, 2) / in_disu(in_probe, 0) * run_input.uvw_ref;
+    else
+      return in_disu(in_probe, 2) / in_disu(in_probe, 0);
+  }
+  else if (in_field == "w")
+  {
+    if (in_n_dims != 3)
+      FatalError("2 dimensional elements don't have z velocity");
+    if (viscous)
+      return in_disu(in_probe, 3) / in_disu(in_probe, 0) * run_input.uvw_ref;
+    else
+      return in_disu(in_probe, 3) / in_disu(in_probe, 0);
+  }
+  else if (in_field == "specific_total_energy") //e
+  {
+    if (viscous)
+      return in_disu(in_probe, in_n_dims + 1) / in_disu(in_probe, 0) * run_input.uvw_ref * run_input.uvw_ref;
+    else
+      return in_disu(in_probe, in_n_dims + 1) / in_disu(in_probe, 0);
+  }
+  else if (in_field == "pressure")
+  {
+    double v_sq = 0.;
+    double pressure;
+    for (int m = 0; m < in_n_dims; m++)
+      v_sq += (in_disu(in_probe, m + 1) * in_disu(in_probe, m + 1));
+    v_sq /= in_disu(in_probe, 0) * in_disu(in_probe, 0);
+    // Compute pressure
+    pressure = (run_input.gamma - 1.0) * (in_disu(in_probe, in_n_dims + 1) - 0.5 * in_disu(in_probe, 0) * v_sq);
+    if (viscous)
+      return pressure * run_input.p_ref;
+    else
+      return pressure;
+  }
+  else
+    FatalError("Probe field not implemented yet!");
+  return 0.;
+}
+
+// interpolate the solution to every local probe and append the sample to the buffer being filled
+
+void output::sample_probe(double in_time)
+{
+  int n_dims = FlowSol->n_dims;
+  int n_buf = n_probe_buf[probe_fill];
+  hf_array<double> &buf = probe_buf[probe_fill];
+  hf_array<double> disu_probe_temp;
+
+  if (run_input.viscous && run_input.equation == 0)
+    probe_buf_time[probe_fill](n_buf) = in_time * run_input.time_ref;
+  else
+    probe_buf_time[probe_fill](n_buf) = in_time;
+
+  for (int i = 0; i < FlowSol->n_ele_types; i++)
+  {
+    int n_probes_type = probe_type_list[i].size();
+    if (n_probes_type == 0)
+      continue;
+    disu_probe_temp.setup(n_probes_type, FlowSol->mesh_eles(i)->get_n_fields());
+    FlowSol->mesh_eles(i)->calc_disu_probepoints(disu_probe_temp);
+    for (int j = 0; j < n_probes_type; j++)
+    {
+      for (int k = 0; k < run_probe.n_probe_fields; k++)
+        buf(n_buf, probe_type_list[i][j], k) = calc_probe_field(run_probe.probe_fields(k), disu_probe_temp, j, n_dims);
+      if (acoustic.active && acoustic.probe2fwh[probe_type_list[i][j]] != -1)
+        for (int k = 0; k < n_dims + 2; k++)
+          acoustic.disu_surf(acoustic.probe2fwh[probe_type_list[i][j]], k) = disu_probe_temp(j, k);
+    }
+  }
+  n_probe_buf[probe_fill]++;
+
+  if (acoustic.active)
+    acoustic.accumulate(in_time);
+}
+
+// hand the buffered probe samples and the completed FW-H observer samples to the writers, the solver samples
+// into the other buffer meanwhile. The previous job must be written
+
+void output::hand_probe(void)
+{
+  probe_out = probe_fill;
+  probe_fill = 1 - probe_fill;
+  n_probe_buf[probe_fill] = 0;
+  if (acoustic.active)
+    acoustic.collect();
+}
+
+// write the probe samples handed off
+
+void output::write_probe(void)
+{
+  if (n_probe_buf[probe_out] == 0)
+    return;
+  scoped_timer timer(T_WRITE_PROBE);
+#ifdef _HDF5
+  write_probe_hdf5();
+#else
+  write_probe_ascii();
+#endif
+  n_probe_buf[probe_out] = 0;
+  if (acoustic.active)
+    acoustic.write();
+}
+
 /*! Method to write out a probe file.
 Used in run mode.
 input: FlowSol						solution structure
@@ -1403,16 +2296,6 @@ void output::write_probe_ascii(void)
 {
     /*! Current rank*/
     int myrank=FlowSol->rank;
-    /*! Is viscous*/
-    int viscous=run_input.viscous;
-    /*! No. of solution fields */
-    int n_fields;
-    /*! No. of dimensions */
-    int n_dims=FlowSol->n_dims;
-    /*! reference location of probe point */
-    hf_array<double> loc_probe_point_temp(n_dims);
-    /*! solution data at probe points */
-    hf_array<double> disu_probe_point_temp;
     /*! file name */
     char probe_data[256];
     /*! output file object*/
@@ -1421,124 +2304,37 @@ void output::write_probe_ascii(void)
     string folder;
     int file_idx;
 
-    if (run_input.equation == 0) //ns
-    {
-      if (n_dims == 2)
-        n_fields = 4;
-      else
-        n_fields = 5;
-      if (run_input.RANS)
-        n_fields++;
-    }
-    else //ad-diff
-      n_fields = 1;
-
-    //initialize temp solution array
-    disu_probe_point_temp.setup(n_fields);
-    disu_probe_point_temp.initialize_to_zero();
-
     /*! every node write .dat*/
     if(myrank ==0) cout<<"writing probe point data..."<<flush;
     for (int i=0; i<run_probe.n_probe; i++) //loop over every local probe point i
     {
-        bool surf_flag;
         //set the folder name
         for (int id = 0; id < run_probe.probe_name.get_dim(0); id++) //loop over each set of probe
         {
           if (run_probe.p2global_p[i] < run_probe.probe_start[id + 1] && run_probe.p2global_p[i] >= run_probe.probe_start[id])
           {
             folder = run_probe.probe_name[id];
-            surf_flag = run_probe.probe_surf_flag[id];
             file_idx = run_probe.p2global_p[i] - run_probe.probe_start[id];
             break;
           }
         }
-
+        sprintf(probe_data, "%s/%s_%.06d.dat", folder.c_str(), folder.c_str(), file_idx); //generate file name
         wt_probe.open(probe_data, ios_base::out | ios_base::app); //open file
         if (!wt_probe.is_open())
         {
           FatalError("Cannont open input file for reading.");
         }
-        //use scientific notation
+        //write data to file
         wt_probe.setf(ios::scientific);
 
-        //copy probe point loc
-        for (int j = 0; j < n_dims; j++)
-          loc_probe_point_temp(j) = run_probe.loc_probe(j, i);
-        //calculate fields data on probe points
-        FlowSol->mesh_eles(run_probe.p2t[i])->set_opp_probe(loc_probe_point_temp);                            //calculate solution on upts to probe points matrix
-        FlowSol->mesh_eles(run_probe.p2t[i])->calc_disu_probepoints(run_probe.p2c[i], disu_probe_point_temp); //calculate solution on the reference probe point
-
-        /*! Start writing data*/
-        //write time
-        if (viscous && run_input.equation == 0)
-          wt_probe << setw(20) << setprecision(10) << FlowSol->time * run_input.time_ref;
-        else
-          wt_probe << setw(20) << setprecision(10) << FlowSol->time;
-        for (int j = 0; j < run_probe.n_probe_fields; j++) //write transient fields
+        for (int t = 0; t < n_probe_buf[probe_out]; t++) //write every buffered sample
         {
-
-          if (run_probe.probe_fields(j) == "rho")
-          {
-            if (viscous && run_input.equation == 0)
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(0) * run_input.rho_ref;
-            else
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(0);
-          }
-          else if (run_probe.probe_fields(j) == "u")
-          {
-            if (viscous)
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(1) / disu_probe_point_temp(0) * run_input.uvw_ref;
-            else
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(1) / disu_probe_point_temp(0);
-          }
-          else if (run_probe.probe_fields(j) == "v")
-          {
-            if (viscous)
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(2) / disu_probe_point_temp(0) * run_input.uvw_ref;
-            else
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(2) / disu_probe_point_temp(0);
-          }
-          else if (run_probe.probe_fields(j) == "w")
-          {
-            if (n_dims == 3)
-            {
-              if (viscous)
-                wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(3) / disu_probe_point_temp(0) * run_input.uvw_ref;
-              else
-                wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(3) / disu_probe_point_temp(0);
-            }
-            else
-              FatalError("2 dimensional elements don't have z velocity");
-          }
-          else if (run_probe.probe_fields(j) == "specific_total_energy") //e
-          {
-            if (viscous)
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(n_dims + 1) / disu_probe_point_temp(0) * run_input.uvw_ref * run_input.uvw_ref;
-            else
-              wt_probe << setw(20) << setprecision(10) << disu_probe_point_temp(n_dims + 1) / disu_probe_point_temp(0);
-          }
-          else if (run_probe.probe_fields(j) == "pressure")
-          {
-            double v_sq = 0.;
-            double pressure;
-            for (int m = 0; m < n_dims; m++)
-              v_sq += (disu_probe_point_temp(m + 1) * disu_probe_point_temp(m + 1));
-            v_sq /= disu_probe_point_temp(0) * disu_probe_point_temp(0);
-            // cout<<disu_probe_point_temp(0);
-            // Compute pressure
-            pressure = (run_input.gamma - 1.0) * (disu_probe_point_temp(n_dims + 1) - 0.5 * disu_probe_point_temp(0) * v_sq);
-            if (viscous)
-              wt_probe << setw(20) << setprecision(10) << pressure * run_input.p_ref;
-            else
-              wt_probe << setw(20) << setprecision(10) << pressure;
-          }
-          else
-            FatalError("Probe field not implemented yet!");
+          wt_probe << setw(20) << setprecision(10) << probe_buf_time[probe_out](t);
+          for (int j = 0; j < run_probe.n_probe_fields; j++) //write transient fields
+            wt_probe << setw(20) << setprecision(10) << probe_buf[probe_out](t, i, j);
+          wt_probe << endl;
         }
-        wt_probe << endl;
         wt_probe.close(); //close file
-        
     }
     if (myrank==0) cout<<"done."<<endl;
 }
@@ -1550,20 +2346,9 @@ void output::write_probe_hdf5()
   //probe declaration
   /*! Current rank*/
   int myrank = FlowSol->rank;
-  /*! Is viscous*/
-  int viscous = run_input.viscous;
-  /*! No. of solution fields */
-  int n_fields;
-  /*! No. of dimensions */
-  int n_dims = FlowSol->n_dims;
-  /*! reference location of probe point */
-  hf_array<double> loc_probe_point_temp(n_dims);
-  /*! solution data at probe points */
-  hf_array<double> disu_probe_point_temp;
-  //export data
-  hf_array<double> data;
   //final time
-  double fnl_time;
+  int n_buf = n_probe_buf[probe_out];
+  double fnl_time = probe_buf_time[probe_out](n_buf - 1);
   //counter of probe index on this processor
   int ct = 0;
   //hdf5 declare
@@ -1571,38 +2356,21 @@ void output::write_probe_hdf5()
   hsize_t dims[3], maxdims[3], offset[3], count[3];
   string temp_probe_fname;
 
-  //set fields
-  if (run_input.equation == 0) //ns
-  {
-    if (n_dims == 2)
-      n_fields = 4;
-    else
-      n_fields = 5;
-    if (run_input.RANS)
-      n_fields++;
-  }
-  else //ad-diff
-    n_fields = 1;
-
-  //set final time
-  if (viscous && run_input.equation == 0)
-    fnl_time = FlowSol->time * run_input.time_ref;
-  else
-    fnl_time = FlowSol->time;
-
-  //initialize temp solution array
-  disu_probe_point_temp.setup(n_fields);
-  disu_probe_point_temp.initialize_to_zero();
-
   if (myrank == 0)
     cout << "writing probe point data..."<<flush;
 
+  //memory space covers the whole buffer, laid out as (field,probe,sample)
+  dims[0] = run_probe.n_probe_fields;
+  dims[1] = probe_buf[probe_out].get_dim(1);
+  dims[2] = run_probe.probe_buffer;
+  memspace_id = H5Screate_simple(3, dims, NULL);
+
   for (int i = 0; i < run_probe.probe_name.get_dim(0); i++) //loop over each set of probe
   {
     //open file
     plist_id = H5Pcreate(H5P_FILE_ACCESS);
 #ifdef _MPI
-    H5Pset_fapl_mpio(plist_id, MPI_COMM_WORLD, MPI_INFO_NULL);
+    H5Pset_fapl_mpio(plist_id, out_comm, MPI_INFO_NULL);
 #endif
     temp_probe_fname = run_probe.probe_name(i) + ".h5";
     fid = H5Fopen(temp_probe_fname.c_str(), H5F_ACC_RDWR, plist_id);
@@ -1620,13 +2388,14 @@ void output::write_probe_hdf5()
     {
       dims[0] = run_probe.n_probe_fields;
       dims[1] = run_probe.probe_start(i + 1) - run_probe.probe_start(i); //number of probes belong this set
-      dims[2] = 1;//one snapshot
+      dims[2] = run_probe.probe_buffer; //one chunk holds a full buffer
       maxdims[0] = dims[0];
       maxdims[1] = dims[1];
       maxdims[2] = H5S_UNLIMITED;
-      dataspace_id = H5Screate_simple(3, dims, maxdims);
       chunk_prop = H5Pcreate(H5P_DATASET_CREATE);
       H5Pset_chunk(chunk_prop, 3, dims);
+      dims[2] = n_buf;
+      dataspace_id = H5Screate_simple(3, dims, maxdims);
       dataset_id = H5Dcreate2(fid, "data", H5T_NATIVE_DOUBLE, dataspace_id, H5P_DEFAULT, chunk_prop, H5P_DEFAULT);
       H5Pclose(chunk_prop);
     }
@@ -1636,97 +2405,33 @@ void output::write_probe_hdf5()
       dataspace_id = H5Dget_space(dataset_id);             //get old dataspace
       H5Sget_simple_extent_dims(dataspace_id, dims, NULL); //get old dimension
       H5Sclose(dataspace_id);//close old dataspace
-      //extend by one line
-      dims[2] += 1;
+      //extend by the buffered samples at once
+      dims[2] += n_buf;
       H5Dset_extent(dataset_id, dims);
       dataspace_id = H5Dget_space(dataset_id); //get new dataspace
     }
     H5Sselect_none(dataspace_id); //clear selection
 
-    //initialize output data array
-    data.setup(run_probe.set2n_probe(i), run_probe.n_probe_fields);
-    //create memoryspace
+    //select the buffered samples of the probes of this set belong to this processor
+    offset[0] = 0;
+    offset[1] = ct;
+    offset[2] = 0;
     count[0] = run_probe.n_probe_fields;
     count[1] = run_probe.set2n_probe(i);
-    count[2] = 1;
-    memspace_id = H5Screate_simple(3, count, NULL);
+    count[2] = n_buf;
+    if (run_probe.set2n_probe(i) == 0)
+      H5Sselect_none(memspace_id);
+    else if (H5Sselect_hyperslab(memspace_id, H5S_SELECT_SET, offset, NULL, count, NULL) < 0)
+      FatalError("Failed to get hyperslab");
 
-    offset[0] = 0;
     count[1] = 1;
-    offset[2] = dims[2] - 1;
+    offset[2] = dims[2] - n_buf;
     for (int j = 0; j < run_probe.set2n_probe(i); j++) //for each probe of this set belong to this processor
     {
       //select hyperslab
       offset[1] = run_probe.p2global_p[ct] - run_probe.probe_start(i);
       if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_OR, offset, NULL, count, NULL) < 0)
         FatalError("Failed to get hyperslab");
-
-      //load location of probe
-      for (int k = 0; k < n_dims; k++)
-        loc_probe_point_temp(k) = run_probe.loc_probe(k,ct);
-      //calculate fields data on probe points
-      FlowSol->mesh_eles(run_probe.p2t[ct])->set_opp_probe(loc_probe_point_temp);                             //calculate solution on upts to probe points matrix
-      FlowSol->mesh_eles(run_probe.p2t[ct])->calc_disu_probepoints(run_probe.p2c[ct], disu_probe_point_temp); //calculate solution on the reference probe point
-     
-      for (int k = 0; k < run_probe.n_probe_fields; k++)//for each sampled variable
-      {
-        if (run_probe.probe_fields(k) == "rho")
-        {
-          if (viscous && run_input.equation == 0)
-            data(j, k) = disu_probe_point_temp(0) * run_input.rho_ref;
-          else
-            data(j, k) = disu_probe_point_temp(0);
-        }
-        else if (run_probe.probe_fields(k) == "u")
-        {
-          if (viscous)
-            data(j, k) = disu_probe_point_temp(1) / disu_probe_point_temp(0) * run_input.uvw_ref;
-          else
-            data(j, k) = disu_probe_point_temp(1) / disu_probe_point_temp(0);
-        }
-        else if (run_probe.probe_fields(k) == "v")
-        {
-          if (viscous)
-            data(j, k) = disu_probe_point_temp(2) / disu_probe_point_temp(0) * run_input.uvw_ref;
-          else
-            data(j, k) = disu_probe_point_temp(2) / disu_probe_point_temp(0);
-        }
-        else if (run_probe.probe_fields(k) == "w")
-        {
-          if (n_dims == 3)
-          {
-            if (viscous)
-              data(j, k) = disu_probe_point_temp(3) / disu_probe_point_temp(0) * run_input.uvw_ref;
-            else
-              data(j, k) = disu_probe_point_temp(3) / disu_probe_point_temp(0);
-          }
-          else
-            FatalError("2 dimensional elements don't have z velocity");
-        }
-        else if (run_probe.probe_fields(k) == "specific_total_energy") //e
-        {
-          if (viscous)
-            data(j, k) = disu_probe_point_temp(n_dims + 1) / disu_probe_point_temp(0) * run_input.uvw_ref * run_input.uvw_ref;
-          else
-            data(j, k) = disu_probe_point_temp(n_dims + 1) / disu_probe_point_temp(0);
-        }
-        else if (run_probe.probe_fields(k) == "pressure")
-        {
-          double v_sq = 0.;
-          double pressure;
-          for (int m = 0; m < n_dims; m++)
-            v_sq += (disu_probe_point_temp(m + 1) * disu_probe_point_temp(m + 1));
-          v_sq /= disu_probe_point_temp(0) * disu_probe_point_temp(0);
-          // Compute pressure
-          pressure = (run_input.gamma - 1.0) * (disu_probe_point_temp(n_dims + 1) - 0.5 * disu_probe_point_temp(0) * v_sq);
-          if (viscous)
-            data(j, k) = pressure * run_input.p_ref;
-          else
-            data(j, k) = pressure;
-        }
-        else
-          FatalError("Probe field not implemented yet!");
-      }
       ct++;
     }
 
@@ -1736,14 +2441,14 @@ void output::write_probe_hdf5()
     //set collective read
     H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
 #endif
-    H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, memspace_id, dataspace_id, plist_id, data.get_ptr_cpu());
+    H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, memspace_id, dataspace_id, plist_id, probe_buf[probe_out].get_ptr_cpu());
     //close file
     H5Dclose(dataset_id);
     H5Sclose(dataspace_id);
-    H5Sclose(memspace_id);
     H5Pclose(plist_id);
     H5Fclose(fid);
   }
+  H5Sclose(memspace_id);
   if (myrank==0) cout<<"done."<<endl;
 }
 #endif
@@ -1786,7 +2491,7 @@ void output::write_restart_ascii(int in_file_num)
       }
 
     }
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(out_comm);
   }
 
   else//==1
@@ -1799,22 +2504,87 @@ void output::write_restart_ascii(int in_file_num)
 
   restart_file.open(file_name_s);
 
-  restart_file << FlowSol->time << endl;
+  restart_file << out_time << endl;
 
   //header
+  vector<long long> index;//global element number and byte offset of each element
   for (int i=0;i<FlowSol->n_ele_types;i++) {
       if (FlowSol->mesh_eles(i)->get_n_eles()!=0) {
 
           FlowSol->mesh_eles(i)->write_restart_info_ascii(restart_file);
-          FlowSol->mesh_eles(i)->write_restart_data_ascii(restart_file);
+          FlowSol->mesh_eles(i)->write_restart_data_ascii(restart_file,index);
 
         }
     }
 
   restart_file.close();
+
+  //index
+  if (FlowSol->nproc>1)
+    sprintf(file_name_s,"Rest_%.09d/Rest_%.09d.idx",in_file_num,in_file_num);
+  else
+    sprintf(file_name_s,"Rest_%.09d.idx",in_file_num);
+  write_restart_index(file_name_s,index);
+
   if (FlowSol->rank == 0)
     cout << "done" << endl;
 }
+
+// the restart index holds the number of elements and files followed by a (file number, byte offset) record for each global element
+
+void output::write_restart_index(char *in_file_name, vector<long long> &in_index)
+{
+  long long header[2] = {FlowSol->num_cells_global, FlowSol->nproc};
+  int n_local = in_index.size() / 2;
+
+#ifdef _MPI
+  MPI_File fh;
+  MPI_Datatype rec_type, file_type;
+  vector<int> ele_order(n_local), displ(n_local);
+  vector<long long> rec(2 * n_local);
+
+  //file view needs the records in ascending order
+  for (int i = 0; i < n_local; i++)
+    ele_order[i] = i;
+  sort(ele_order.begin(), ele_order.end(), [&in_index](int a, int b) { return in_index[2 * a] < in_index[2 * b]; });
+  for (int i = 0; i < n_local; i++)
+  {
+    displ[i] = in_index[2 * ele_order[i]];
+    rec[2 * i] = FlowSol->rank;
+    rec[2 * i + 1] = in_index[2 * ele_order[i] + 1];
+  }
+
+  MPI_Type_contiguous(2, MPI_LONG_LONG, &rec_type);
+  MPI_Type_commit(&rec_type);
+  MPI_Type_create_indexed_block(n_local, 1, displ.data(), rec_type, &file_type);
+  MPI_Type_commit(&file_type);
+
+  MPI_File_open(out_comm, in_file_name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+  MPI_File_set_size(fh, 0);
+  if (FlowSol->rank == 0)
+    MPI_File_write_at(fh, 0, header, 2, MPI_LONG_LONG, MPI_STATUS_IGNORE);
+  MPI_File_set_view(fh, sizeof(header), rec_type, file_type, "native", MPI_INFO_NULL);
+  MPI_File_write_all(fh, rec.data(), n_local, rec_type, MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+
+  MPI_Type_free(&file_type);
+  MPI_Type_free(&rec_type);
+#else
+  ofstream index_file;
+  vector<long long> all_rec(2 * FlowSol->num_cells_global, -1);
+
+  for (int i = 0; i < n_local; i++)
+  {
+    all_rec[2 * in_index[2 * i]] = 0;
+    all_rec[2 * in_index[2 * i] + 1] = in_index[2 * i + 1];
+  }
+
+  index_file.open(in_file_name, ios::binary);
+  index_file.write((char *)header, sizeof(header));
+  index_file.write((char *)all_rec.data(), all_rec.size() * sizeof(long long));
+  index_file.close();
+#endif
+}
 #endif
 
 #ifdef _HDF5
@@ -1822,7 +2592,8 @@ void output::write_restart_hdf5(int in_file_num)
 {
   char file_name_s[50];
   hsize_t dim[3];//dimension of data dataset
-  hid_t restart_file, time_id, order_id, plist_id, attr_dspace, dataset_id, dataspace_id;
+  hsize_t chunk[3];
+  hid_t restart_file, time_id, order_id, plist_id, attr_dspace, dataset_id, dataspace_id, dcpl_id;
   hf_array<bool> have_ele_type(FlowSol->n_ele_types);
 
   sprintf(file_name_s, "Rest_%.09d.h5", in_file_num);
@@ -1832,9 +2603,9 @@ void output::write_restart_hdf5(int in_file_num)
 
   #ifdef _MPI
   //Parallel read restart file
-  H5Pset_fapl_mpio(plist_id, MPI_COMM_WORLD, MPI_INFO_NULL);
+  H5Pset_fapl_mpio(plist_id, out_comm, MPI_INFO_NULL);
   hf_array<bool> have_ele_type_global(FlowSol->n_ele_types);
-  MPI_Allreduce(have_ele_type.get_ptr_cpu(), have_ele_type_global.get_ptr_cpu(), FlowSol->n_ele_types, MPI_C_BOOL, MPI_LOR, MPI_COMM_WORLD);
+  MPI_Allreduce(have_ele_type.get_ptr_cpu(), have_ele_type_global.get_ptr_cpu(), FlowSol->n_ele_types, MPI_C_BOOL, MPI_LOR, out_comm);
   have_ele_type = have_ele_type_global; //copy back
 #endif
 
@@ -1880,16 +2651,21 @@ void output::write_restart_hdf5(int in_file_num)
   //write time and order to attribution
   attr_dspace = H5Screate(H5S_SCALAR);
   time_id = H5Acreate2(restart_file, "nd_time", H5T_NATIVE_DOUBLE, attr_dspace, H5P_DEFAULT, H5P_DEFAULT);
-  H5Awrite(time_id, H5T_NATIVE_DOUBLE, &FlowSol->time);
+  H5Awrite(time_id, H5T_NATIVE_DOUBLE, &out_time);
   H5Aclose(time_id);
   order_id = H5Acreate2(restart_file, "order", H5T_NATIVE_INT32, attr_dspace, H5P_DEFAULT, H5P_DEFAULT);
   H5Awrite(order_id, H5T_NATIVE_INT32, &run_input.order);
   H5Aclose(order_id);
   H5Sclose(attr_dspace);
 
-//create "data" dataset
+//create "data" dataset, chunks hold all fields of about 1MB of whole elements
   dataspace_id = H5Screate_simple(3, dim, NULL);
-  dataset_id = H5Dcreate2(restart_file, "data", H5T_NATIVE_DOUBLE, dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  chunk[0] = dim[0];
+  chunk[1] = min(dim[1], max((hsize_t)1, (1 << 20) / (dim[0] * dim[2] * sizeof(double))));
+  chunk[2] = dim[2];
+  dcpl_id = create_filtered_plist(3, chunk, run_input.restart_compression, -1);
+  dataset_id = H5Dcreate2(restart_file, "data", H5T_NATIVE_DOUBLE, dataspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+  H5Pclose(dcpl_id);
   H5Sclose(dataspace_id);
   //each type of element write
   for (int i = 0; i < FlowSol->n_ele_types; i++)
@@ -1913,6 +2689,7 @@ void output::write_restart_hdf5(int in_file_num)
 
 void output::CalcForces(int in_file_num, bool write_forces)
 {
+  scoped_timer timer(T_CALC_FORCES);
   char file_name_s[256];
   char forcedir_s[256];
   struct stat st = {0};
@@ -1988,26 +2765,12 @@ void output::CalcForces(int in_file_num, bool write_forces)
         }
     }
 
-#ifdef _MPI
-//calculate sum of forces and lift/drag coeff and copy to master node
-  hf_array<double> inv_force_global(FlowSol->n_dims);
-  hf_array<double> vis_force_global(FlowSol->n_dims);
-  double coeff_lift_global;
-  double coeff_drag_global;
-
-  MPI_Reduce(FlowSol->inv_force.get_ptr_cpu(), inv_force_global.get_ptr_cpu(), FlowSol->n_dims, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(FlowSol->vis_force.get_ptr_cpu(), vis_force_global.get_ptr_cpu(), FlowSol->n_dims, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-
-  MPI_Reduce(&FlowSol->coeff_lift, &coeff_lift_global, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-  MPI_Reduce(&FlowSol->coeff_drag, &coeff_drag_global, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  // sum over the processors in the reduction of the next step, read by CompleteMonitoring
+  force_offset = run_reduction.add(FlowSol->inv_force.get_ptr_cpu(), FlowSol->n_dims, RO_SUM);
+  run_reduction.add(FlowSol->vis_force.get_ptr_cpu(), FlowSol->n_dims, RO_SUM);
+  run_reduction.add(&FlowSol->coeff_lift, 1, RO_SUM);
+  run_reduction.add(&FlowSol->coeff_drag, 1, RO_SUM);
 
-  FlowSol->inv_force = inv_force_global;
-  FlowSol->vis_force = vis_force_global;
-
-  FlowSol->coeff_lift = coeff_lift_global;
-  FlowSol->coeff_drag = coeff_drag_global;
-
-#endif
   if (write_forces)
     coeff_file.close();
 }
@@ -2015,6 +2778,8 @@ void output::CalcForces(int in_file_num, bool write_forces)
 // Calculate integral diagnostic quantities
 void output::CalcIntegralQuantities(void) {
 
+  scoped_timer timer(T_INTEGRAL_QUANTITIES);
+
   int nintq = run_input.n_integral_quantities;
 
   // initialize to zero
@@ -2025,19 +2790,15 @@ void output::CalcIntegralQuantities(void) {
       if (FlowSol->mesh_eles(i)->get_n_eles()!=0)
           FlowSol->mesh_eles(i)->CalcIntegralQuantities(nintq, FlowSol->integral_quantities);
 
-#ifdef _MPI
-
-  hf_array<double> integral_quantities_global(nintq);
-  MPI_Reduce(FlowSol->integral_quantities.get_ptr_cpu(), integral_quantities_global.get_ptr_cpu(), nintq, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-
-  //copy back to integral_quantities
-  FlowSol->integral_quantities = integral_quantities_global;
-#endif
+  // sum over the processors in the reduction of the next step, read by CompleteMonitoring
+  intq_offset = run_reduction.add(FlowSol->integral_quantities.get_ptr_cpu(), nintq, RO_SUM);
 }
 
 // Calculate time averaged diagnostic quantities
 void output::CalcTimeAverageQuantities(void) {
 
+  scoped_timer timer(T_TIME_AVERAGE);
+
   // Loop over element types
   for(int i=0;i<FlowSol->n_ele_types;i++)
     {
@@ -2085,12 +2846,13 @@ void output::compute_error(int in_file_num)
     }
   }
 
-#ifdef _MPI
-
-  hf_array<double> error_global(2, n_fields);
-  MPI_Reduce(error.get_ptr_cpu(), error_global.get_ptr_cpu(), 2 * n_fields, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-  error = error_global;
-#endif
+  // once at the end of the run, so the reduction is completed at once
+  int error_offset = run_reduction.add(error.get_ptr_cpu(), 2 * n_fields, RO_SUM);
+  run_reduction.post();
+  run_reduction.wait();
+  const double *error_global = run_reduction.get(error_offset);
+  for (int i = 0; i < 2 * n_fields; i++)
+    error.get_ptr_cpu()[i] = error_global[i];
 
   if (FlowSol->rank == 0)
   {
@@ -2162,7 +2924,22 @@ void output::compute_error(int in_file_num)
 
 }
 
-void output::CalcNormResidual(void) {
+// start the interval of the run metrics at in_file_num
+
+void output::reset_metrics(int in_file_num)
+{
+  metrics_time = chrono::steady_clock::now();
+  metrics_file_num = in_file_num;
+  metrics_wait = run_timers.get_seconds(T_MPI_WAIT) + run_timers.get_seconds(T_REDUCTION_WAIT);
+  metrics_io = run_timers.get_seconds(T_WRITE_OUTPUTS);
+  metrics_residuals = run_timers.get_calls(T_CALC_RESIDUAL);
+  wall_per_step = dof_updates_per_s = 0.;
+  step_time_min = step_time_max = step_imbalance = io_time = 0.;
+}
+
+void output::CalcNormResidual(int in_file_num) {
+
+  scoped_timer timer(T_NORM_RESIDUAL);
 
   int n_upts = 0;
   int n_fields;
@@ -2213,27 +2990,76 @@ void output::CalcNormResidual(void) {
     }
   }
 
-#ifdef _MPI
-  hf_array<double> sum_global(n_fields);
-  if (run_input.res_norm_type == 0) {
-    // Get maximum
-    MPI_Reduce(sum.get_ptr_cpu(), sum_global.get_ptr_cpu(), n_fields, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  // Run metrics of this rank since the previous call: the busy time excludes the halo and reduction waits and the output
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  int n_steps = max(in_file_num - metrics_file_num, 1);
+  double wall = chrono::duration<double>(now - metrics_time).count();
+  double wait = run_timers.get_seconds(T_MPI_WAIT) + run_timers.get_seconds(T_REDUCTION_WAIT), io = run_timers.get_seconds(T_WRITE_OUTPUTS);
+  long long n_residuals = run_timers.get_calls(T_CALC_RESIDUAL);
+  double busy = (wall - (wait - metrics_wait) - (io - metrics_io)) / n_steps;
+
+  // The residual and the metrics go in the reduction of the next step, read by CompleteMonitoring
+  res_offset = run_reduction.add(sum.get_ptr_cpu(), n_fields, (run_input.res_norm_type == 0) ? RO_MAX : RO_SUM);
+  double sums[2] = {(double)n_upts, busy};
+  double maxima[3] = {busy, io - metrics_io, wall};
+  run_reduction.add(sums, 2, RO_SUM);
+  run_reduction.add(maxima, 3, RO_MAX);
+  run_reduction.add(&busy, 1, RO_MIN);
+  res_n_fields = n_fields;
+  res_n_steps = n_steps;
+  res_n_residuals = n_residuals - metrics_residuals;
+
+  metrics_time = now;
+  metrics_file_num = in_file_num;
+  metrics_wait = wait;
+  metrics_io = io;
+  metrics_residuals = n_residuals;
+}
+
+void output::CompleteMonitoring(void)
+{
+  run_reduction.wait();
+
+  if (force_offset >= 0)
+  {
+    const double *vals = run_reduction.get(force_offset);
+    for (int i = 0; i < FlowSol->n_dims; i++)
+    {
+      FlowSol->inv_force(i) = vals[i];
+      FlowSol->vis_force(i) = vals[FlowSol->n_dims + i];
+    }
+    FlowSol->coeff_lift = vals[2 * FlowSol->n_dims];
+    FlowSol->coeff_drag = vals[2 * FlowSol->n_dims + 1];
+    force_offset = -1;
   }
-  else {
-    // Get sum
-    int n_upts_global;
-    MPI_Reduce(&n_upts, &n_upts_global, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(sum.get_ptr_cpu(), sum_global.get_ptr_cpu(), n_fields, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    n_upts = n_upts_global;
+
+  if (intq_offset >= 0)
+  {
+    const double *vals = run_reduction.get(intq_offset);
+    for (int i = 0; i < run_input.n_integral_quantities; i++)
+      FlowSol->integral_quantities(i) = vals[i];
+    intq_offset = -1;
   }
-  sum = sum_global;
 
-#endif
+  if (res_offset < 0)
+    return;
+
+  // residual, then the sums of the points and busy times, the maxima of the busy, output and wall times and the minimum busy time
+  const double *sum = run_reduction.get(res_offset);
+  const double *sums = sum + res_n_fields, *maxima = sums + 2, *minimum = maxima + 3;
+  double n_upts = sums[0];
+  step_time_max = maxima[0];
+  step_time_min = minimum[0];
+  step_imbalance = sums[1] > 0. ? step_time_max * FlowSol->nproc / sums[1] : 1.;
+  io_time = maxima[1];
+  wall_per_step = maxima[2] / res_n_steps;
+  dof_updates_per_s = maxima[2] > 0. ? (double)FlowSol->num_upts_global * res_n_fields * res_n_residuals / maxima[2] : 0.;
+  res_offset = -1;
 
   if (FlowSol->rank == 0) {
 
     // Compute the norm
-    for(int i=0; i<n_fields; i++) {
+    for(int i=0; i<res_n_fields; i++) {
       if (run_input.res_norm_type==0) { FlowSol->norm_residual(i) = sum[i]; } // Infinity Norm
       else if (run_input.res_norm_type==1) { FlowSol->norm_residual(i) = sum[i] / n_upts; } // L1 norm
       else if (run_input.res_norm_type==2) { FlowSol->norm_residual(i) = sqrt(sum[i]) / n_upts; } // L2 norm
@@ -2248,6 +3074,8 @@ void output::CalcNormResidual(void) {
 
 void output::HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist) {
 
+  scoped_timer timer(T_HISTORY_OUTPUT);
+
   int i, n_fields;
   clock_t final;
   ios_base::openmode mode;
@@ -2335,7 +3163,10 @@ void output::HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist)
           write_hist[0] << ",\"Diagnostics[" << run_input.integral_quantities(i) << "]\"";
 
         // Add physical and computational time
-        write_hist[0] << ",\"Time<sub>Physical</sub>(sec)\",\"Time<sub>Comp</sub>(m)\"" << endl;
+        write_hist[0] << ",\"Time<sub>Physical</sub>(sec)\",\"Time<sub>Comp</sub>(m)\"";
+
+        // Add throughput and imbalance of the steps since the previous line
+        write_hist[0] << ",\"Time<sub>Wall</sub>/step(sec)\",\"DOF updates/sec\",\"Time<sub>Step,min</sub>(sec)\",\"Time<sub>Step,max</sub>(sec)\",\"Imbalance\",\"Time<sub>IO</sub>(sec)\"" << endl;
 
         write_hist[0] << "ZONE T= \"Convergence history\"" << endl;
       }
@@ -2402,7 +3233,10 @@ void output::HistoryOutput(int in_file_num, clock_t init, ofstream *write_hist)
 
             // Compute execution time
             final = clock() - init;
-            write_hist[0] << ", " << (double)final / (((double)CLOCKS_PER_SEC) * 60.0) << endl;
+            write_hist[0] << ", " << (double)final / (((double)CLOCKS_PER_SEC) * 60.0);
+
+            write_hist[0] << ", " << wall_per_step << ", " << dof_updates_per_s << ", " << step_time_min << ", " << step_time_max
+                          << ", " << step_imbalance << ", " << io_time << endl;
   }
 }
 
@@ -2421,6 +3255,9 @@ void output::check_stability(void)
   double i_tol    = 1.0e-4;
   double e_thresh = 1.5;
 
+  // read the live solution, not a snapshot still being written
+  wait_outputs();
+
   bisect_ind = run_input.bis_ind;
   file_lines = run_input.file_lines;
 
@@ -57,6 +57,8 @@ void probe_input::setup(char *fileNameC, struct solution *FlowSol, int rank)
     n_dims = FlowSol->n_dims;//simulation dimension
     read_probe_input(rank);
     set_probe_connectivity(FlowSol, rank);
+    if (fwh_surface != "")
+        set_fwh_surface(rank);
 #ifdef _HDF5
     create_probe_hdf5(rank);
 #else
@@ -289,7 +291,18 @@ void probe_input::read_probe_input(int rank)
                        probe_fields(i).begin(), ::tolower);
     }
     probf.getScalarValue("probe_freq", probe_freq);
+    probf.getScalarValue("probe_buffer", probe_buffer, 1);
+    if (probe_buffer < 1)
+        FatalError("probe_buffer must be at least 1");
     probf.getScalarValue("probe_source_file", probe_source_file);
+    probf.getScalarValue("fwh_surface", fwh_surface, string(""));
+    if (fwh_surface != "")
+    {
+        probf.getScalarValue("fwh_observer_file", fwh_observer_file);
+        //the observer signal is binned at the fixed sample interval dt*probe_freq
+        if (run_input.dt_type != 0)
+            FatalError("FW-H integration requires a fixed time step (dt_type 0)");
+    }
     probf.closeFile();
 
     /*!----------calculate probes coordinates ------------*/
@@ -391,6 +404,43 @@ void probe_input::set_probe_connectivity(struct solution *FlowSol, int rank)
         cout << "done" << endl;
 }
 
+// collect the local points of the FW-H surface with their non-dimensional position, normal and area
+
+void probe_input::set_fwh_surface(int rank)
+{
+    int id;
+    for (id = 0; id < probe_name.get_dim(0); id++)
+        if (probe_name(id) == fwh_surface)
+            break;
+    if (id == probe_name.get_dim(0))
+        FatalError("FW-H surface not found in the probe sets");
+    if (!probe_surf_flag(id))
+        FatalError("FW-H surface must be a surface probe set");
+    if (n_dims != 3 || run_input.equation != 0)
+        FatalError("FW-H integration is only implemented for 3D Euler/Navier-Stokes");
+
+    for (int i = 0; i < n_probe; i++)
+        if (p2global_p[i] >= probe_start(id) && p2global_p[i] < probe_start(id + 1))
+            fwh_probe.push_back(i);
+
+    fwh_pos.setup(n_dims, max((int)fwh_probe.size(), 1));
+    fwh_normal.setup(n_dims, max((int)fwh_probe.size(), 1));
+    fwh_area.resize(fwh_probe.size());
+    for (size_t i = 0; i < fwh_probe.size(); i++)
+    {
+        int gp = p2global_p[fwh_probe[i]];
+        for (int k = 0; k < n_dims; k++)
+        {
+            fwh_pos(k, i) = pos_probe_global(k, gp);
+            fwh_normal(k, i) = surf_normal[(gp - surf_offset) * n_dims + k];
+        }
+        fwh_area[i] = surf_area[gp - surf_offset];
+    }
+
+    if (rank == 0)
+        cout << fwh_surface << " set as FW-H surface" << endl;
+}
+
 void probe_input::read_probe_script(string filename)
 {
     //macros to skip white spaces and compare syntax
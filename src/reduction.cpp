@@ -0,0 +1,112 @@
+/*!
+ * \file reduction.cpp
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include "../include/reduction.h"
+#include "../include/error.h"
+#include "../include/timer.h"
+
+using namespace std;
+
+reduction_aggregator run_reduction;
+
+#ifdef _MPI
+//layout of the reduction in flight, read by the operation whenever the library applies it
+static const char *reduce_ops;
+static int reduce_n_vals;
+
+static void combine_values(void *in_vals, void *inout_vals, int *len, MPI_Datatype *type)
+{
+  double *a = (double *)in_vals, *b = (double *)inout_vals;
+  for (int k = 0; k < *len; k++, a += reduce_n_vals, b += reduce_n_vals)
+    for (int i = 0; i < reduce_n_vals; i++)
+    {
+      if (reduce_ops[i] == RO_SUM)
+        b[i] += a[i];
+      else if (reduce_ops[i] == RO_MAX)
+        b[i] = max(a[i], b[i]);
+      else
+        b[i] = min(a[i], b[i]);
+    }
+}
+#endif
+
+reduction_aggregator::reduction_aggregator() : posted(false), done(false)
+{
+#ifdef _MPI
+  comm = MPI_COMM_NULL;
+#endif
+}
+
+int reduction_aggregator::add(const double *in_vals, int in_n, int in_op)
+{
+  if (posted)
+    FatalError("Values added to a reduction in flight");
+  if (done)
+  {
+    values.clear();
+    ops.clear();
+    done = false;
+  }
+  int offset = values.size();
+  values.insert(values.end(), in_vals, in_vals + in_n);
+  ops.insert(ops.end(), in_n, (char)in_op);
+  return offset;
+}
+
+void reduction_aggregator::post(void)
+{
+  if (posted)
+    FatalError("Reduction posted twice");
+  if (done || values.empty())
+    return;
+  results.resize(values.size());
+#ifdef _MPI
+  //a communicator of its own keeps the reduction apart from the collectives issued while it is in flight
+  if (comm == MPI_COMM_NULL)
+  {
+    MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+    MPI_Op_create(combine_values, 1, &op);
+  }
+  reduce_ops = ops.data();
+  reduce_n_vals = values.size();
+  MPI_Type_contiguous(values.size(), MPI_DOUBLE, &type);
+  MPI_Type_commit(&type);
+  MPI_Iallreduce(values.data(), results.data(), 1, type, op, comm, &request);
+#else
+  results = values;
+#endif
+  posted = true;
+}
+
+void reduction_aggregator::wait(void)
+{
+  if (!posted)
+    return;
+#ifdef _MPI
+  scoped_timer timer(T_REDUCTION_WAIT);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  MPI_Type_free(&type);
+#endif
+  posted = false;
+  done = true;
+}
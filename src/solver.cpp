@@ -33,6 +33,8 @@
 #include "../include/eles_pris.h"
 #include "../include/int_inters.h"
 #include "../include/bdy_inters.h"
+#include "../include/timer.h"
+#include "../include/reduction.h"
 
 #ifdef _MPI
 #include "../include/mpi_inters.h"
@@ -47,9 +49,22 @@
 
 using namespace std;
 
+// while profiling the halo exchanges, record the neighbor messages that arrived during the stage just computed,
+// so their completion time is not pushed back to the wait at the end of the overlap
+
+static void poll_mpi_inters(struct solution* FlowSol)
+{
+#ifdef _MPI
+  if (run_comm.is_active() && FlowSol->nproc>1)
+    for(int i=0; i<FlowSol->n_mpi_inter_types; i++)
+      FlowSol->mesh_mpi_inters(i).poll_exchanges();
+#endif
+}
+
 void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
 
   int i;                            /*!< Loop iterator */
+  scoped_timer residual_timer(T_CALC_RESIDUAL);
 
   /*! If at first RK step and using certain LES models, compute some model-related quantities. */
   if (run_input.LES == 1 && in_rk_stage == 0)
@@ -57,38 +72,52 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
     if (run_input.SGS_model == 2 || run_input.SGS_model == 3 || run_input.SGS_model == 4)
     { //similarity and svv
       for (i = 0; i < FlowSol->n_ele_types; i++)
+      {
+        scoped_timer timer(T_SGS_TERMS, FlowSol->mesh_eles(i)->get_ele_type());
         FlowSol->mesh_eles(i)->calc_sgs_terms();
+      }
     }
   }
 
     /*! Extrapolate the solution to the flux points. */
     for(i=0; i<FlowSol->n_ele_types; i++)
+    {
+      scoped_timer timer(T_EXTRAPOLATE_SOLUTION, FlowSol->mesh_eles(i)->get_ele_type());
       FlowSol->mesh_eles(i)->extrapolate_solution();
+    }
 
 #ifdef _MPI
   /*! Send the solution at the flux points across the MPI interfaces. */
   if (FlowSol->nproc>1)
+  {
+    scoped_timer timer(T_SEND_SOLUTION);
     for(i=0; i<FlowSol->n_mpi_inter_types; i++)
       FlowSol->mesh_mpi_inters(i).send_solution();
+  }
 #endif
 
   if (run_input.viscous) {
       /*! Compute the uncorrected transformed gradient of the solution at the solution points. */
       for(i=0; i<FlowSol->n_ele_types; i++)
+      {
+        scoped_timer timer(T_CALC_GRADIENT, FlowSol->mesh_eles(i)->get_ele_type());
         FlowSol->mesh_eles(i)->calculate_gradient();
+      }
+      poll_mpi_inters(FlowSol);
     }
 
   /*! Compute the transformed inviscid flux at the solution points and store in total transformed flux storage. */
-  if(run_input.over_int)
-  {
   for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->evaluate_invFlux_over_int();
-  }
-  else
   {
-  for(i=0; i<FlowSol->n_ele_types; i++)
-    FlowSol->mesh_eles(i)->evaluate_invFlux();
+    scoped_timer timer(T_INV_FLUX, FlowSol->mesh_eles(i)->get_ele_type());
+    if(run_input.over_int == 1)
+      FlowSol->mesh_eles(i)->evaluate_invFlux_over_int();
+    else if(run_input.over_int == 2)
+      FlowSol->mesh_eles(i)->evaluate_invFlux_over_int_selective();
+    else
+      FlowSol->mesh_eles(i)->evaluate_invFlux();
   }
+  poll_mpi_inters(FlowSol);
 
 
 
@@ -96,6 +125,8 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
   // calculate body forcing and add to source term
   if(run_input.forcing==1 and in_rk_stage==0 and run_input.equation==0 and FlowSol->n_dims==3)
   {
+    scoped_timer timer(T_BODY_FORCE);
+    complete_time_step(FlowSol); //the forcing uses the time step of this step
 #ifdef _GPU
     // copy disu_upts for body force calculation
     for(i=0; i<FlowSol->n_ele_types; i++)
@@ -110,18 +141,29 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
 
   /*! Compute the transformed normal inviscid numerical fluxes.
    Compute the common solution and solution corrections (viscous only). */
-  for(i=0; i<FlowSol->n_int_inter_types; i++)
-    FlowSol->mesh_int_inters(i).calculate_common_invFlux();
+  {
+    scoped_timer timer(T_INT_INV_FLUX);
+    for(i=0; i<FlowSol->n_int_inter_types; i++)
+      FlowSol->mesh_int_inters(i).calculate_common_invFlux();
+  }
+  poll_mpi_inters(FlowSol);
 
-  for(i=0; i<FlowSol->n_bdy_inter_types; i++)
-    FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_invFlux(FlowSol->time);//TODO:use RK_time instead
+  {
+    scoped_timer timer(T_BDY_INV_FLUX);
+    for(i=0; i<FlowSol->n_bdy_inter_types; i++)
+      FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_invFlux(FlowSol->time);//TODO:use RK_time instead
+  }
 
 #ifdef _MPI
   /*! Send the previously computed values across the MPI interfaces. */
   if (FlowSol->nproc>1) {
-      for(i=0; i<FlowSol->n_mpi_inter_types; i++)
-        FlowSol->mesh_mpi_inters(i).receive_solution();
+      {
+        scoped_timer timer(T_RECEIVE_SOLUTION);
+        for(i=0; i<FlowSol->n_mpi_inter_types; i++)
+          FlowSol->mesh_mpi_inters(i).receive_solution();
+      }
 
+      scoped_timer timer(T_MPI_INV_FLUX);
       for(i=0; i<FlowSol->n_mpi_inter_types; i++)
         FlowSol->mesh_mpi_inters(i).calculate_common_invFlux();
     }
@@ -131,12 +173,16 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
     {
       /*! Compute physical corrected gradient of the solution at the solution and flux points. */
       for(i=0; i<FlowSol->n_ele_types; i++)
+      {
+        scoped_timer timer(T_CORRECT_GRADIENT, FlowSol->mesh_eles(i)->get_ele_type());
         FlowSol->mesh_eles(i)->correct_gradient();
+      }
 
 #ifdef _MPI
       /*! Send the corrected physical gradients across the MPI interface. */
       if (FlowSol->nproc>1)
       {
+        scoped_timer timer(T_SEND_GRADIENT);
         for(i=0; i<FlowSol->n_mpi_inter_types; i++)
           FlowSol->mesh_mpi_inters(i).send_corrected_gradient();
       }
@@ -145,13 +191,21 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
       /*! Compute discontinuous transformed viscous flux at upts and add to total transformed flux at upts. */
       /*! If using LES, compute the transformed SGS flux and add to total transformed flux at solution points. */
       for(i=0; i<FlowSol->n_ele_types; i++)
+      {
+        scoped_timer timer(T_VISC_FLUX, FlowSol->mesh_eles(i)->get_ele_type());
         FlowSol->mesh_eles(i)->evaluate_viscFlux();
+      }
+      poll_mpi_inters(FlowSol);
 
       //If using LES, extrapolate transformed SGS flux to flux points and transform back to physical domain
       if (run_input.LES)
       {
         for(i=0; i<FlowSol->n_ele_types; i++)
+        {
+          scoped_timer timer(T_SGS_FLUX, FlowSol->mesh_eles(i)->get_ele_type());
           FlowSol->mesh_eles(i)->extrapolate_sgsFlux();
+        }
+        poll_mpi_inters(FlowSol);
       }
 
 //If using MPI and LES, send SGS flux across processors
@@ -160,6 +214,7 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
       {
         if (run_input.LES)
         {
+          scoped_timer timer(T_SEND_SGSF);
           for (i = 0; i < FlowSol->n_mpi_inter_types; i++)
             FlowSol->mesh_mpi_inters(i).send_sgsf_fpts();
         }
@@ -168,31 +223,51 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
     }
     /*! For viscous or inviscid, compute the transformed normal discontinuous total flux at flux points. */
     for(i=0; i<FlowSol->n_ele_types; i++)
+    {
+      scoped_timer timer(T_TOTAL_FLUX, FlowSol->mesh_eles(i)->get_ele_type());
       FlowSol->mesh_eles(i)->extrapolate_totalFlux();
+    }
+    poll_mpi_inters(FlowSol);
 
     /*! For viscous or inviscid, compute the transformed divergence of total flux at solution points. */
     for(i=0; i<FlowSol->n_ele_types; i++)
+    {
+      scoped_timer timer(T_DIVERGENCE, FlowSol->mesh_eles(i)->get_ele_type());
       FlowSol->mesh_eles(i)->calculate_divergence();
+    }
+    poll_mpi_inters(FlowSol);
 
     if (run_input.viscous) {
       /*! Compute transformed normal interface viscous flux and add to transformed normal inviscid flux. */
-      for(i=0; i<FlowSol->n_int_inter_types; i++)
-        FlowSol->mesh_int_inters(i).calculate_common_viscFlux();
+      {
+        scoped_timer timer(T_INT_VISC_FLUX);
+        for(i=0; i<FlowSol->n_int_inter_types; i++)
+          FlowSol->mesh_int_inters(i).calculate_common_viscFlux();
+      }
+      poll_mpi_inters(FlowSol);
 
-      for(i=0; i<FlowSol->n_bdy_inter_types; i++)
-        FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_viscFlux(FlowSol->time);//TODO: use RK_time instead
+      {
+        scoped_timer timer(T_BDY_VISC_FLUX);
+        for(i=0; i<FlowSol->n_bdy_inter_types; i++)
+          FlowSol->mesh_bdy_inters(i).evaluate_boundaryConditions_viscFlux(FlowSol->time);//TODO: use RK_time instead
+      }
 
 #if _MPI
       /*! Evaluate the MPI interfaces. */
       if (FlowSol->nproc>1) {
-          for(i=0; i<FlowSol->n_mpi_inter_types; i++)
-            FlowSol->mesh_mpi_inters(i).receive_corrected_gradient();
+          {
+            scoped_timer timer(T_RECEIVE_GRADIENT);
+            for(i=0; i<FlowSol->n_mpi_inter_types; i++)
+              FlowSol->mesh_mpi_inters(i).receive_corrected_gradient();
+          }
 
           if (run_input.LES) {
+            scoped_timer timer(T_RECEIVE_SGSF);
             for(i=0; i<FlowSol->n_mpi_inter_types; i++)
             FlowSol->mesh_mpi_inters(i).receive_sgsf_fpts();
           }
 
+          scoped_timer timer(T_MPI_VISC_FLUX);
           for(i=0; i<FlowSol->n_mpi_inter_types; i++)
             FlowSol->mesh_mpi_inters(i).calculate_common_viscFlux();
         }
@@ -201,12 +276,18 @@ void CalcResidual(int in_file_num, int in_rk_stage, struct solution* FlowSol) {
 
   /*! Compute the transformed divergence of the continuous flux. */
   for(i=0; i<FlowSol->n_ele_types; i++)
+  {
+    scoped_timer timer(T_CORRECTED_DIVERGENCE, FlowSol->mesh_eles(i)->get_ele_type());
     FlowSol->mesh_eles(i)->calculate_corrected_divergence();
+  }
 
   /*! Compute source term */
   if (run_input.RANS==1) {
     for (i=0; i<FlowSol->n_ele_types; i++)
+    {
+      scoped_timer timer(T_SOURCE_SA, FlowSol->mesh_eles(i)->get_ele_type());
       FlowSol->mesh_eles(i)->calc_src_upts_SA();
+    }
   }
 }
 
@@ -349,6 +430,25 @@ void read_restart_ascii(int in_file_num, int in_n_files, struct solution* FlowSo
   ifstream restart_file;
   restart_file.precision(15);
 
+  // Use the restart index written with the files to read only the elements of this processor
+  if (in_n_files!=1)
+    sprintf(file_name_s,"Rest_%.09d/Rest_%.09d.idx",in_file_num,in_file_num);
+  else
+    sprintf(file_name_s,"Rest_%.09d.idx",in_file_num);
+  ifstream index_file(file_name_s,ios::binary);
+  if (index_file)
+    {
+      long long header[2];
+      index_file.read((char*)header,sizeof(header));
+      if (index_file && header[0]==FlowSol->num_cells_global && header[1]==in_n_files)
+        {
+          read_restart_ascii_index(in_file_num,in_n_files,index_file,FlowSol);
+          return;
+        }
+      if (FlowSol->rank==0)
+        cout << "restart index does not match the restart files, reading all files ... " << flush;
+    }
+
   // Open the restart files and read info
 
   for (int i=0;i<FlowSol->n_ele_types;i++) {
@@ -400,6 +500,52 @@ void read_restart_ascii(int in_file_num, int in_n_files, struct solution* FlowSo
     }
 }
 
+void read_restart_ascii_index(int in_file_num, int in_n_files, ifstream& index_file, struct solution* FlowSol)
+{
+  char file_name_s[50];
+  ifstream restart_file;
+  vector<string> file_names(in_n_files);
+  hf_array<long long> index;
+
+  for (int j=0;j<in_n_files;j++)
+    {
+      if(in_n_files!=1)
+        sprintf(file_name_s,"Rest_%.09d/Rest_%.09d_p%.04d.dat",in_file_num,in_file_num,j);//in folder
+      else
+        sprintf(file_name_s,"Rest_%.09d_p%.04d.dat",in_file_num,j);
+      file_names[j]=file_name_s;
+    }
+
+  for (int i=0;i<FlowSol->n_ele_types;i++) {
+      int n_eles=FlowSol->mesh_eles(i)->get_n_eles();
+      if (n_eles!=0) {
+
+          // index record of each element is (file number, byte offset), stored by global element number
+          index.setup(2,n_eles);
+          for (int j=0;j<n_eles;j++)
+            {
+              index_file.seekg((2+2*(long long)FlowSol->mesh_eles(i)->get_ele2global_ele(j))*sizeof(long long));
+              index_file.read((char*)index.get_ptr_cpu(0,j),2*sizeof(long long));
+            }
+          if (!index_file)
+            FatalError("Could not read restart index");
+          if (index(0,0)<0)
+            FatalError("Element missing from the restart index");
+
+          // info of this element type is in the file holding its first element
+          restart_file.open(file_names[index(0,0)].c_str());
+          if (!restart_file)
+            FatalError("Could not open restart file ");
+          restart_file >> FlowSol->time;
+          if (!FlowSol->mesh_eles(i)->read_restart_info_ascii(restart_file))
+            FatalError("Could not find element type in restart file");
+          restart_file.close();
+
+          FlowSol->mesh_eles(i)->read_restart_data_ascii(file_names,index);
+        }
+    }
+}
+
 #ifdef _HDF5
 void read_restart_hdf5(int in_file_num, struct solution *FlowSol)
 {
@@ -449,8 +595,12 @@ void read_restart_hdf5(int in_file_num, struct solution *FlowSol)
 }
 #endif
 
+//offset of the minimum time step in run_reduction, -1 once copied to run_input.dt
+static int dt_offset = -1;
+
 void calc_time_step(struct solution *FlowSol)
 {
+  scoped_timer timer(T_CALC_TIME_STEP);
   if (run_input.dt_type == 1) //global time step
   {
     // If using global minimum timestep based on CFL, determine
@@ -470,17 +620,8 @@ void calc_time_step(struct solution *FlowSol)
       }
     }
 
-#ifdef _MPI
-    // If in parallel and using global minumum timestep, allocate storage
-    // for minimum timesteps in each partition
-    if (FlowSol->nproc > 1)
-    {
-      double dt_globe_mpi;
-      MPI_Allreduce(&dt_globe, &dt_globe_mpi, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
-      dt_globe = dt_globe_mpi;
-    }
-#endif
-    run_input.dt = dt_globe; //copy to run_input.dt
+    // global minimum over the partitions, copied to run_input.dt by complete_time_step
+    dt_offset = run_reduction.add(&dt_globe, 1, RO_MIN);
   }
   // If using local timestepping, just compute and store all local
   // timesteps
@@ -503,15 +644,17 @@ void calc_time_step(struct solution *FlowSol)
           dt_local_min = dt_local_min_new;
       }
     }
-    //if run in parallel, find out global minimum time step
-#ifdef _MPI
-    if (FlowSol->nproc > 1)
-    {
-      double dt_local_mpi;
-      MPI_Allreduce(&dt_local_min, &dt_local_mpi, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
-      dt_local_min = dt_local_mpi;
-    }
-#endif
-    run_input.dt = dt_local_min; //copy to run_input.dt
+    // global minimum time step, copied to run_input.dt by complete_time_step
+    dt_offset = run_reduction.add(&dt_local_min, 1, RO_MIN);
+  }
+}
+
+void complete_time_step(struct solution *FlowSol)
+{
+  run_reduction.wait();
+  if (dt_offset >= 0)
+  {
+    run_input.dt = *run_reduction.get(dt_offset);
+    dt_offset = -1;
   }
 }
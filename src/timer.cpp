@@ -0,0 +1,705 @@
+/*!
+ * \file timer.cpp
+ * \author - Original code: HiFiLES Aerospace Computing Laboratory (ACL)
+ *                                Aero/Astro Department. Stanford University.
+ *         - Current development: Weiqi Shen
+ *                                University of Florida
+ *
+ * High Fidelity Large Eddy Simulation (HiFiLES) Code.
+ *
+ * HiFiLES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HiFiLES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HiFiLES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include "../include/timer.h"
+#include "../include/error.h"
+
+#ifdef _MPI
+#include "mpi.h"
+#endif
+
+#ifdef _PERF_EVENT
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace std;
+
+timer_registry run_timers;
+trace_recorder run_trace;
+perf_counters run_perf;
+comm_profiler run_comm;
+
+//trace buffer and track name of the calling thread
+static thread_local void *local_trace_buffer = nullptr;
+static thread_local const char *local_trace_name = nullptr;
+
+static const char *timer_names[N_TIMERS] = {
+    "calc_residual",
+    "sgs_terms",
+    "extrapolate_solution",
+    "send_solution",
+    "calc_gradient",
+    "inv_flux",
+    "body_force",
+    "int_inv_flux",
+    "bdy_inv_flux",
+    "receive_solution",
+    "mpi_inv_flux",
+    "correct_gradient",
+    "send_gradient",
+    "visc_flux",
+    "sgs_flux",
+    "send_sgsf",
+    "total_flux",
+    "divergence",
+    "int_visc_flux",
+    "bdy_visc_flux",
+    "receive_gradient",
+    "receive_sgsf",
+    "mpi_wait",
+    "mpi_visc_flux",
+    "corrected_divergence",
+    "source_SA",
+    "calc_time_step",
+    "reduction_wait",
+    "advance_solution",
+    "shock_capture",
+    "time_average",
+    "calc_forces",
+    "integral_quantities",
+    "norm_residual",
+    "history_output",
+    "write_outputs",
+    "write_plot",
+    "write_probe",
+    "write_restart"};
+
+static const char *timer_type_names[N_TIMER_TYPES] = {"tri", "quad", "tet", "pri", "hex", "pyr", "-"};
+
+static const char *exchange_names[N_COMM_EXCHANGES] = {"solution", "gradient", "sgsf"};
+
+timer_registry::timer_registry()
+{
+  reset();
+}
+
+void timer_registry::reset(void)
+{
+  for (int i = 0; i < N_TIMERS; i++)
+    for (int j = 0; j < N_TIMER_TYPES; j++)
+    {
+      time_ns[i][j] = 0;
+      n_calls[i][j] = 0;
+      for (int k = 0; k < N_PERF_COUNTERS; k++)
+        counts[i][j][k] = 0;
+      last_time_ns[i][j] = 0;
+      last_n_calls[i][j] = 0;
+    }
+  start_time = last_time = chrono::steady_clock::now();
+}
+
+// print one row per stage and element type with calls, min/avg/max time across ranks and the share of the
+// elapsed wall time. Every rank has to call it; the table is printed by rank 0
+
+void timer_registry::report(bool in_total, ostream &out)
+{
+  const int n_slots = N_TIMERS * N_TIMER_TYPES;
+  int rank = 0, nproc = 1;
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  double wall = chrono::duration<double>(now - (in_total ? start_time : last_time)).count();
+
+  //time (s) and number of calls of each slot on this rank
+  vector<double> loc_time(n_slots), loc_calls(n_slots);
+  for (int i = 0; i < N_TIMERS; i++)
+    for (int j = 0; j < N_TIMER_TYPES; j++)
+    {
+      long long t = time_ns[i][j].load(memory_order_relaxed);
+      long long c = n_calls[i][j].load(memory_order_relaxed);
+      loc_time[i * N_TIMER_TYPES + j] = 1.e-9 * (in_total ? t : t - last_time_ns[i][j]);
+      loc_calls[i * N_TIMER_TYPES + j] = in_total ? c : c - last_n_calls[i][j];
+      if (!in_total)
+      {
+        last_time_ns[i][j] = t;
+        last_n_calls[i][j] = c;
+      }
+    }
+  if (!in_total)
+    last_time = now;
+
+  struct val_rank
+  {
+    double val;
+    int rank;
+  } max_time[n_slots];
+  vector<double> min_time(loc_time), sum_time(loc_time), sum_calls(loc_calls);
+
+#ifdef _MPI
+  val_rank loc_max[n_slots];
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  for (int i = 0; i < n_slots; i++)
+  {
+    loc_max[i].val = loc_time[i];
+    loc_max[i].rank = rank;
+  }
+  MPI_Reduce(loc_time.data(), min_time.data(), n_slots, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+  MPI_Reduce(loc_time.data(), sum_time.data(), n_slots, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce(loc_calls.data(), sum_calls.data(), n_slots, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce(loc_max, max_time, n_slots, MPI_DOUBLE_INT, MPI_MAXLOC, 0, MPI_COMM_WORLD);
+#else
+  for (int i = 0; i < n_slots; i++)
+  {
+    max_time[i].val = loc_time[i];
+    max_time[i].rank = 0;
+  }
+#endif
+
+  if (rank != 0)
+    return;
+
+  char line[256];
+  snprintf(line, sizeof(line), "%s timers over %.3f s wall time, %d rank(s)", in_total ? "Total" : "Interval", wall, nproc);
+  out << line << endl;
+  snprintf(line, sizeof(line), "%-22s %-5s %10s %12s %12s %12s %12s %6s %7s",
+           "stage", "type", "calls", "ms/call", "min (s)", "avg (s)", "max (s)", "rank", "% wall");
+  out << line << endl;
+  for (int i = 0; i < N_TIMERS; i++)
+    for (int j = 0; j < N_TIMER_TYPES; j++)
+    {
+      int k = i * N_TIMER_TYPES + j;
+      if (sum_calls[k] == 0)
+        continue;
+      double avg = sum_time[k] / nproc;
+      snprintf(line, sizeof(line), "%-22s %-5s %10.0f %12.4f %12.4f %12.4f %12.4f %6d %7.2f",
+               timer_names[i], timer_type_names[j], sum_calls[k] / nproc, 1.e3 * sum_time[k] / sum_calls[k],
+               min_time[k], avg, max_time[k].val, max_time[k].rank, wall > 0. ? 100. * avg / wall : 0.);
+      out << line << endl;
+    }
+}
+
+double timer_registry::get_seconds(int in_timer)
+{
+  long long t = 0;
+  for (int j = 0; j < N_TIMER_TYPES; j++)
+    t += time_ns[in_timer][j].load(memory_order_relaxed);
+  return 1.e-9 * t;
+}
+
+long long timer_registry::get_calls(int in_timer)
+{
+  long long c = 0;
+  for (int j = 0; j < N_TIMER_TYPES; j++)
+    c += n_calls[in_timer][j].load(memory_order_relaxed);
+  return c;
+}
+
+// print one row per stage and element type with the rates derived from the hardware counters. Counts and times are
+// summed over the ranks, so the rates are per core. The memory traffic is estimated as one 64 byte line per last level
+// cache miss. Every rank has to call it; the table is printed by rank 0
+
+void timer_registry::report_counters(double in_peak_gflops, double in_peak_bandwidth, ostream &out)
+{
+  const int n_slots = N_TIMERS * N_TIMER_TYPES;
+  int rank = 0;
+  int available = run_perf.get_available();
+
+  //time (s), calls and counts of each slot on this rank
+  vector<double> loc_val(n_slots * (N_PERF_COUNTERS + 2));
+  for (int i = 0; i < n_slots; i++)
+  {
+    double *val = &loc_val[i * (N_PERF_COUNTERS + 2)];
+    val[0] = 1.e-9 * time_ns[i / N_TIMER_TYPES][i % N_TIMER_TYPES].load(memory_order_relaxed);
+    val[1] = n_calls[i / N_TIMER_TYPES][i % N_TIMER_TYPES].load(memory_order_relaxed);
+    for (int k = 0; k < N_PERF_COUNTERS; k++)
+      val[2 + k] = counts[i / N_TIMER_TYPES][i % N_TIMER_TYPES][k].load(memory_order_relaxed);
+  }
+  vector<double> sum_val(loc_val);
+
+#ifdef _MPI
+  int loc_available = available;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Reduce(loc_val.data(), sum_val.data(), loc_val.size(), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&loc_available, &available, 1, MPI_INT, MPI_BAND, 0, MPI_COMM_WORLD);
+#endif
+
+  if (rank != 0)
+    return;
+
+  char line[256], col[N_PERF_COUNTERS + 3][16];
+  bool has_roofline = in_peak_gflops > 0. && in_peak_bandwidth > 0.;
+  out << "Hardware counters per core";
+  if (has_roofline)
+  {
+    snprintf(line, sizeof(line), ", roofline %.4g GFLOP/s and %.4g GB/s, ridge at %.3g flop/B",
+             in_peak_gflops, in_peak_bandwidth, in_peak_gflops / in_peak_bandwidth);
+    out << line;
+  }
+  out << endl;
+  snprintf(line, sizeof(line), "%-22s %-5s %8s %8s %9s %9s %9s %5s %7s",
+           "stage", "type", "GHz", "IPC", "GFLOP/s", "GB/s", "flop/B", "bound", "% roof");
+  out << line << endl;
+  for (int i = 0; i < n_slots; i++)
+  {
+    double *val = &sum_val[i * (N_PERF_COUNTERS + 2)];
+    double t = val[0], *c = val + 2;
+    if (val[1] == 0 || t <= 0.)
+      continue;
+
+    bool has_cycles = available & (1 << PC_CYCLES), has_ins = available & (1 << PC_INSTRUCTIONS);
+    bool has_misses = available & (1 << PC_LLC_MISSES), has_fp = available & (1 << PC_FP_OPS);
+    double gflops = 1.e-9 * c[PC_FP_OPS] / t, bandwidth = 1.e-9 * 64. * c[PC_LLC_MISSES] / t;
+    double intensity = c[PC_LLC_MISSES] > 0. ? c[PC_FP_OPS] / (64. * c[PC_LLC_MISSES]) : 0.;
+    bool has_intensity = has_fp && has_misses && c[PC_LLC_MISSES] > 0.;
+
+    for (int k = 0; k < 7; k++)
+      snprintf(col[k], sizeof(col[k]), "n/a");
+    if (has_cycles)
+      snprintf(col[0], sizeof(col[0]), "%.3f", 1.e-9 * c[PC_CYCLES] / t);
+    if (has_cycles && has_ins && c[PC_CYCLES] > 0.)
+      snprintf(col[1], sizeof(col[1]), "%.3f", c[PC_INSTRUCTIONS] / c[PC_CYCLES]);
+    if (has_fp)
+      snprintf(col[2], sizeof(col[2]), "%.4g", gflops);
+    if (has_misses)
+      snprintf(col[3], sizeof(col[3]), "%.4g", bandwidth);
+    if (has_intensity)
+      snprintf(col[4], sizeof(col[4]), "%.3g", intensity);
+    if (has_intensity && has_roofline)
+    {
+      double attainable = min(in_peak_gflops, intensity * in_peak_bandwidth);
+      snprintf(col[5], sizeof(col[5]), "%s", intensity < in_peak_gflops / in_peak_bandwidth ? "mem" : "cpu");
+      snprintf(col[6], sizeof(col[6]), "%.1f", 100. * gflops / attainable);
+    }
+
+    snprintf(line, sizeof(line), "%-22s %-5s %8s %8s %9s %9s %9s %5s %7s",
+             timer_names[i / N_TIMER_TYPES], timer_type_names[i % N_TIMER_TYPES],
+             col[0], col[1], col[2], col[3], col[4], col[5], col[6]);
+    out << line << endl;
+  }
+}
+
+#ifdef _PERF_EVENT
+
+//event groups of the calling thread, closed when the thread exits
+struct perf_thread_groups
+{
+  bool open;
+  int n_events[2];
+  int fd[2][4];
+  int counter[2][4]; //counter each event of the group adds to
+  int weight[2][4];
+
+  perf_thread_groups() : open(false) {}
+
+  ~perf_thread_groups()
+  {
+    if (open)
+      for (int g = 0; g < 2; g++)
+        for (int e = 0; e < n_events[g]; e++)
+          close(fd[g][e]);
+  }
+};
+
+static thread_local perf_thread_groups local_perf;
+
+static int open_event(unsigned int in_type, unsigned long long in_config, int in_group_fd)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = in_type;
+  attr.config = in_config;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, in_group_fd, 0);
+}
+
+static string cpu_vendor(void)
+{
+  char vendor[13] = "";
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+  {
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = '\0';
+  }
+#endif
+  return vendor;
+}
+
+#endif
+
+void perf_counters::setup(const string &in_fp_event)
+{
+  int rank = 0;
+#ifdef _MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+
+#ifdef _PERF_EVENT
+  n_fp_events = 0;
+  if (in_fp_event == "auto")
+  {
+    string vendor = cpu_vendor();
+    if (vendor == "GenuineIntel")
+    {
+      //FP_ARITH_INST_RETIRED scalar, 128, 256 and 512 bit packed double, a fused multiply-add counts twice
+      unsigned long long events[4] = {0x01c7, 0x04c7, 0x10c7, 0x40c7};
+      int weights[4] = {1, 2, 4, 8};
+      for (int i = 0; i < 4; i++)
+      {
+        fp_events[i] = events[i];
+        fp_weights[i] = weights[i];
+      }
+      n_fp_events = 4;
+    }
+    else if (vendor == "AuthenticAMD")
+    {
+      //RETIRED_SSE_AVX_FLOPS, all precisions
+      fp_events[0] = 0xff03;
+      fp_weights[0] = 1;
+      n_fp_events = 1;
+    }
+  }
+  else
+  {
+    char *end;
+    fp_events[0] = strtoull(in_fp_event.c_str(), &end, 0);
+    if (*end != '\0' || in_fp_event.empty())
+      FatalError("perf_fp_event must be auto or a raw event code");
+    fp_weights[0] = 1;
+    n_fp_events = 1;
+  }
+
+  available.store((1 << N_PERF_COUNTERS) - 1, memory_order_relaxed);
+  open_thread();
+  active.store(true, memory_order_release);
+
+  int missing = ~available.load(memory_order_relaxed) & ((1 << N_PERF_COUNTERS) - 1);
+  if (missing && rank == 0)
+  {
+    const char *names[N_PERF_COUNTERS] = {"cycles", "instructions", "LLC misses", "FP operations"};
+    cout << "Warning: hardware counters not available:";
+    for (int i = 0; i < N_PERF_COUNTERS; i++)
+      if (missing & (1 << i))
+        cout << " " << names[i];
+    cout << " (no PMU, perf_event_paranoid or unknown FP events, see perf_fp_event)" << endl;
+  }
+#else
+  if (rank == 0)
+    cout << "Warning: built without perf_event support, hardware counters not available" << endl;
+#endif
+}
+
+void perf_counters::open_thread(void)
+{
+#ifdef _PERF_EVENT
+  perf_thread_groups &g = local_perf;
+  int found = 0;
+
+  //cycles lead the hardware event group
+  unsigned long long hw_config[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+  int hw_counter[3] = {PC_CYCLES, PC_INSTRUCTIONS, PC_LLC_MISSES};
+  g.n_events[0] = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    int fd = open_event(PERF_TYPE_HARDWARE, hw_config[i], g.n_events[0] ? g.fd[0][0] : -1);
+    if (fd < 0)
+    {
+      if (i == 0)
+        break;
+      continue;
+    }
+    g.fd[0][g.n_events[0]] = fd;
+    g.counter[0][g.n_events[0]] = hw_counter[i];
+    g.weight[0][g.n_events[0]] = 1;
+    g.n_events[0]++;
+    found |= 1 << hw_counter[i];
+  }
+
+  //the FP operations are only meaningful when every event of the group opens
+  g.n_events[1] = 0;
+  for (int i = 0; i < n_fp_events; i++)
+  {
+    int fd = open_event(PERF_TYPE_RAW, fp_events[i], g.n_events[1] ? g.fd[1][0] : -1);
+    if (fd < 0)
+    {
+      for (int e = 0; e < g.n_events[1]; e++)
+        close(g.fd[1][e]);
+      g.n_events[1] = 0;
+      break;
+    }
+    g.fd[1][g.n_events[1]] = fd;
+    g.counter[1][g.n_events[1]] = PC_FP_OPS;
+    g.weight[1][g.n_events[1]] = fp_weights[i];
+    g.n_events[1]++;
+  }
+  if (g.n_events[1])
+    found |= 1 << PC_FP_OPS;
+
+  g.open = true;
+  available.fetch_and(found, memory_order_relaxed);
+#endif
+}
+
+void perf_counters::read(long long *out_counts)
+{
+  for (int i = 0; i < N_PERF_COUNTERS; i++)
+    out_counts[i] = 0;
+
+#ifdef _PERF_EVENT
+  perf_thread_groups &g = local_perf;
+  if (!g.open)
+    open_thread();
+
+  //nr, time enabled, time running, then one value per event
+  unsigned long long buf[3 + 4];
+  for (int k = 0; k < 2; k++)
+  {
+    if (g.n_events[k] == 0 || ::read(g.fd[k][0], buf, sizeof(buf)) < (ssize_t)(3 * sizeof(unsigned long long)))
+      continue;
+    double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / buf[2] : 1.;
+    for (int e = 0; e < g.n_events[k] && e < (int)buf[0]; e++)
+      out_counts[g.counter[k][e]] += (long long)(scale * buf[3 + e]) * g.weight[k][e];
+  }
+#endif
+}
+
+void comm_profiler::setup(int in_nproc)
+{
+  nproc = in_nproc;
+  for (int e = 0; e < N_COMM_EXCHANGES; e++)
+  {
+    n_messages[e].assign(nproc, 0);
+    bytes[e].assign(nproc, 0);
+    completion[e].assign(nproc, 0.);
+    n_waits[e] = 0;
+    compute_time[e] = 0.;
+    wait_time[e] = 0.;
+  }
+  active = true;
+}
+
+// rank 0 gathers the nonzero entries of the neighbor matrix and the wait times of every rank. Every rank has to call it
+
+void comm_profiler::report(ostream &out)
+{
+  const int n_entry = 5, n_summary = 3 * N_COMM_EXCHANGES;
+  int rank = 0, n_ranks = 1;
+
+  //exchange, neighbor, messages, bytes, completion time of each neighbor this rank sent to
+  vector<double> entries, summary(n_summary);
+  for (int e = 0; e < N_COMM_EXCHANGES; e++)
+  {
+    for (int p = 0; p < nproc; p++)
+      if (n_messages[e][p])
+      {
+        double entry[n_entry] = {(double)e, (double)p, (double)n_messages[e][p], (double)bytes[e][p], completion[e][p]};
+        entries.insert(entries.end(), entry, entry + n_entry);
+      }
+    summary[3 * e] = n_waits[e];
+    summary[3 * e + 1] = compute_time[e];
+    summary[3 * e + 2] = wait_time[e];
+  }
+
+  vector<double> all_entries(entries), all_summary(summary);
+  vector<int> n_values(1, entries.size()), displ(1, 0);
+#ifdef _MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  int n_loc = entries.size();
+  n_values.resize(n_ranks);
+  displ.assign(n_ranks, 0);
+  MPI_Gather(&n_loc, 1, MPI_INT, n_values.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+  for (int p = 1; p < n_ranks; p++)
+    displ[p] = displ[p - 1] + n_values[p - 1];
+  if (rank == 0)
+    all_entries.resize(displ[n_ranks - 1] + n_values[n_ranks - 1]);
+  all_summary.resize(n_summary * n_ranks);
+  MPI_Gatherv(entries.data(), n_loc, MPI_DOUBLE, all_entries.data(), n_values.data(), displ.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  MPI_Gather(summary.data(), n_summary, MPI_DOUBLE, all_summary.data(), n_summary, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#endif
+
+  if (rank != 0)
+    return;
+
+  char line[256];
+  out << "Halo exchanges, neighbor matrix (nonzero entries)" << endl;
+  snprintf(line, sizeof(line), "%6s %8s %-9s %10s %12s %14s %10s", "rank", "neighbor", "exchange", "messages", "MB sent", "ms post->done", "MB/s");
+  out << line << endl;
+  for (int r = 0; r < n_ranks; r++)
+    for (int i = displ[r]; i < displ[r] + n_values[r]; i += n_entry)
+    {
+      double *entry = &all_entries[i];
+      snprintf(line, sizeof(line), "%6d %8d %-9s %10.0f %12.4f %14.4f %10.1f", r, (int)entry[1], exchange_names[(int)entry[0]],
+               entry[2], entry[3] / 1048576., 1.e3 * entry[4] / entry[2], entry[4] > 0. ? entry[3] / 1048576. / entry[4] : 0.);
+      out << line << endl;
+    }
+
+  //imbalance: the ranks computing longest before a wait make the others block
+  out << "Halo exchanges, load imbalance across ranks (s)" << endl;
+  snprintf(line, sizeof(line), "%-9s %8s %12s %12s %6s %12s %12s %6s %9s", "exchange", "waits",
+           "compute avg", "compute max", "rank", "wait avg", "wait max", "rank", "max/avg");
+  out << line << endl;
+  for (int e = 0; e < N_COMM_EXCHANGES; e++)
+  {
+    double n_w = 0., sum_c = 0., max_c = 0., sum_w = 0., max_w = 0.;
+    int rank_c = 0, rank_w = 0;
+    for (int r = 0; r < n_ranks; r++)
+    {
+      double *val = &all_summary[n_summary * r + 3 * e];
+      n_w = max(n_w, val[0]);
+      sum_c += val[1];
+      sum_w += val[2];
+      if (val[1] > max_c)
+      {
+        max_c = val[1];
+        rank_c = r;
+      }
+      if (val[2] > max_w)
+      {
+        max_w = val[2];
+        rank_w = r;
+      }
+    }
+    if (n_w == 0.)
+      continue;
+    snprintf(line, sizeof(line), "%-9s %8.0f %12.4f %12.4f %6d %12.4f %12.4f %6d %9.3f", exchange_names[e], n_w,
+             sum_c / n_ranks, max_c, rank_c, sum_w / n_ranks, max_w, rank_w, sum_c > 0. ? max_c * n_ranks / sum_c : 0.);
+    out << line << endl;
+  }
+}
+
+void trace_recorder::setup(long long in_capacity)
+{
+  capacity = in_capacity;
+#ifdef _MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+  origin = chrono::steady_clock::now();
+}
+
+trace_recorder::thread_buffer *trace_recorder::get_buffer(void)
+{
+  if (local_trace_buffer == nullptr)
+  {
+    lock_guard<mutex> lock(buffers_mutex);
+    buffers.emplace_back(new thread_buffer);
+    thread_buffer *buf = buffers.back().get();
+    buf->name = local_trace_name ? local_trace_name : "thread " + to_string(buffers.size() - 1);
+    buf->events.resize(capacity);
+    buf->n_events = 0;
+    buf->n_dropped = 0;
+    local_trace_buffer = buf;
+  }
+  return (thread_buffer *)local_trace_buffer;
+}
+
+void trace_recorder::name_thread(const char *in_name)
+{
+  local_trace_name = in_name;
+  if (capacity)
+    get_buffer()->name = in_name;
+}
+
+void trace_recorder::record(int in_timer, int in_ele_type, chrono::steady_clock::time_point in_begin, chrono::steady_clock::time_point in_end)
+{
+  thread_buffer *buf = get_buffer();
+  if (buf->n_events == buf->events.size())
+  {
+    buf->n_dropped++;
+    return;
+  }
+  trace_event &ev = buf->events[buf->n_events++];
+  ev.begin_ns = chrono::duration_cast<chrono::nanoseconds>(in_begin - origin).count();
+  ev.dur_ns = chrono::duration_cast<chrono::nanoseconds>(in_end - in_begin).count();
+  ev.timer = in_timer;
+  ev.ele_type = in_ele_type < 0 ? N_TIMER_TYPES - 1 : in_ele_type;
+}
+
+// gather the events of every rank on rank 0 and write them as Chrome trace JSON, pid=rank and tid=thread.
+// Must be called after the recording threads have stopped
+
+void trace_recorder::write(const char *in_file_name)
+{
+  int rank = 0;
+  long long n_dropped = 0;
+  char line[256];
+  string events;
+
+#ifdef _MPI
+  int nproc;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+#endif
+
+  snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}},\n", rank, rank);
+  events += line;
+  for (size_t t = 0; t < buffers.size(); t++)
+  {
+    thread_buffer *buf = buffers[t].get();
+    snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+             rank, (int)t, buf->name.c_str());
+    events += line;
+    for (size_t i = 0; i < buf->n_events; i++)
+    {
+      trace_event &ev = buf->events[i];
+      snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+               timer_names[ev.timer], timer_type_names[ev.ele_type], 1.e-3 * ev.begin_ns, 1.e-3 * ev.dur_ns, rank, (int)t);
+      events += line;
+    }
+    n_dropped += buf->n_dropped;
+  }
+
+#ifdef _MPI
+  int n_chars = events.size();
+  vector<int> n_chars_rank(nproc), displ(nproc, 0);
+  MPI_Gather(&n_chars, 1, MPI_INT, n_chars_rank.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+  for (int p = 1; p < nproc; p++)
+    displ[p] = displ[p - 1] + n_chars_rank[p - 1];
+  string all_events;
+  if (rank == 0)
+    all_events.resize(displ[nproc - 1] + n_chars_rank[nproc - 1]);
+  MPI_Gatherv(&events[0], n_chars, MPI_CHAR, &all_events[0], n_chars_rank.data(), displ.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+  events.swap(all_events);
+  long long n_dropped_sum;
+  MPI_Reduce(&n_dropped, &n_dropped_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+  n_dropped = n_dropped_sum;
+#endif
+
+  if (rank != 0)
+    return;
+
+  ofstream trace_file(in_file_name);
+  if (!trace_file)
+    FatalError("Unable to open the trace file");
+  events.resize(events.size() - 2); //trailing ",\n"
+  trace_file << "{\"traceEvents\":[\n" << events << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+  cout << "Trace written to " << in_file_name;
+  if (n_dropped)
+    cout << ", " << n_dropped << " events dropped, increase trace_buffer";
+  cout << endl;
+}
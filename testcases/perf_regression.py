@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+
+# \file perf_regression.py
+# \brief Python script for automated performance regression testing of HiFiLES examples
+#
+# Runs a set of test cases serially and with several MPI ranks, reads the total
+# timer table HiFiLES prints at the end of a run (timer_report 1) and the number of
+# degrees of freedom printed during preprocessing, and computes the throughput in
+# degree of freedom updates (one residual evaluation of one degree of freedom) per
+# second and per core. The results are compared with a baseline file and written
+# to a JSON report; a slowdown larger than the tolerance fails the run.
+#
+# Usage:
+#   python3 testcases/perf_regression.py [--ranks 1 4] [--cases tgv cylinder]
+#   python3 testcases/perf_regression.py --update-baseline   # store this machine's numbers
+#
+# Baselines are machine specific, record them with --update-baseline on the machine
+# the comparisons are run on.
+#
+# HiFiLES (High Fidelity Large Eddy Simulation).
+# Copyright (C) 2013 Aerospace Computing Laboratory.
+
+import argparse, datetime, json, os, re, shutil, subprocess, sys, tempfile, time
+
+hifiles_home = os.environ.get('HIFILES_HOME', os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+class perfcase:
+
+  def __init__(self, name, cfg_dir, cfg_file, n_steps, options=None):
+
+    self.name     = name      # Input, string tag that identifies this case
+    self.cfg_dir  = cfg_dir   # Directory of the input and mesh files, relative to HIFILES_HOME
+    self.cfg_file = cfg_file  # Input file name
+    self.n_steps  = n_steps   # Number of time steps of the timed run
+    self.options  = dict(options or {})  # Input file options to override
+
+  def write_input(self, run_dir):
+    '''Copy the case to run_dir with the steps, output and timer options of a timed run'''
+
+    src_dir = os.path.join(hifiles_home, self.cfg_dir)
+    for f in os.listdir(src_dir):
+      if f != self.cfg_file and os.path.isfile(os.path.join(src_dir, f)):
+        os.symlink(os.path.join(src_dir, f), os.path.join(run_dir, f))
+
+    # Keep the run to time stepping: no plot, restart or surface files within the run
+    options = {'n_steps': self.n_steps,
+               'plot_freq': 1000000000,
+               'restart_dump_freq': 1000000000,
+               'monitor_res_freq': self.n_steps,
+               'monitor_cp_freq': 0,
+               'monitor_integrals_freq': 1000000000,
+               'probe': 0,
+               'timer_report': 1}
+    options.update(self.options)
+
+    lines = open(os.path.join(src_dir, self.cfg_file), 'r').readlines()
+    out = []
+    for line in lines:
+      words = line.split()
+      if words and words[0] in options:
+        continue
+      out.append(line.rstrip('\n') + '\n')
+    for key in sorted(options):
+      out.append('%s %s\n' % (key, options[key]))
+    open(os.path.join(run_dir, self.cfg_file), 'w').writelines(out)
+
+  def run(self, exec_path, mpi_cmd, n_ranks, timeout, keep_dir):
+    '''Run the case on n_ranks ranks and return the parsed timings'''
+
+    run_dir = tempfile.mkdtemp(prefix='hifiles_perf_%s_%d_' % (self.name, n_ranks))
+    result = {'case': self.name, 'ranks': n_ranks, 'run_dir': run_dir}
+    try:
+      self.write_input(run_dir)
+      if n_ranks > 1:
+        command = '%s %d %s %s' % (mpi_cmd, n_ranks, exec_path, self.cfg_file)
+      else:
+        command = '%s %s' % (exec_path, self.cfg_file)
+      result['command'] = command
+      print('%s, %d rank(s): %s' % (self.name, n_ranks, command))
+      sys.stdout.flush()
+
+      start = time.time()
+      try:
+        proc = subprocess.run(command, shell=True, cwd=run_dir, timeout=timeout,
+                              stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        output = proc.stdout
+        open(os.path.join(run_dir, 'outputfile'), 'w').write(output)
+      except subprocess.TimeoutExpired:
+        result['status'] = 'timed out after %d s' % timeout
+        return result
+      result['elapsed'] = time.time() - start
+
+      if proc.returncode != 0:
+        result['status'] = 'failed with exit code %d' % proc.returncode
+        result['output_tail'] = output.splitlines()[-20:]
+        return result
+
+      parse_output(output, result)
+    finally:
+      if not keep_dir:
+        shutil.rmtree(run_dir, ignore_errors=True)
+        del result['run_dir']
+    return result
+
+def parse_output(output, result):
+  '''Read the degrees of freedom and the total timer table of a HiFiLES run'''
+
+  m = re.search(r'degrees of freedom: (\d+)', output)
+  if m is None:
+    result['status'] = 'degrees of freedom not found in the output'
+    return
+  result['dofs'] = int(m.group(1))
+
+  lines = output.splitlines()
+  start = None
+  for i, line in enumerate(lines):
+    m = re.match(r'Total timers over ([0-9.eE+-]+) s wall time, (\d+) rank', line)
+    if m:
+      start = i
+      result['wall_time'] = float(m.group(1))
+  if start is None:
+    result['status'] = 'timer table not found in the output, is timer_report 0?'
+    return
+
+  stages = {}
+  for line in lines[start + 2:]:
+    words = line.split()
+    if len(words) != 9:
+      break
+    try:
+      stages['%s/%s' % (words[0], words[1])] = {'calls': float(words[2]), 'ms_per_call': float(words[3]),
+                                                'min': float(words[4]), 'avg': float(words[5]),
+                                                'max': float(words[6]), 'max_rank': int(words[7]),
+                                                'percent_wall': float(words[8])}
+    except ValueError:
+      break
+  result['stages'] = stages
+
+  if 'calc_residual/-' not in stages or result['wall_time'] <= 0.:
+    result['status'] = 'no residual evaluations timed'
+    return
+
+  # One residual evaluation updates every degree of freedom once
+  result['residual_evaluations'] = stages['calc_residual/-']['calls']
+  result['dof_updates_per_s'] = result['dofs'] * result['residual_evaluations'] / result['wall_time']
+  result['dof_updates_per_s_per_core'] = result['dof_updates_per_s'] / result['ranks']
+  result['status'] = 'ok'
+
+def compare(result, baseline, tol, min_share):
+  '''Flag the throughput and the stages more than tol percent slower than the baseline'''
+
+  result['slowdowns'] = []
+  if baseline is None:
+    result['baseline'] = 'none'
+    return
+
+  base_rate = baseline['dof_updates_per_s_per_core']
+  result['baseline_dof_updates_per_s_per_core'] = base_rate
+  change = 100. * (base_rate / result['dof_updates_per_s_per_core'] - 1.)
+  result['slowdown_percent'] = change
+  if change > tol:
+    result['slowdowns'].append('throughput %.1f%% slower' % change)
+
+  # Stages are compared by time per call; short stages are too noisy to judge
+  for key, stage in sorted(result['stages'].items()):
+    base = baseline['stages'].get(key)
+    if base is None or base['percent_wall'] < min_share or base['ms_per_call'] <= 0.:
+      continue
+    change = 100. * (stage['ms_per_call'] / base['ms_per_call'] - 1.)
+    stage['baseline_ms_per_call'] = base['ms_per_call']
+    stage['slowdown_percent'] = change
+    if change > tol:
+      result['slowdowns'].append('%s %.1f%% slower' % (key, change))
+
+cases = [perfcase('tgv', 'testcases/navier-stokes/Taylor_Green_vortex', 'input_TGV_SD_hex', 20),
+         perfcase('cylinder', 'testcases/navier-stokes/cylinder', 'input_cylinder_visc', 20),
+         perfcase('flatplate', 'testcases/navier-stokes/flatplate', 'input_flatplate_a', 20, {'dt': 1.e-8})]
+
+def main():
+  '''Runs the performance cases and compares their throughput with the stored baselines.'''
+
+  parser = argparse.ArgumentParser(description=main.__doc__)
+  parser.add_argument('--exec', dest='exec_path', default=os.path.join(hifiles_home, 'bin', 'HiFiLES'),
+                      help='HiFiLES executable')
+  parser.add_argument('--mpi-cmd', default='mpirun -n', help='MPI launcher, followed by the number of ranks')
+  parser.add_argument('--ranks', type=int, nargs='+', default=[1, 4], help='rank counts to run each case with')
+  parser.add_argument('--cases', nargs='+', default=[c.name for c in cases], choices=[c.name for c in cases])
+  parser.add_argument('--steps', type=int, help='override the number of time steps of every case')
+  parser.add_argument('--baseline', default=os.path.join(hifiles_home, 'testcases', 'perf_baselines.json'),
+                      help='baseline file')
+  parser.add_argument('--update-baseline', action='store_true', help='store the results as the new baseline')
+  parser.add_argument('--tol', type=float, default=5., help='slowdown in percent that fails the comparison')
+  parser.add_argument('--min-share', type=float, default=1.,
+                      help='only compare the stages taking at least this percentage of the wall time')
+  parser.add_argument('--report', default='perf_report.json', help='JSON report')
+  parser.add_argument('--timeout', type=int, default=3600, help='timeout of each run in seconds')
+  parser.add_argument('--keep', action='store_true', help='keep the run directories')
+  args = parser.parse_args()
+
+  exec_path = os.path.abspath(args.exec_path)
+  if not os.path.exists(exec_path):
+    print('Error: HiFiLES executable %s not found' % exec_path)
+    return 1
+
+  baselines = {}
+  if os.path.exists(args.baseline):
+    baselines = json.load(open(args.baseline, 'r'))
+
+  results = []
+  for case in cases:
+    if case.name not in args.cases:
+      continue
+    if args.steps:
+      case.n_steps = args.steps
+    for n_ranks in args.ranks:
+      result = case.run(exec_path, args.mpi_cmd, n_ranks, args.timeout, args.keep)
+      key = '%s/%d' % (case.name, n_ranks)
+      if result['status'] == 'ok':
+        compare(result, baselines.get(key), args.tol, args.min_share)
+        if args.update_baseline:
+          baselines[key] = {'dof_updates_per_s_per_core': result['dof_updates_per_s_per_core'],
+                            'stages': result['stages'], 'date': datetime.date.today().isoformat()}
+      results.append(result)
+
+      if result['status'] != 'ok':
+        print('  %s: FAILED, %s' % (key, result['status']))
+      else:
+        print('  %s: %.4g DOF updates/s/core%s' % (key, result['dof_updates_per_s_per_core'],
+              '' if 'slowdown_percent' not in result else ' (%+.1f%% vs baseline)' % -result['slowdown_percent']))
+        for s in result['slowdowns']:
+          print('    SLOWDOWN: %s' % s)
+
+  failed = [r for r in results if r['status'] != 'ok' or r['slowdowns']]
+  report = {'date': datetime.datetime.now().isoformat(), 'exec': exec_path, 'tol_percent': args.tol,
+            'baseline': args.baseline, 'passed': not failed, 'runs': results}
+  with open(args.report, 'w') as f:
+    json.dump(report, f, indent=2, sort_keys=True)
+  print('Report written to %s' % args.report)
+
+  if args.update_baseline:
+    with open(args.baseline, 'w') as f:
+      json.dump(baselines, f, indent=2, sort_keys=True)
+    print('Baseline written to %s' % args.baseline)
+    return 0
+
+  return 1 if failed else 0
+
+if __name__=="__main__":
+  sys.exit(main())